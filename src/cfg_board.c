@@ -25,7 +25,6 @@ unless explicitly said so.
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include <omp.h>
 
 #include "alloc.h"
 #include "board.h"
@@ -38,28 +37,32 @@ unless explicitly said so.
 /* from board_constants */
 extern u8 out_neighbors8[TOTAL_BOARD_SIZ];
 extern u8 out_neighbors4[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_side[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_diag[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_diag[TOTAL_BOARD_SIZ];
+extern nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
+extern nei_seq12 nei_dst_2[TOTAL_BOARD_SIZ];
 extern bool border_left[TOTAL_BOARD_SIZ];
 extern bool border_right[TOTAL_BOARD_SIZ];
 extern bool border_top[TOTAL_BOARD_SIZ];
 extern bool border_bottom[TOTAL_BOARD_SIZ];
-extern u8 active_bits_in_byte[256];
 
 /* from zobrist */
-extern u16 iv_3x3[TOTAL_BOARD_SIZ][TOTAL_BOARD_SIZ][3];
+extern u8 iv_3x3_shift[2 * BOARD_SIZ + 3];
 extern u16 initial_3x3_hash[TOTAL_BOARD_SIZ];
+extern u64 iv_pat5[4 * BOARD_SIZ + 5][4];
+extern u64 initial_pat5_hash[TOTAL_BOARD_SIZ];
 
-static group * saved_nodes[MAXIMUM_NUM_THREADS];
+/*
+Groups released, kept for reuse by the same thread.
+*/
+static __thread group * saved_nodes = NULL;
 
 static group * alloc_group() {
-    int thread = omp_get_thread_num();
     group * ret;
 
-    if (saved_nodes[thread] != NULL) {
-        ret = saved_nodes[thread];
-        saved_nodes[thread] = saved_nodes[thread]->next;
+    if (saved_nodes != NULL) {
+        ret = saved_nodes;
+        saved_nodes = saved_nodes->next;
     } else {
         ret = malloc(sizeof(group));
 
@@ -74,9 +77,8 @@ static group * alloc_group() {
 static void just_delloc_group(
     group * g
 ) {
-    int thread = omp_get_thread_num();
-    g->next = saved_nodes[thread];
-    saved_nodes[thread] = g;
+    g->next = saved_nodes;
+    saved_nodes = g;
 }
 
 static void delloc_group(
@@ -90,10 +92,27 @@ static void delloc_group(
         cb->g[cb->unique_groups[g->unique_groups_idx]]->unique_groups_idx = g->unique_groups_idx;
     }
 
-    int thread = omp_get_thread_num();
-    g->next = saved_nodes[thread];
-    saved_nodes[thread] = g;
+    g->next = saved_nodes;
+    saved_nodes = g;
+}
+
+#if USE_PAT5_HASH
+/*
+Toggles the stone at m in the 5x5 diamond hashes of its neighborhood; used both
+on placing and removing the stone.
+*/
+static void pat5_toggle(
+    cfg_board * cb,
+    move m
+) {
+    u8 cell = cb->p[m];
+
+    for (u8 k = 0; k < nei_dst_2[m].count; ++k) {
+        move n = nei_dst_2[m].coord[k];
+        cb->pat5_hash[n] ^= iv_pat5[m - n + 2 * BOARD_SIZ + 2][cell];
+    }
 }
+#endif
 
 static void pos_set_occupied(
     cfg_board * cb,
@@ -104,21 +123,21 @@ static void pos_set_occupied(
     assert(neighbors_diag[m].count < 5);
     assert(cb->p[m] > 0);
 
-    u8 idx = cb->p[m] - 1;
+    u16 cell = cb->p[m];
     if (is_black) {
         for (u8 k = 0; k < neighbors_side[m].count; ++k) {
             move n = neighbors_side[m].coord[k];
             cb->black_neighbors4[n]++;
             cb->black_neighbors8[n]++;
 
-            cb->hash[n] += iv_3x3[n][m][idx];
+            cb->hash[n] += cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
 
         for (u8 k = 0; k < neighbors_diag[m].count; ++k) {
             move n = neighbors_diag[m].coord[k];
             cb->black_neighbors8[n]++;
 
-            cb->hash[n] += iv_3x3[n][m][idx];
+            cb->hash[n] += cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
     } else {
         for (u8 k = 0; k < neighbors_side[m].count; ++k) {
@@ -126,16 +145,20 @@ static void pos_set_occupied(
             cb->white_neighbors4[n]++;
             cb->white_neighbors8[n]++;
 
-            cb->hash[n] += iv_3x3[n][m][idx];
+            cb->hash[n] += cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
 
         for (u8 k = 0; k < neighbors_diag[m].count; ++k) {
             move n = neighbors_diag[m].coord[k];
             cb->white_neighbors8[n]++;
 
-            cb->hash[n] += iv_3x3[n][m][idx];
+            cb->hash[n] += cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
     }
+
+#if USE_PAT5_HASH
+    pat5_toggle(cb, m);
+#endif
 }
 
 static void pos_set_free(
@@ -147,20 +170,21 @@ static void pos_set_free(
     assert(neighbors_diag[m].count < 5);
     assert(cb->p[m] > 0);
 
+    u16 cell = cb->p[m];
     if (is_black) {
         for (u8 k = 0; k < neighbors_side[m].count; ++k) {
             move n = neighbors_side[m].coord[k];
             cb->black_neighbors4[n]--;
             cb->black_neighbors8[n]--;
 
-            cb->hash[n] ^= iv_3x3[n][m][cb->p[m] - 1];
+            cb->hash[n] ^= cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
 
         for (u8 k = 0; k < neighbors_diag[m].count; ++k) {
             move n = neighbors_diag[m].coord[k];
             cb->black_neighbors8[n]--;
 
-            cb->hash[n] ^= iv_3x3[n][m][cb->p[m] - 1];
+            cb->hash[n] ^= cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
     } else {
         for (u8 k = 0; k < neighbors_side[m].count; ++k) {
@@ -168,16 +192,20 @@ static void pos_set_free(
             cb->white_neighbors4[n]--;
             cb->white_neighbors8[n]--;
 
-            cb->hash[n] ^= iv_3x3[n][m][cb->p[m] - 1];
+            cb->hash[n] ^= cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
 
         for (u8 k = 0; k < neighbors_diag[m].count; ++k) {
             move n = neighbors_diag[m].coord[k];
             cb->white_neighbors8[n]--;
 
-            cb->hash[n] ^= iv_3x3[n][m][cb->p[m] - 1];
+            cb->hash[n] ^= cell << iv_3x3_shift[m - n + BOARD_SIZ + 1];
         }
     }
+
+#if USE_PAT5_HASH
+    pat5_toggle(cb, m);
+#endif
 }
 
 static void add_neighbor(
@@ -185,23 +213,23 @@ static void add_neighbor(
     group * restrict n
 ) {
     for (u8 i = 0; i < g->neighbors_count; ++i) {
-        if (g->neighbors[i] == n->stones.coord[0]) {
+        if (g->neighbors[i] == n->first_stone) {
             return;
         }
     }
 
-    g->neighbors[g->neighbors_count++] = n->stones.coord[0];
-    n->neighbors[n->neighbors_count++] = g->stones.coord[0];
+    g->neighbors[g->neighbors_count++] = n->first_stone;
+    n->neighbors[n->neighbors_count++] = g->first_stone;
 }
 
 static void add_liberty(
     group * g,
     move m
 ) {
-    u8 mask = (1 << (m % 8));
+    u64 mask = (1ULL << (m % 64));
 
-    if ((g->ls[m / 8] & mask) == 0) {
-        g->ls[m / 8] |= mask;
+    if ((g->ls[m / 64] & mask) == 0) {
+        g->ls[m / 64] |= mask;
         g->liberties++;
 
         if (m < g->liberties_min_coord) {
@@ -214,8 +242,8 @@ static void add_liberty_unchecked(
     group * g,
     move m
 ) {
-    u8 mask = (1 << (m % 8));
-    g->ls[m / 8] |= mask;
+    u64 mask = (1ULL << (m % 64));
+    g->ls[m / 64] |= mask;
     g->liberties++;
 
     if (m < g->liberties_min_coord) {
@@ -227,8 +255,8 @@ static void rem_liberty_unchecked(
     group * g,
     move m
 ) {
-    u8 mask = (1 << (m % 8));
-    g->ls[m / 8] &= ~mask;
+    u64 mask = (1ULL << (m % 64));
+    g->ls[m / 64] &= ~mask;
     g->liberties--;
 }
 
@@ -237,7 +265,7 @@ static void rem_neighbor(
     const group * restrict to_remove
 ) {
     for (u8 j = 0; j < g->neighbors_count; ++j) {
-        if (g->neighbors[j] == to_remove->stones.coord[0]) {
+        if (g->neighbors[j] == to_remove->first_stone) {
             g->neighbors[j] = g->neighbors[g->neighbors_count - 1];
             g->neighbors_count--;
             return;
@@ -249,19 +277,31 @@ static void rem_neighbor(
 
 static void unite_groups(
     cfg_board * cb,
-    group * restrict to_keep,
-    group * restrict to_replace
+    group * to_keep,
+    group * to_replace
 ) {
     assert(to_keep != to_replace);
     assert(to_keep->is_black == to_replace->is_black);
 
-    copy_moves(&to_keep->stones, &to_replace->stones);
+    /* relabel the stones of the smaller group */
+    if (to_keep->stones_count < to_replace->stones_count) {
+        group * tmp = to_keep;
+        to_keep = to_replace;
+        to_replace = tmp;
+    }
 
-    for (move i = 0; i < to_replace->stones.count; ++i) {
-        move m = to_replace->stones.coord[i];
+    move m = to_replace->first_stone;
+    do {
         assert(cb->g[m] == to_replace);
         cb->g[m] = to_keep;
-    }
+        m = cb->next_stone[m];
+    } while (m != to_replace->first_stone);
+
+    /* splice the stone lists */
+    m = cb->next_stone[to_keep->first_stone];
+    cb->next_stone[to_keep->first_stone] = cb->next_stone[to_replace->first_stone];
+    cb->next_stone[to_replace->first_stone] = m;
+    to_keep->stones_count += to_replace->stones_count;
 
     for (u8 i = 0; i < to_replace->neighbors_count; ++i) {
         add_neighbor(to_keep, cb->g[to_replace->neighbors[i]]);
@@ -276,7 +316,7 @@ static void unite_groups(
     u8 new_lib_count = 0;
     for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
         to_keep->ls[i] |= to_replace->ls[i];
-        new_lib_count += active_bits_in_byte[to_keep->ls[i]];
+        new_lib_count += __builtin_popcountll(to_keep->ls[i]);
     }
     to_keep->liberties = new_lib_count;
 
@@ -300,11 +340,12 @@ static void add_stone(
     cb->g[m] = alloc_group();
     cb->g[m]->is_black = is_black;
     cb->g[m]->liberties = 0;
-    memset(cb->g[m]->ls, 0, LIB_BITMAP_SIZ);
+    memset(cb->g[m]->ls, 0, LIB_BITMAP_SIZ * sizeof(u64));
     cb->g[m]->liberties_min_coord = TOTAL_BOARD_SIZ;
     cb->g[m]->neighbors_count = 0;
-    cb->g[m]->stones.count = 1;
-    cb->g[m]->stones.coord[0] = m;
+    cb->g[m]->stones_count = 1;
+    cb->g[m]->first_stone = m;
+    cb->next_stone[m] = m;
 
     cb->unique_groups[cb->unique_groups_count] = m;
     cb->g[m]->unique_groups_idx = cb->unique_groups_count;
@@ -446,6 +487,9 @@ void cfg_init_board(
     cb->last_played = cb->last_eaten = NONE;
 
     memcpy(cb->hash, initial_3x3_hash, TOTAL_BOARD_SIZ * sizeof(u16));
+#if USE_PAT5_HASH
+    memcpy(cb->pat5_hash, initial_pat5_hash, TOTAL_BOARD_SIZ * sizeof(u64));
+#endif
     memset(cb->black_neighbors4, 0, TOTAL_BOARD_SIZ);
     memset(cb->white_neighbors4, 0, TOTAL_BOARD_SIZ);
     memset(cb->black_neighbors8, 0, TOTAL_BOARD_SIZ);
@@ -472,6 +516,9 @@ void cfg_from_board(
 ) {
     memcpy(dst, src, sizeof(board));
     memcpy(dst->hash, initial_3x3_hash, TOTAL_BOARD_SIZ * sizeof(u16));
+#if USE_PAT5_HASH
+    memcpy(dst->pat5_hash, initial_pat5_hash, TOTAL_BOARD_SIZ * sizeof(u64));
+#endif
     memset(dst->black_neighbors4, 0, TOTAL_BOARD_SIZ);
     memset(dst->white_neighbors4, 0, TOTAL_BOARD_SIZ);
     memset(dst->black_neighbors8, 0, TOTAL_BOARD_SIZ);
@@ -512,10 +559,11 @@ void cfg_board_clone(
         memcpy(g, s, ((char *)&s->neighbors[s->neighbors_count]) - ((char *)s));
 
         /* replace hard links to group information */
-        for (move j = 0; j < g->stones.count; ++j) {
-            move m = g->stones.coord[j];
+        move m = g->first_stone;
+        do {
             dst->g[m] = g;
-        }
+            m = dst->next_stone[m];
+        } while (m != g->first_stone);
     }
 
     assert(verify_cfg_board(dst));
@@ -549,10 +597,10 @@ static void cfg_board_kill_group(
     group * g,
     u8 own
 ) {
-    move id = g->stones.coord[0];
+    move id = g->first_stone;
+    move m = id;
 
-    for (move i = 0; i < g->stones.count; ++i) {
-        move m = g->stones.coord[i];
+    do {
 
         pos_set_free(cb, m, g->is_black);
         cb->p[m] = EMPTY;
@@ -561,7 +609,8 @@ static void cfg_board_kill_group(
 
         cb->empty.coord[cb->empty.count] = m;
         cb->empty.count++;
-    }
+        m = cb->next_stone[m];
+    } while (m != id);
 
     for (u8 i = 0; i < g->neighbors_count; ++i) {
         group * nei = cb->g[g->neighbors[i]];
@@ -584,10 +633,10 @@ static void cfg_board_kill_group2(
     u8 own,
     u64 * zobrist_hash
 ) {
-    move id = g->stones.coord[0];
+    move id = g->first_stone;
+    move m = id;
 
-    for (move i = 0; i < g->stones.count; ++i) {
-        move m = g->stones.coord[i];
+    do {
 
         zobrist_update_hash(zobrist_hash, m, cb->p[m]);
         pos_set_free(cb, m, g->is_black);
@@ -597,7 +646,8 @@ static void cfg_board_kill_group2(
 
         cb->empty.coord[cb->empty.count] = m;
         cb->empty.count++;
-    }
+        m = cb->next_stone[m];
+    } while (m != id);
 
     for (u8 i = 0; i < g->neighbors_count; ++i) {
         group * nei = cb->g[g->neighbors[i]];
@@ -619,12 +669,12 @@ static void cfg_board_kill_group3(
     group * g,
     u8 own,
     bool stones_removed[static TOTAL_BOARD_SIZ],
-    u8 rem_nei_libs[static LIB_BITMAP_SIZ]
+    u64 rem_nei_libs[static LIB_BITMAP_SIZ]
 ) {
-    move id = g->stones.coord[0];
+    move id = g->first_stone;
+    move m = id;
 
-    for (move i = 0; i < g->stones.count; ++i) {
-        move m = g->stones.coord[i];
+    do {
         assert(cb->p[m] != EMPTY);
         pos_set_free(cb, m, g->is_black);
         cb->p[m] = EMPTY;
@@ -634,7 +684,8 @@ static void cfg_board_kill_group3(
 
         cb->empty.coord[cb->empty.count] = m;
         cb->empty.count++;
-    }
+        m = cb->next_stone[m];
+    } while (m != id);
 
     for (u8 i = 0; i < g->neighbors_count; ++i) {
         group * nei = cb->g[g->neighbors[i]];
@@ -694,7 +745,7 @@ void just_play(
             n = cb->g[m + LEFT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group(cb, n, own);
                 one_stone_captured = m + LEFT;
             }
@@ -704,7 +755,7 @@ void just_play(
             n = cb->g[m + RIGHT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group(cb, n, own);
                 one_stone_captured = m + RIGHT;
             }
@@ -714,7 +765,7 @@ void just_play(
             n = cb->g[m + TOP];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group(cb, n, own);
                 one_stone_captured = m + TOP;
             }
@@ -724,7 +775,7 @@ void just_play(
             n = cb->g[m + BOTTOM];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group(cb, n, own);
                 one_stone_captured = m + BOTTOM;
             }
@@ -781,7 +832,7 @@ void just_play2(
             n = cb->g[m + LEFT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group2(cb, n, own, zobrist_hash);
                 one_stone_captured = m + LEFT;
             }
@@ -791,7 +842,7 @@ void just_play2(
             n = cb->g[m + RIGHT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group2(cb, n, own, zobrist_hash);
                 one_stone_captured = m + RIGHT;
             }
@@ -801,7 +852,7 @@ void just_play2(
             n = cb->g[m + TOP];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group2(cb, n, own, zobrist_hash);
                 one_stone_captured = m + TOP;
             }
@@ -811,7 +862,7 @@ void just_play2(
             n = cb->g[m + BOTTOM];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group2(cb, n, own, zobrist_hash);
                 one_stone_captured = m + BOTTOM;
             }
@@ -841,14 +892,15 @@ Assume play is legal and update the structure, capturing accordingly. Also
 updates a stone difference and fills a matrix of captured stones and a bitmap of
 liberties of neighbors of the captured groups. Does NOT clear the matrix and
 bitmap.
+RETURNS the number of stones captured
 */
-void just_play3(
+move just_play3(
     cfg_board * cb,
     bool is_black,
     move m,
     d16 * stone_difference,
     bool stones_removed[static TOTAL_BOARD_SIZ],
-    u8 rem_nei_libs[static LIB_BITMAP_SIZ]
+    u64 rem_nei_libs[static LIB_BITMAP_SIZ]
 ) {
     assert(verify_cfg_board(cb));
     assert(is_board_move(m));
@@ -870,7 +922,7 @@ void just_play3(
             n = cb->g[m + LEFT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group3(cb, n, own, stones_removed, rem_nei_libs);
                 one_stone_captured = m + LEFT;
             }
@@ -880,7 +932,7 @@ void just_play3(
             n = cb->g[m + RIGHT];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group3(cb, n, own, stones_removed, rem_nei_libs);
                 one_stone_captured = m + RIGHT;
             }
@@ -890,7 +942,7 @@ void just_play3(
             n = cb->g[m + TOP];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group3(cb, n, own, stones_removed, rem_nei_libs);
                 one_stone_captured = m + TOP;
             }
@@ -900,7 +952,7 @@ void just_play3(
             n = cb->g[m + BOTTOM];
 
             if (n != NULL && n->is_black != is_black && n->liberties == 0) {
-                captures += n->stones.count;
+                captures += n->stones_count;
                 cfg_board_kill_group3(cb, n, own, stones_removed, rem_nei_libs);
                 one_stone_captured = m + BOTTOM;
             }
@@ -928,6 +980,7 @@ void just_play3(
     }
 
     assert(verify_cfg_board(cb));
+    return captures;
 }
 
 static void add_group_liberties(
@@ -938,7 +991,7 @@ static void add_group_liberties(
 
     for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
         dst->ls[i] |= src->ls[i];
-        new_lib_count += active_bits_in_byte[dst->ls[i]];
+        new_lib_count += __builtin_popcountll(dst->ls[i]);
     }
 
     dst->liberties = new_lib_count;
@@ -969,9 +1022,8 @@ static void cfg_board_give_neighbors_libs(
     group ** neighbors,
     u8 neighbors_n
 ) {
-    for (move i = 0; i < g->stones.count; ++i) {
-        move m = g->stones.coord[i];
-
+    move m = g->first_stone;
+    do {
         for (u8 k = 0; k < neighbors_n; ++k) {
             if (!border_left[m] && cb->g[m + LEFT] == neighbors[k]) {
                 add_liberty(cb->g[m + LEFT], m);
@@ -989,7 +1041,9 @@ static void cfg_board_give_neighbors_libs(
                 add_liberty(cb->g[m + BOTTOM], m);
             }
         }
-    }
+
+        m = cb->next_stone[m];
+    } while (m != g->first_stone);
 }
 
 
@@ -1005,7 +1059,7 @@ bool ko_violation(
     assert(verify_cfg_board(cb));
     assert(is_board_move(m));
 
-    return cb->last_eaten == m && cb->g[cb->last_played]->stones.count == 1 &&
+    return cb->last_eaten == m && cb->g[cb->last_played]->stones_count == 1 &&
         cb->g[cb->last_played]->liberties == 1;
 }
 
@@ -1016,7 +1070,7 @@ RETURNS position in ko, or NONE
 move get_ko_play(
     const cfg_board * cb
 ) {
-    if (is_board_move(cb->last_eaten) && cb->g[cb->last_played]->stones.count == 1 &&
+    if (is_board_move(cb->last_eaten) && cb->g[cb->last_played]->stones_count == 1 &&
         cb->g[cb->last_played]->liberties == 1) {
         return cb->last_eaten;
     }
@@ -1049,7 +1103,7 @@ u8 libs_after_play(
     group g;
     g.liberties = 0;
     g.liberties_min_coord = TOTAL_BOARD_SIZ;
-    memset(g.ls, 0, LIB_BITMAP_SIZ);
+    memset(g.ls, 0, LIB_BITMAP_SIZ * sizeof(u64));
     add_liberty_unchecked(&g, m);
 
     /* list of same color neighbors */
@@ -1133,10 +1187,10 @@ u8 libs_after_play(
     /*
     Backup neighbor groups before being modified
     */
-    u8 neighbor_bak_ls[4][LIB_BITMAP_SIZ];
+    u64 neighbor_bak_ls[4][LIB_BITMAP_SIZ];
     u8 neighbor_bak_libs[4];
     for (u8 k = 0; k < neighbors_n; ++k) {
-        memcpy(neighbor_bak_ls[k], neighbors[k]->ls, LIB_BITMAP_SIZ);
+        memcpy(neighbor_bak_ls[k], neighbors[k]->ls, LIB_BITMAP_SIZ * sizeof(u64));
         neighbor_bak_libs[k] = neighbors[k]->liberties;
     }
 
@@ -1155,7 +1209,7 @@ u8 libs_after_play(
             add_liberty_unchecked(&g, m + LEFT);
             opt_neighbors[opt_neighbors_n++] = n;
             cfg_board_give_neighbors_libs(cb, n, neighbors, neighbors_n);
-            captured += n->stones.count;
+            captured += n->stones_count;
         }
     }
 
@@ -1176,7 +1230,7 @@ u8 libs_after_play(
             if (!found) {
                 opt_neighbors[opt_neighbors_n++] = n;
                 cfg_board_give_neighbors_libs(cb, n, neighbors, neighbors_n);
-                captured += n->stones.count;
+                captured += n->stones_count;
             }
         }
     }
@@ -1198,7 +1252,7 @@ u8 libs_after_play(
             if (!found) {
                 opt_neighbors[opt_neighbors_n++] = n;
                 cfg_board_give_neighbors_libs(cb, n, neighbors, neighbors_n);
-                captured += n->stones.count;
+                captured += n->stones_count;
             }
         }
     }
@@ -1220,7 +1274,7 @@ u8 libs_after_play(
             if (!found) {
                 opt_neighbors[opt_neighbors_n++] = n;
                 cfg_board_give_neighbors_libs(cb, n, neighbors, neighbors_n);
-                captured += n->stones.count;
+                captured += n->stones_count;
             }
         }
     }
@@ -1231,7 +1285,7 @@ u8 libs_after_play(
     */
     for (u8 k = 0; k < neighbors_n; ++k) {
         add_group_liberties(&g, neighbors[k]);
-        memcpy(neighbors[k]->ls, neighbor_bak_ls[k], LIB_BITMAP_SIZ);
+        memcpy(neighbors[k]->ls, neighbor_bak_ls[k], LIB_BITMAP_SIZ * sizeof(u64));
         neighbors[k]->liberties = neighbor_bak_libs[k];
     }
 
@@ -1266,7 +1320,7 @@ u8 safe_to_play2(
     group g;
     g.liberties = 0;
     g.liberties_min_coord = TOTAL_BOARD_SIZ;
-    memset(g.ls, 0, LIB_BITMAP_SIZ);
+    memset(g.ls, 0, LIB_BITMAP_SIZ * sizeof(u64));
     add_liberty_unchecked(&g, m);
 
     u8 probable_libs = 0;
@@ -1287,7 +1341,7 @@ u8 safe_to_play2(
             add_liberty_unchecked(&g, m + LEFT);
             *caps = true;
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 opt_neighbors[opt_neighbors_n++] = n;
             }
         }
@@ -1315,7 +1369,7 @@ u8 safe_to_play2(
             add_liberty_unchecked(&g, m + RIGHT);
             *caps = true;
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1353,7 +1407,7 @@ u8 safe_to_play2(
             add_liberty_unchecked(&g, m + TOP);
             *caps = true;
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1391,7 +1445,7 @@ u8 safe_to_play2(
             add_liberty_unchecked(&g, m + BOTTOM);
             *caps = true;
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1444,7 +1498,7 @@ u8 safe_to_play(
     group g;
     g.liberties = 0;
     g.liberties_min_coord = TOTAL_BOARD_SIZ;
-    memset(g.ls, 0, LIB_BITMAP_SIZ);
+    memset(g.ls, 0, LIB_BITMAP_SIZ * sizeof(u64));
     add_liberty_unchecked(&g, m);
 
     u8 probable_libs = 0;
@@ -1464,7 +1518,7 @@ u8 safe_to_play(
         } else if (n->liberties == 1) {
             add_liberty_unchecked(&g, m + LEFT);
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 opt_neighbors[opt_neighbors_n++] = n;
             }
         }
@@ -1491,7 +1545,7 @@ u8 safe_to_play(
         } else if (n->liberties == 1) {
             add_liberty_unchecked(&g, m + RIGHT);
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1528,7 +1582,7 @@ u8 safe_to_play(
         } else if (n->liberties == 1) {
             add_liberty_unchecked(&g, m + TOP);
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1565,7 +1619,7 @@ u8 safe_to_play(
         } else if (n->liberties == 1) {
             add_liberty_unchecked(&g, m + BOTTOM);
 
-            if (n->stones.count > 1) {
+            if (n->stones_count > 1) {
                 bool found = false;
                 for (u8 k = 0; k < opt_neighbors_n; ++k) {
                     if (opt_neighbors[k] == n) {
@@ -1833,7 +1887,7 @@ void fprint_cfg_board(
         if (cb->g[m] == NULL) {
             fprintf(fp, "   %c", EMPTY_STONE_CHAR);
         } else {
-            fprintf(fp, " %3u", cb->g[m]->stones.count);
+            fprintf(fp, " %3u", cb->g[m]->stones_count);
         }
 
         if (((m + 1) % BOARD_SIZ) == 0) {
@@ -1943,7 +1997,7 @@ bool verify_cfg_board(
                 return false;
             }
 
-            if (cb->unique_groups[g->unique_groups_idx] != g->stones.coord[0]) {
+            if (cb->unique_groups[g->unique_groups_idx] != g->first_stone) {
                 fprintf(stderr, "error: verify_cfg_board: unique groups linking error\n");
                 return false;
             }
@@ -1953,19 +2007,18 @@ bool verify_cfg_board(
                 return false;
             }
 
-            if (g->stones.count == 0) {
+            if (g->stones_count == 0) {
                 fprintf(stderr, "error: verify_cfg_board: illegal number of stones (0)\n");
                 return false;
             }
 
-            if (g->stones.count > TOTAL_BOARD_SIZ) {
+            if (g->stones_count > TOTAL_BOARD_SIZ) {
                 fprintf(stderr, "error: verify_cfg_board: illegal number of stones\n");
                 return false;
             }
 
-            for (move n = 0; n < g->stones.count; ++n) {
-                move s = g->stones.coord[n];
-
+            move s = g->first_stone;
+            for (move n = 0; n < g->stones_count; ++n) {
                 if (cb->p[s] == EMPTY) {
                     fprintf(stderr, "error: verify_cfg_board: group actually empty\n");
                     return false;
@@ -1980,6 +2033,13 @@ bool verify_cfg_board(
                     fprintf(stderr, "error: verify_cfg_board: stone and links mismatch\n");
                     return false;
                 }
+
+                s = cb->next_stone[s];
+            }
+
+            if (s != g->first_stone) {
+                fprintf(stderr, "error: verify_cfg_board: stone list length mismatch\n");
+                return false;
             }
 
             if (g->neighbors_count > MAX_NEIGHBORS) {
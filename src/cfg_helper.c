@@ -19,14 +19,13 @@ actual state changes nor tactical evaluation; though they may still be useful.
 
 extern u8 out_neighbors8[TOTAL_BOARD_SIZ];
 extern u8 out_neighbors4[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_side[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_diag[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_diag[TOTAL_BOARD_SIZ];
+extern nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 extern bool border_left[TOTAL_BOARD_SIZ];
 extern bool border_right[TOTAL_BOARD_SIZ];
 extern bool border_top[TOTAL_BOARD_SIZ];
 extern bool border_bottom[TOTAL_BOARD_SIZ];
-extern u8 active_bits_in_byte[256];
 
 
 /*
@@ -40,13 +39,7 @@ move get_1st_liberty(
 
     for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
         if (g->ls[i]) {
-            u8 j;
-            for (j = 0; j < 7; ++j) {
-                if (g->ls[i] & (1 << j)) {
-                    break;
-                }
-            }
-            return i * 8 + j;
+            return i * 64 + __builtin_ctzll(g->ls[i]);
         }
     }
 
@@ -65,15 +58,24 @@ move get_next_liberty(
     move start /* exclusive */
 ) {
     ++start;
+    if (start >= TOTAL_BOARD_SIZ) {
+        return NONE;
+    }
+
+    u8 i = start / 64;
+    u64 word = g->ls[i] & (~0ULL << (start % 64));
 
-    for (move m = start; m < TOTAL_BOARD_SIZ; ++m) {
-        u8 mask = (1 << (m % 8));
-        if (g->ls[m / 8] & mask) {
-            return m;
+    while (true) {
+        if (word) {
+            return i * 64 + __builtin_ctzll(word);
         }
-    }
 
-    return NONE;
+        if (++i == LIB_BITMAP_SIZ) {
+            return NONE;
+        }
+
+        word = g->ls[i];
+    }
 }
 
 
@@ -191,16 +193,16 @@ u16 max_neighbor_group_stones(
     u16 ret = 0;
 
     if (!border_left[m] && cb->p[m + LEFT] == stone) {
-        ret = cb->g[m + LEFT]->stones.count;
+        ret = cb->g[m + LEFT]->stones_count;
     }
-    if (!border_right[m] && cb->p[m + RIGHT] == stone && cb->g[m + RIGHT]->stones.count > ret) {
-        ret = cb->g[m + RIGHT]->stones.count;
+    if (!border_right[m] && cb->p[m + RIGHT] == stone && cb->g[m + RIGHT]->stones_count > ret) {
+        ret = cb->g[m + RIGHT]->stones_count;
     }
-    if (!border_top[m] && cb->p[m + TOP] == stone && cb->g[m + TOP]->stones.count > ret) {
-        ret = cb->g[m + TOP]->stones.count;
+    if (!border_top[m] && cb->p[m + TOP] == stone && cb->g[m + TOP]->stones_count > ret) {
+        ret = cb->g[m + TOP]->stones_count;
     }
-    if (!border_bottom[m] && cb->p[m + BOTTOM] == stone && cb->g[m + BOTTOM]->stones.count > ret) {
-        ret = cb->g[m + BOTTOM]->stones.count;
+    if (!border_bottom[m] && cb->p[m + BOTTOM] == stone && cb->g[m + BOTTOM]->stones_count > ret) {
+        ret = cb->g[m + BOTTOM]->stones_count;
     }
 
     return ret;
@@ -214,7 +216,7 @@ bool groups_same_liberties(
     const group * restrict g1,
     const group * restrict g2
 ) {
-    return memcmp(g1->ls, g2->ls, LIB_BITMAP_SIZ) == 0;
+    return memcmp(g1->ls, g2->ls, LIB_BITMAP_SIZ * sizeof(u64)) == 0;
 }
 
 /*
@@ -245,7 +247,7 @@ u8 groups_shared_liberties(
     u8 ret = 0;
 
     for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
-        ret += active_bits_in_byte[g1->ls[i] & g2->ls[i]];
+        ret += __builtin_popcountll(g1->ls[i] & g2->ls[i]);
     }
 
     return ret;
@@ -2,20 +2,23 @@
 Initialization of game wide constants based on board size.
 
 To use declare as external:
-d16 komi;
+__thread d16 komi;
 u8 out_neighbors8[TOTAL_BOARD_SIZ];
 u8 out_neighbors4[TOTAL_BOARD_SIZ];
-move_seq neighbors_side[TOTAL_BOARD_SIZ];
-move_seq neighbors_diag[TOTAL_BOARD_SIZ];
-move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_diag[TOTAL_BOARD_SIZ];
+nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 bool border_left[TOTAL_BOARD_SIZ];
 bool border_right[TOTAL_BOARD_SIZ];
 bool border_top[TOTAL_BOARD_SIZ];
 bool border_bottom[TOTAL_BOARD_SIZ];
 u8 distances_to_border[TOTAL_BOARD_SIZ];
-move_seq nei_dst_3[TOTAL_BOARD_SIZ];
-move_seq nei_dst_4[TOTAL_BOARD_SIZ];
-u8 active_bits_in_byte[256];
+nei_seq12 nei_dst_2[TOTAL_BOARD_SIZ];
+nei_seq24 nei_dst_3[TOTAL_BOARD_SIZ];
+nei_seq40 nei_dst_4[TOTAL_BOARD_SIZ];
+u8 nakade_shape[65536];
+u8 black_nakade_side[65536];
+u8 white_nakade_side[65536];
 */
 
 #include "config.h"
@@ -27,37 +30,37 @@ u8 active_bits_in_byte[256];
 #include "flog.h"
 #include "pat3.h"
 #include "move.h"
+#include "tactical.h"
 #include "types.h"
 
-d16 komi = DEFAULT_KOMI;
+/* per thread, so that independent engines can use different values; searches
+set it in all their threads */
+__thread d16 komi = DEFAULT_KOMI;
 u8 out_neighbors8[TOTAL_BOARD_SIZ];
 u8 out_neighbors4[TOTAL_BOARD_SIZ];
-move_seq neighbors_side[TOTAL_BOARD_SIZ];
-move_seq neighbors_diag[TOTAL_BOARD_SIZ];
-move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_diag[TOTAL_BOARD_SIZ];
+nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 bool border_left[TOTAL_BOARD_SIZ];
 bool border_right[TOTAL_BOARD_SIZ];
 bool border_top[TOTAL_BOARD_SIZ];
 bool border_bottom[TOTAL_BOARD_SIZ];
 u8 distances_to_border[TOTAL_BOARD_SIZ];
-move_seq nei_dst_3[TOTAL_BOARD_SIZ];
-move_seq nei_dst_4[TOTAL_BOARD_SIZ];
+nei_seq12 nei_dst_2[TOTAL_BOARD_SIZ];
+nei_seq24 nei_dst_3[TOTAL_BOARD_SIZ];
+nei_seq40 nei_dst_4[TOTAL_BOARD_SIZ];
 
-u8 active_bits_in_byte[256];
 bool black_eye[65536];
 bool white_eye[65536];
 
-static bool board_constants_inited = false;
+/*
+Nakade shapes by 3x3 neighborhood, see init_nakade_table.
+*/
+u8 nakade_shape[65536];
+u8 black_nakade_side[65536];
+u8 white_nakade_side[65536];
 
-static u8 count_bits(u8 v) {
-    u8 bits = 0;
-    while (v > 0) {
-        if ((v & 1) == 1)
-            ++bits;
-        v /= 2;
-    }
-    return bits;
-}
+static bool board_constants_inited = false;
 
 /*
 An eye is a point that may eventually become untakeable (without playing
@@ -172,6 +175,23 @@ static u8 _white_neighbors8(
     return ret;
 }
 
+/*
+Copies a move_seq into the storage of a fixed capacity neighbor table entry.
+*/
+static void compact_moves(
+    move * dst,
+    u8 * count,
+    u8 capacity,
+    const move_seq * src
+) {
+    if (src->count > capacity) {
+        flog_crit("cnst", "neighbor table capacity exceeded");
+    }
+
+    memcpy(dst, src->coord, src->count * sizeof(move));
+    *count = src->count;
+}
+
 static void init_eye_table() {
     u8 dst[3][3];
 
@@ -188,6 +208,77 @@ static void init_eye_table() {
     }
 }
 
+/*
+Classifies an empty intersection adjacent to the vital point of a nakade shape
+of the player, by the 3x3 neighborhood of the intersection:
+NAKADE_SIDE_EDGE if it is closed on three sides and the opponent has at most
+one diagonal stone (none at the border); NAKADE_SIDE_CORNER if it is a corner
+of a bulky five or rabbity six - closed on two sides and on all diagonals.
+*/
+static u8 nakade_side_class(
+    u8 own4,
+    u8 own8,
+    u8 out4,
+    u8 out8,
+    u8 opt8
+) {
+    if (own4 + out4 == 3) {
+        if ((out4 == 0 && opt8 > 1) || (out4 > 0 && opt8 > 0)) {
+            return 0;
+        }
+        return NAKADE_SIDE_EDGE;
+    }
+
+    if (own4 + out4 == 2 && opt8 == 0 && own8 + out8 == 4) {
+        return NAKADE_SIDE_CORNER;
+    }
+
+    return 0;
+}
+
+/*
+The nakade tables allow is_nakade to work with the incrementally updated 3x3
+neighborhood hashes, instead of the original intersection neighbor counts.
+nakade_shape has for the vital point the color of the surrounding stones, the
+kind of shape and the estimate of the group size in nakade.
+*/
+static void init_nakade_table() {
+    u8 dst[3][3];
+
+    for (u32 i = 0; i < 65536; ++i) {
+        string_to_pat3(dst, i);
+
+        u8 out4 = _out_neighbors4(dst);
+        u8 out8 = out4;
+        out8 += (dst[0][0] == ILLEGAL) + (dst[2][0] == ILLEGAL) + (dst[0][2] == ILLEGAL) + (dst[2][2] == ILLEGAL);
+        u8 b4 = _black_neighbors4(dst);
+        u8 w4 = _white_neighbors4(dst);
+        u8 b8 = _black_neighbors8(dst);
+        u8 w8 = _white_neighbors8(dst);
+
+        black_nakade_side[i] = nakade_side_class(b4, b8, out4, out8, w8);
+        white_nakade_side[i] = nakade_side_class(w4, w8, out4, out8, b8);
+
+        nakade_shape[i] = 0;
+
+        if ((b8 > 0) == (w8 > 0)) {
+            continue;
+        }
+
+        u8 color = b8 > 0 ? NAKADE_BLACK : NAKADE_WHITE;
+        u8 on4 = (b8 > 0 ? b4 : w4) + out4;
+        u8 on8 = (b8 > 0 ? b8 : w8) + out8;
+
+        if (on4 < 3 && on8 == on4 + 4) {
+            /* Straight three, bent three, pyramid four or crossed five */
+            nakade_shape[i] = color | ((4 - on4) * 4 + 4);
+        } else if (on4 < 2 && on8 == on4 + 3) {
+            /* Bulky five or rabbity six */
+            nakade_shape[i] = color | NAKADE_BULKY | ((5 - on4) * 5);
+        }
+    }
+}
+
 /*
 Initialize a series of constants based on the board size in use.
 */
@@ -198,8 +289,16 @@ void board_constants_init() {
 
     board_constants_inited = true;
 
+    move_seq * tmp = malloc(TOTAL_BOARD_SIZ * sizeof(move_seq));
+    if (tmp == NULL) {
+        flog_crit("cnst", "system out of memory");
+    }
+
     /* Adjacent neighbor positions */
-    init_moves_by_distance(neighbors_side, 1, false);
+    init_moves_by_distance(tmp, 1, false);
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        compact_moves(neighbors_side[m].coord, &neighbors_side[m].count, NEI_SIDE_MAX, &tmp[m]);
+    }
 
     memset(border_left, false, TOTAL_BOARD_SIZ);
     memset(border_right, false, TOTAL_BOARD_SIZ);
@@ -224,25 +323,30 @@ void board_constants_init() {
                 border_bottom[a] = true;
             }
 
-            move c = 0;
+            tmp[a].count = 0;
             for (d8 i = 0; i < BOARD_SIZ; ++i) {
                 for (d8 j = 0; j < BOARD_SIZ; ++j) {
                     if (abs(x - i) == 1 && abs(y - j) == 1) {
-                        move b = coord_to_move(i, j);
-                        neighbors_diag[a].coord[c] = b;
-                        ++c;
+                        tmp[a].coord[tmp[a].count++] = coord_to_move(i, j);
                     }
                 }
             }
 
-            neighbors_diag[a].count = c;
+            compact_moves(neighbors_diag[a].coord, &neighbors_diag[a].count, NEI_DIAG_MAX, &tmp[a]);
         }
     }
 
     /* 3x3 positions excluding self */
-    memcpy(neighbors_3x3, neighbors_side, TOTAL_BOARD_SIZ * sizeof(move_seq));
     for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
-        copy_moves(&neighbors_3x3[m], &neighbors_diag[m]);
+        tmp[m].count = 0;
+        for (u8 k = 0; k < neighbors_side[m].count; ++k) {
+            tmp[m].coord[tmp[m].count++] = neighbors_side[m].coord[k];
+        }
+        for (u8 k = 0; k < neighbors_diag[m].count; ++k) {
+            tmp[m].coord[tmp[m].count++] = neighbors_diag[m].coord[k];
+        }
+
+        compact_moves(neighbors_3x3[m].coord, &neighbors_3x3[m].count, NEI_3X3_MAX, &tmp[m]);
     }
 
     memset(out_neighbors4, 0, TOTAL_BOARD_SIZ);
@@ -256,18 +360,29 @@ void board_constants_init() {
     out_neighbors4[coord_to_move(0, 0)] = out_neighbors4[coord_to_move(BOARD_SIZ - 1, 0)] = out_neighbors4[coord_to_move(0, BOARD_SIZ - 1)] = out_neighbors4[coord_to_move(BOARD_SIZ - 1, BOARD_SIZ - 1)] = 2;
     out_neighbors8[coord_to_move(0, 0)] = out_neighbors8[coord_to_move(BOARD_SIZ - 1, 0)] = out_neighbors8[coord_to_move(0, BOARD_SIZ - 1)] = out_neighbors8[coord_to_move(BOARD_SIZ - 1, BOARD_SIZ - 1)] = 5;
 
-    for (u16 i = 0; i < 256; ++i) {
-        active_bits_in_byte[i] = count_bits(i);
-    }
-
     for (u8 i = 0; i < BOARD_SIZ; ++i) {
         for (u8 j = 0; j < BOARD_SIZ; ++j) {
             distances_to_border[coord_to_move(i, j)] = DISTANCE_TO_BORDER(i, j);
         }
     }
 
-    init_moves_by_distance(nei_dst_3, 3, false);
-    init_moves_by_distance(nei_dst_4, 4, false);
+    init_moves_by_distance(tmp, 2, false);
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        compact_moves(nei_dst_2[m].coord, &nei_dst_2[m].count, NEI_DST_2_MAX, &tmp[m]);
+    }
+
+    init_moves_by_distance(tmp, 3, false);
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        compact_moves(nei_dst_3[m].coord, &nei_dst_3[m].count, NEI_DST_3_MAX, &tmp[m]);
+    }
+
+    init_moves_by_distance(tmp, 4, false);
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        compact_moves(nei_dst_4[m].coord, &nei_dst_4[m].count, NEI_DST_4_MAX, &tmp[m]);
+    }
+
+    free(tmp);
 
     init_eye_table();
+    init_nakade_table();
 }
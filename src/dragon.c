@@ -29,7 +29,7 @@ OOXXX.XO
 #include "tactical.h"
 #include "types.h"
 
-extern move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+extern nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 
 extern bool border_left[TOTAL_BOARD_SIZ];
 extern bool border_right[TOTAL_BOARD_SIZ];
@@ -7,18 +7,22 @@ maintenance if needed.
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <omp.h>
 #include <sys/types.h> /* opendir */
 #include <dirent.h> /* opendir */
 
 #include "alloc.h"
 #include "board.h"
 #include "cfg_board.h"
+#include "engine.h"
 #include "flog.h"
 #include "game_record.h"
 #include "mcts.h"
 #include "opening_book.h"
 #include "stringm.h"
+#include "timem.h"
 #include "transpositions.h"
 #include "types.h"
 #include "version.h"
@@ -30,6 +34,31 @@ bool tt_requires_maintenance = false; /* set after MCTS start/resume call */
 
 static char _data_folder[MAX_PATH_SIZ] = DEFAULT_DATA_PATH;
 
+struct __engine_ctx_ {
+    tt_table * tt;
+    mcts_state * ms;
+    d16 komi;
+    u16 threads;
+    bool requires_maintenance;
+    bool has_game; /* false if the position was set without its game */
+    bool is_black;
+    board position;
+    game_record game;
+};
+
+/*
+Selections of the calling thread replaced while an engine is in use.
+*/
+typedef struct __engine_selection_ {
+    tt_table * tt;
+    mcts_state * ms;
+    d16 komi;
+    int threads;
+} engine_selection;
+
+/* from constants */
+extern __thread d16 komi;
+
 /*
 Produce a short version string. Does not include program name.
 */
@@ -111,7 +140,7 @@ void set_use_of_opening_book(
 
 /*
 Evaluates the position given the time available to think, by using a number of
-strategies in succession.
+strategies in succession. The search may be extended up to max_stop_time.
 RETURNS true if a play or pass is suggested instead of resigning
 */
 bool evaluate_position_timed(
@@ -119,7 +148,8 @@ bool evaluate_position_timed(
     bool is_black,
     out_board * out_b,
     u64 stop_time,
-    u64 early_stop_time
+    u64 early_stop_time,
+    u64 max_stop_time
 ) {
     if (use_opening_book) {
         board tmp;
@@ -132,7 +162,7 @@ bool evaluate_position_timed(
         }
     }
 
-    bool ret = mcts_start_timed(out_b, b, is_black, stop_time, early_stop_time);
+    bool ret = mcts_start_timed(out_b, b, is_black, stop_time, early_stop_time, max_stop_time);
     tt_requires_maintenance = true;
     return ret;
 }
@@ -164,17 +194,48 @@ bool evaluate_position_sims(
 }
 
 /*
-Evaluate the position for a short amount of time, ignoring the quality matrix
-produced.
+Evaluate the position until the interrupt flag is set by another thread,
+ignoring the quality matrix produced.
 */
 void evaluate_in_background(
     const board * b,
-    bool is_black
+    bool is_black,
+    const volatile bool * interrupt
+) {
+    mcts_resume(b, is_black, interrupt);
+    tt_requires_maintenance = true;
+}
+
+/*
+Evaluate the position until the interrupt flag is set by another thread,
+reporting a snapshot of the best plays every interval milliseconds.
+*/
+void analyze_in_background(
+    const board * b,
+    bool is_black,
+    const volatile bool * interrupt,
+    u32 interval,
+    void (*report)(const analysis_snapshot *)
 ) {
-    mcts_resume(b, is_black);
+    mcts_analyze(b, is_black, interrupt, interval, report);
     tt_requires_maintenance = true;
 }
 
+/*
+Interrupts the evaluation currently running, or the next one to be started,
+until clear_evaluation_interrupt is called. May be called from another thread.
+*/
+void interrupt_evaluation() {
+    mcts_interrupt();
+}
+
+/*
+Allows new evaluations to run after a call to interrupt_evaluation.
+*/
+void clear_evaluation_interrupt() {
+    mcts_clear_interrupt();
+}
+
 static void freed_mem_message(
     u32 states
 ) {
@@ -238,6 +299,236 @@ void assert_data_folder_exists() {
 
 
 
+/*
+Creates an independent engine with memory_mbs MiB for its transpositions table,
+searching with the number of threads given, or with 0 the number of threads
+OpenMP would use by default in the calling thread. Should not be called while
+other engines are searching.
+RETURNS the new engine
+*/
+engine_ctx * engine_create(
+    u64 memory_mbs,
+    u16 threads
+) {
+    mcts_init();
+    if (use_opening_book) {
+        opening_book_init();
+    }
+
+    engine_ctx * ctx = malloc(sizeof(engine_ctx));
+    if (ctx == NULL) {
+        flog_crit("engn", "system out of memory");
+    }
+
+    ctx->tt = tt_create(memory_mbs);
+    ctx->ms = mcts_state_create();
+    ctx->komi = DEFAULT_KOMI;
+    ctx->threads = MIN(threads, MAXIMUM_NUM_THREADS);
+    ctx->requires_maintenance = false;
+    clear_game_record(&ctx->game);
+    engine_set_position(ctx, &ctx->game);
+    return ctx;
+}
+
+/*
+Frees an engine that is not searching.
+*/
+void engine_destroy(
+    engine_ctx * ctx
+) {
+    tt_destroy(ctx->tt);
+    mcts_state_destroy(ctx->ms);
+    free(ctx);
+}
+
+/*
+Sets the komi used by the engine, multiplied by 2.
+*/
+void engine_set_komi(
+    engine_ctx * ctx,
+    d16 new_komi
+) {
+    ctx->komi = new_komi;
+}
+
+/*
+Sets the game the engine searches from, which is copied. The search trees of
+positions no longer reachable are freed before the next search.
+*/
+void engine_set_position(
+    engine_ctx * ctx,
+    const game_record * gr
+) {
+    if (gr != &ctx->game) {
+        memcpy(&ctx->game, gr, sizeof(game_record));
+    }
+
+    current_game_state(&ctx->position, &ctx->game);
+    ctx->is_black = current_player_color(&ctx->game);
+    ctx->has_game = true;
+}
+
+/*
+Sets the position the engine searches from without the game that led to it, so
+positional superko is only tested in the search itself.
+*/
+void engine_set_board(
+    engine_ctx * ctx,
+    const board * b,
+    bool is_black
+) {
+    memcpy(&ctx->position, b, sizeof(board));
+    ctx->is_black = is_black;
+    ctx->has_game = false;
+}
+
+static void engine_enter(
+    engine_ctx * ctx,
+    engine_selection * prev
+) {
+    prev->tt = tt_selected();
+    prev->ms = mcts_select_state(ctx->ms);
+    prev->komi = komi;
+    prev->threads = omp_get_max_threads();
+
+    tt_select(ctx->tt);
+    komi = ctx->komi;
+    omp_set_num_threads(MIN(ctx->threads > 0 ? ctx->threads : prev->threads,
+        MAXIMUM_NUM_THREADS));
+}
+
+static void engine_leave(
+    const engine_selection * prev
+) {
+    tt_select(prev->tt);
+    mcts_select_state(prev->ms);
+    komi = prev->komi;
+    omp_set_num_threads(prev->threads);
+}
+
+/*
+Prepares the search of the current position of an engine already entered.
+RETURNS true if the evaluation was found in the opening book
+*/
+static bool engine_prepare(
+    engine_ctx * ctx,
+    board * b,
+    bool * is_black,
+    out_board * out_b
+) {
+    memcpy(b, &ctx->position, sizeof(board));
+    *is_black = ctx->is_black;
+
+    if (ctx->requires_maintenance) {
+        tt_clean_unreachable(b, *is_black);
+        ctx->requires_maintenance = false;
+    }
+
+    if (use_opening_book) {
+        board tmp;
+        memcpy(&tmp, b, sizeof(board));
+        d8 reduction = reduce_auto(&tmp, *is_black);
+
+        if (opening_book(out_b, &tmp)) {
+            out_board_revert_reduce(out_b, reduction);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+Searches the current position of the engine for the player to play, for
+milliseconds of time.
+RETURNS true if a play or pass is suggested instead of resigning
+*/
+bool engine_search_timed(
+    engine_ctx * ctx,
+    u32 milliseconds,
+    out_board * out_b
+) {
+    u64 curr_time = current_time_in_millis();
+    engine_selection prev;
+    engine_enter(ctx, &prev);
+
+    board b;
+    bool is_black;
+    bool ret = true;
+
+    if (!engine_prepare(ctx, &b, &is_black, out_b)) {
+        u64 stop_time = curr_time + milliseconds;
+        u64 early_stop_time = curr_time + (milliseconds / 4);
+        ret = mcts_start_timed(out_b, &b, is_black, stop_time, early_stop_time, stop_time);
+        ctx->requires_maintenance = true;
+    }
+
+    engine_leave(&prev);
+    return ret;
+}
+
+/*
+Searches the current position of the engine for the player to play, for a
+number of simulations.
+RETURNS true if a play or pass is suggested instead of resigning
+*/
+bool engine_search_sims(
+    engine_ctx * ctx,
+    u32 simulations,
+    out_board * out_b
+) {
+    engine_selection prev;
+    engine_enter(ctx, &prev);
+
+    board b;
+    bool is_black;
+    bool ret = true;
+
+    if (!engine_prepare(ctx, &b, &is_black, out_b)) {
+        ret = mcts_start_sims(out_b, &b, is_black, simulations);
+        ctx->requires_maintenance = true;
+    }
+
+    engine_leave(&prev);
+    return ret;
+}
+
+/*
+Selects the best legal play of an evaluation of the current position of the
+engine.
+RETURNS the play selected, or PASS
+*/
+move engine_best_play(
+    const engine_ctx * ctx,
+    const out_board * out_b
+) {
+    if (!ctx->has_game) {
+        return select_play_fast(out_b);
+    }
 
+    return select_play(out_b, ctx->is_black, &ctx->game);
+}
 
+/*
+Interrupts the search of the engine currently running, or the next one to be
+started, until engine_clear_interrupt is called. May be called from another
+thread.
+*/
+void engine_interrupt(
+    engine_ctx * ctx
+) {
+    mcts_state * prev = mcts_select_state(ctx->ms);
+    mcts_interrupt();
+    mcts_select_state(prev);
+}
 
+/*
+Allows new searches of the engine to run after a call to engine_interrupt.
+*/
+void engine_clear_interrupt(
+    engine_ctx * ctx
+) {
+    mcts_state * prev = mcts_select_state(ctx->ms);
+    mcts_clear_interrupt();
+    mcts_select_state(prev);
+}
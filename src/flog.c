@@ -62,7 +62,7 @@ extern u16 pl_skip_nakade;
 extern u16 pl_skip_pattern;
 extern u16 pl_skip_capture;
 extern u16 pl_ban_self_atari;
-extern d16 komi;
+extern __thread d16 komi;
 
 static void open_log_file();
 
@@ -323,7 +323,7 @@ void build_info(
     idx += snprintf(dst + idx, MAX_PAGE_SIZ - idx, "Playout depth over number of empty points: %u\n", MAX_PLAYOUT_DEPTH_OVER_EMPTY);
     idx += snprintf(dst + idx, MAX_PAGE_SIZ - idx, "Mercy threshold: %u stones\n", MERCY_THRESHOLD);
 
-    idx += snprintf(dst + idx, MAX_PAGE_SIZ - idx, "Constant latency compensation: %u ms\n", LATENCY_COMPENSATION);
+    idx += snprintf(dst + idx, MAX_PAGE_SIZ - idx, "Latency compensation: %u ms (%u plays measured)\n", latency_compensation(), latency_sample_count());
     idx += snprintf(dst + idx, MAX_PAGE_SIZ - idx, "Time allotment factor: %.2f\n", TIME_ALLOT_FACTOR);
 
     u32 num_threads;
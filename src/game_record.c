@@ -28,8 +28,27 @@ http://www.weddslist.com/kgs/past/superko.html
 #include "stringm.h"
 #include "types.h"
 
-static board current_game_bak;
-static bool current_game_bak_set = false;
+/*
+Last game state produced by current_game_state, per thread, and the plays of
+the record it was produced from. Records may be swapped by copying, as the game
+of each server session is, so the plays are compared instead of relying only on
+the record being modified through this module.
+*/
+static __thread board current_game_bak;
+static __thread bool current_game_bak_set = false;
+static __thread move_seq current_game_bak_handicap;
+static __thread move current_game_bak_moves[MAX_GAME_LENGTH];
+static __thread u16 current_game_bak_turns;
+
+static bool current_game_bak_matches(
+    const game_record * src
+) {
+    return current_game_bak_set && current_game_bak_turns == src->turns &&
+        current_game_bak_handicap.count == src->handicap_stones.count &&
+        memcmp(current_game_bak_handicap.coord, src->handicap_stones.coord,
+        src->handicap_stones.count * sizeof(move)) == 0 &&
+        memcmp(current_game_bak_moves, src->moves, src->turns * sizeof(move)) == 0;
+}
 
 static void apply_handicap_stones(
     board * b,
@@ -433,7 +452,7 @@ void current_game_state(
     board * dst,
     const game_record * src
 ) {
-    if (!current_game_bak_set) {
+    if (!current_game_bak_matches(src)) {
         clear_board(&current_game_bak);
         apply_handicap_stones(&current_game_bak, src);
 
@@ -448,6 +467,9 @@ void current_game_state(
             is_black = !is_black;
         }
 
+        memcpy(&current_game_bak_handicap, &src->handicap_stones, sizeof(move_seq));
+        memcpy(current_game_bak_moves, src->moves, src->turns * sizeof(move));
+        current_game_bak_turns = src->turns;
         current_game_bak_set = true;
     }
 
@@ -56,24 +56,14 @@ double uct1_rave(
 
 /*
 Batch update of all transitions that were visited anytime after the current
-state (if visited first by the player).
+state (if visited first by the player), for one or more simulations.
+For each intersection is given the number of simulations where it was first
+visited by the player, and how many of those the player won.
 */
 void update_amaf_stats(
     tt_stats * stats,
-    const u8 traversed[static TOTAL_BOARD_SIZ],
-    bool is_black,
-    double z
-);
-
-/*
-Batch update of all transitions that were visited anytime after the current
-state (if visited first by the player).
-This version only adds losses -- it is meant to be used when a draw occurs.
-*/
-void update_amaf_stats2(
-    tt_stats * stats,
-    const u8 traversed[static TOTAL_BOARD_SIZ],
-    bool is_black
+    const u16 visits[static TOTAL_BOARD_SIZ],
+    const u16 wins[static TOTAL_BOARD_SIZ]
 );
 
 #endif
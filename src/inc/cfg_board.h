@@ -28,10 +28,18 @@ explicitly said so.
 #include "move.h"
 #include "types.h"
 
-#define LIB_BITMAP_SIZ (TOTAL_BOARD_SIZ / 8 + 1)
+/* liberty bitmaps are stored in 64-bit words */
+#define LIB_BITMAP_SIZ ((TOTAL_BOARD_SIZ + 63) / 64)
 
 #define MAX_GROUPS (((BOARD_SIZ / 2) + 1) * BOARD_SIZ)
 
+/*
+Whether to also maintain 64-bit hashes of the 5x5 diamond neighborhood of every
+intersection, for large pattern matching (see pat5.h). Costs a few more memory
+writes per stone placed or captured.
+*/
+#define USE_PAT5_HASH 1
+
 #define MAX_NEIGHBORS \
     (((BOARD_SIZ / 2) + 1) * (BOARD_SIZ / 2) + (BOARD_SIZ / 2) + 1)
 
@@ -39,9 +47,10 @@ typedef struct __group_ {
     bool is_black;
     u8 unique_groups_idx;
     u8 liberties;
-    u8 ls[LIB_BITMAP_SIZ];
+    u64 ls[LIB_BITMAP_SIZ];
     move liberties_min_coord;
-    move_seq stones; /* stone 0 if used as representative */
+    move first_stone; /* representative stone, used as group ID */
+    move stones_count; /* the stones are linked in cfg_board next_stone */
     u8 neighbors_count;
     move neighbors[MAX_NEIGHBORS]; /* move id of neighbors */
     u8 eyes;
@@ -53,12 +62,19 @@ typedef struct __group_ {
 unique_groups stores IDs of groups, which are the value of a stone that belongs
 to that group, and the g field specifies the group that possesses a certain
 intersection (or NULL). So to get the group do cb->g[unique_groups[idx]].
+
+The stones of each group form a circular list in next_stone, starting at any of
+its stones. Uniting two groups splices both lists, relabeling only the stones of
+the smaller group.
 */
 typedef struct __cfg_board_ {
     u8 p[TOTAL_BOARD_SIZ];
     move last_eaten;
     move last_played;
     u16 hash[TOTAL_BOARD_SIZ]; /* hash of the 3x3 neighborhoods */
+#if USE_PAT5_HASH
+    u64 pat5_hash[TOTAL_BOARD_SIZ]; /* hash of the 5x5 diamond neighborhoods */
+#endif
     move_seq empty; /* free positions of the board */
     u8 black_neighbors4[TOTAL_BOARD_SIZ]; /* stones in the neighborhood */
     u8 white_neighbors4[TOTAL_BOARD_SIZ];
@@ -66,6 +82,7 @@ typedef struct __cfg_board_ {
     u8 white_neighbors8[TOTAL_BOARD_SIZ];
     u8 unique_groups_count;
     move unique_groups[MAX_GROUPS];
+    move next_stone[TOTAL_BOARD_SIZ]; /* next stone of the same group */
     group * g[TOTAL_BOARD_SIZ]; /* CFG stone groups or NULL if empty */
 } cfg_board;
 
@@ -137,14 +154,15 @@ Assume play is legal and update the structure, capturing accordingly. Also
 updates a stone difference and fills a matrix of captured stones and a bitmap of
 liberties of neighbors of the captured groups. Does NOT clear the matrix and
 bitmap.
+RETURNS the number of stones captured
 */
-void just_play3(
+move just_play3(
     cfg_board * cb,
     bool is_black,
     move m,
     d16 * stone_difference,
     bool stones_removed[static TOTAL_BOARD_SIZ],
-    u8 rem_nei_libs[static LIB_BITMAP_SIZ]
+    u64 rem_nei_libs[static LIB_BITMAP_SIZ]
 );
 
 /*
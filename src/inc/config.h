@@ -41,8 +41,9 @@ EXPECTED: 10 to 64000
 /*
 When playing online the communication can suffer a small latency, which can
 negatively impact the game time control and cause Matilda to run out of time.
-If this is the case you can set a constant latency compensation so that it
-thinks less per turn, but doesn't timeout.
+The latency is estimated while playing, from the time_left reports of the
+server, and compensated by thinking less per turn. This is the latency assumed
+before any play is measured.
 The value is in milliseconds.
 
 EXPECTED: 2 to 400
@@ -50,6 +51,17 @@ EXPECTED: 2 to 400
 #define LATENCY_COMPENSATION 0
 
 
+/*
+Default and maximum number of games played at the same time in server mode.
+Each game may use an equal share of the transpositions table memory.
+This can also be changed at startup with the flag --sessions.
+
+EXPECTED: 1 to 128
+*/
+#define DEFAULT_SERVER_SESSIONS 16
+#define MAX_SERVER_SESSIONS 128
+
+
 /*
 Data folder. This folder needs to be found and contain at least a Zobrist
 codification table and handicaps for the board size in use.
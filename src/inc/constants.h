@@ -2,20 +2,20 @@
 Initialization of game wide constants based on board size.
 
 To use declare as external:
-d16 komi;
+__thread d16 komi;
 u8 out_neighbors8[TOTAL_BOARD_SIZ];
 u8 out_neighbors4[TOTAL_BOARD_SIZ];
-move_seq neighbors_side[TOTAL_BOARD_SIZ];
-move_seq neighbors_diag[TOTAL_BOARD_SIZ];
-move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+nei_seq4 neighbors_diag[TOTAL_BOARD_SIZ];
+nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 bool border_left[TOTAL_BOARD_SIZ];
 bool border_right[TOTAL_BOARD_SIZ];
 bool border_top[TOTAL_BOARD_SIZ];
 bool border_bottom[TOTAL_BOARD_SIZ];
 u8 distances_to_border[TOTAL_BOARD_SIZ];
-move_seq nei_dst_3[TOTAL_BOARD_SIZ];
-move_seq nei_dst_4[TOTAL_BOARD_SIZ];
-u8 active_bits_in_byte[256];
+nei_seq12 nei_dst_2[TOTAL_BOARD_SIZ];
+nei_seq24 nei_dst_3[TOTAL_BOARD_SIZ];
+nei_seq40 nei_dst_4[TOTAL_BOARD_SIZ];
 */
 
 #ifndef MATILDA_CONSTANTS_H
@@ -11,6 +11,17 @@ maintenance if needed.
 
 #include "types.h"
 #include "board.h"
+#include "game_record.h"
+#include "mcts.h"
+
+
+/*
+Independent engine, with its own transpositions table, search state, komi and
+game. Different engines may search at the same time from different threads;
+each engine must only be used by one thread at a time. The opening book and
+other tables loaded from the data folder are shared.
+*/
+typedef struct __engine_ctx_ engine_ctx;
 
 
 /*
@@ -53,7 +64,7 @@ void set_use_of_opening_book(
 
 /*
 Evaluates the position given the time available to think, by using a number of
-strategies in succession.
+strategies in succession. The search may be extended up to max_stop_time.
 RETURNS true if a play or pass is suggested instead of resigning
 */
 bool evaluate_position_timed(
@@ -61,7 +72,8 @@ bool evaluate_position_timed(
     bool is_black,
     out_board * out_b,
     u64 stop_time,
-    u64 early_stop_time
+    u64 early_stop_time,
+    u64 max_stop_time
 );
 
 /*
@@ -76,14 +88,38 @@ bool evaluate_position_sims(
 );
 
 /*
-Evaluate the position for a short amount of time, ignoring the quality matrix
-produced.
+Evaluate the position until the interrupt flag is set by another thread,
+ignoring the quality matrix produced.
 */
 void evaluate_in_background(
     const board * b,
-    bool is_black
+    bool is_black,
+    const volatile bool * interrupt
+);
+
+/*
+Evaluate the position until the interrupt flag is set by another thread,
+reporting a snapshot of the best plays every interval milliseconds.
+*/
+void analyze_in_background(
+    const board * b,
+    bool is_black,
+    const volatile bool * interrupt,
+    u32 interval,
+    void (*report)(const analysis_snapshot *)
 );
 
+/*
+Interrupts the evaluation currently running, or the next one to be started,
+until clear_evaluation_interrupt is called. May be called from another thread.
+*/
+void interrupt_evaluation();
+
+/*
+Allows new evaluations to run after a call to interrupt_evaluation.
+*/
+void clear_evaluation_interrupt();
+
 /*
 Inform that we are currently between matches and proceed with the maintenance
 that is suitable at the moment.
@@ -106,4 +142,98 @@ doesn't.
 */
 void assert_data_folder_exists();
 
+/*
+Creates an independent engine with memory_mbs MiB for its transpositions table,
+searching with the number of threads given, or with 0 the number of threads
+OpenMP would use by default in the calling thread. Should not be called while
+other engines are searching.
+RETURNS the new engine
+*/
+engine_ctx * engine_create(
+    u64 memory_mbs,
+    u16 threads
+);
+
+/*
+Frees an engine that is not searching.
+*/
+void engine_destroy(
+    engine_ctx * ctx
+);
+
+/*
+Sets the komi used by the engine, multiplied by 2.
+*/
+void engine_set_komi(
+    engine_ctx * ctx,
+    d16 new_komi
+);
+
+/*
+Sets the game the engine searches from, which is copied. The search trees of
+positions no longer reachable are freed before the next search.
+*/
+void engine_set_position(
+    engine_ctx * ctx,
+    const game_record * gr
+);
+
+/*
+Sets the position the engine searches from without the game that led to it, so
+positional superko is only tested in the search itself.
+*/
+void engine_set_board(
+    engine_ctx * ctx,
+    const board * b,
+    bool is_black
+);
+
+/*
+Searches the current position of the engine for the player to play, for
+milliseconds of time.
+RETURNS true if a play or pass is suggested instead of resigning
+*/
+bool engine_search_timed(
+    engine_ctx * ctx,
+    u32 milliseconds,
+    out_board * out_b
+);
+
+/*
+Searches the current position of the engine for the player to play, for a
+number of simulations.
+RETURNS true if a play or pass is suggested instead of resigning
+*/
+bool engine_search_sims(
+    engine_ctx * ctx,
+    u32 simulations,
+    out_board * out_b
+);
+
+/*
+Selects the best legal play of an evaluation of the current position of the
+engine.
+RETURNS the play selected, or PASS
+*/
+move engine_best_play(
+    const engine_ctx * ctx,
+    const out_board * out_b
+);
+
+/*
+Interrupts the search of the engine currently running, or the next one to be
+started, until engine_clear_interrupt is called. May be called from another
+thread.
+*/
+void engine_interrupt(
+    engine_ctx * ctx
+);
+
+/*
+Allows new searches of the engine to run after a call to engine_interrupt.
+*/
+void engine_clear_interrupt(
+    engine_ctx * ctx
+);
+
 #endif
@@ -43,6 +43,50 @@ How overwhelming a pass quality must be to be played even if not the top ranked.
 
 #define MAX_UCT_DEPTH ((TOTAL_BOARD_SIZ * 2) / 3)
 
+/*
+Limits of the live analysis snapshots of the search: the number of root plays
+reported, most visited first, and the length of their principal variations.
+*/
+#define MCTS_ANALYSIS_MAX_PLAYS 16
+#define MCTS_ANALYSIS_MAX_PV 12
+
+typedef struct __analysis_play_ {
+    move m;
+    u32 visits; /* including the prior visits */
+    double winrate;
+    double rave_winrate;
+    u8 pv_len;
+    move pv[MCTS_ANALYSIS_MAX_PV];
+} analysis_play;
+
+typedef struct __analysis_snapshot_ {
+    u16 plays_count;
+    analysis_play plays[MCTS_ANALYSIS_MAX_PLAYS];
+} analysis_snapshot;
+
+/*
+Number of playouts performed from each leaf reached by the tree descent; their
+results are backed up together. Larger values amortize the cost of descending
+and locking the tree, which may pay off with many threads. Can be changed at
+runtime (playouts_per_leaf), up to UCT_MAX_PLAYOUTS_PER_LEAF.
+*/
+#define UCT_PLAYOUTS_PER_LEAF 1
+#define UCT_MAX_PLAYOUTS_PER_LEAF 64
+
+/*
+Number of threads dedicated to descending the tree in the pipelined search mode,
+where the leaves reached are queued to be played out by the remaining threads.
+Can be changed at runtime (pipeline_descenders); 0 disables the pipelined mode
+so that every thread descends, plays out and backs up in turn.
+*/
+#define UCT_PIPELINE_DESCENDERS 0
+
+/*
+State of the searches of one engine: interruption, statistics and pipeline
+queues. Threads use a default state unless another is selected.
+*/
+typedef struct __mcts_state_ mcts_state;
+
 
 
 
@@ -51,12 +95,36 @@ Initiate MCTS dependencies.
 */
 void mcts_init();
 
+/*
+Creates a new search state, for an engine independent from the default one.
+RETURNS the new state
+*/
+mcts_state * mcts_state_create();
+
+/*
+Frees a search state that is not in use by any thread.
+*/
+void mcts_state_destroy(
+    mcts_state * s
+);
+
+/*
+Selects the search state used by the calling thread, and by the threads of the
+searches it starts. NULL selects the default state.
+RETURNS the state previously selected, or NULL if it was the default one
+*/
+mcts_state * mcts_select_state(
+    mcts_state * s
+);
+
 /*
 Performs a MCTS in at least the available time.
 
-The search may end early if the estimated win rate is very one sided, in which
-case the play selected is a pass. The search is also interrupted if memory runs
-out.
+When to stop is decided by the time manager in use: the search may end early if
+the estimated win rate is very one sided, in which case the play selected is a
+pass, or if the best play can no longer change; it may also be extended up to
+max_stop_time if the best play is unstable. The search is also interrupted if
+memory runs out.
 RETURNS true if a play or pass is suggested instead of resigning
 */
 bool mcts_start_timed(
@@ -64,7 +132,8 @@ bool mcts_start_timed(
     const board * b,
     bool is_black,
     u64 stop_time,
-    u64 early_stop_time
+    u64 early_stop_time,
+    u64 max_stop_time
 );
 
 /*
@@ -80,6 +149,31 @@ bool mcts_start_sims(
     u32 simulations
 );
 
+/*
+Continue a previous MCTS until the interrupt flag is set, or memory runs out,
+reporting a snapshot of the root plays every interval milliseconds. The
+report function is called by one of the searching threads.
+*/
+void mcts_analyze(
+    const board * b,
+    bool is_black,
+    const volatile bool * interrupt,
+    u32 interval,
+    void (*report)(const analysis_snapshot *)
+);
+
+/*
+Interrupts the search currently running, or the next one to be started, until
+mcts_clear_interrupt is called. The search returns the best play found so far.
+May be called from another thread.
+*/
+void mcts_interrupt();
+
+/*
+Allows new searches to run after a call to mcts_interrupt.
+*/
+void mcts_clear_interrupt();
+
 /*
 Reset whether MCTS can run in the background after a previous attempt may have
 run out of memory.
@@ -87,11 +181,13 @@ run out of memory.
 void reset_mcts_can_resume();
 
 /*
-Continue a previous MCTS.
+Continue a previous MCTS until the interrupt flag is set, or memory runs out.
+The flag is tested before every simulation, and may be set by another thread.
 */
 void mcts_resume(
     const board * b,
-    bool is_black
+    bool is_black,
+    const volatile bool * interrupt
 );
 
 /*
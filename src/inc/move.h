@@ -31,6 +31,43 @@ typedef struct __move_seq_ {
     move coord[TOTAL_BOARD_SIZ];
 } move_seq;
 
+/*
+Fixed capacity move sequences, for the board geometry tables. They are used for
+neighbor lookups in the hottest loops, and are therefore kept compact.
+*/
+#define NEI_SIDE_MAX 4
+#define NEI_DIAG_MAX 4
+#define NEI_3X3_MAX 8
+#define NEI_DST_2_MAX 12
+#define NEI_DST_3_MAX 24
+#define NEI_DST_4_MAX 40
+
+/* side or diagonal neighbors, NEI_SIDE_MAX and NEI_DIAG_MAX are the same */
+typedef struct __nei_seq4_ {
+    u8 count;
+    move coord[NEI_SIDE_MAX];
+} nei_seq4;
+
+typedef struct __nei_seq8_ {
+    u8 count;
+    move coord[NEI_3X3_MAX];
+} nei_seq8;
+
+typedef struct __nei_seq12_ {
+    u8 count;
+    move coord[NEI_DST_2_MAX];
+} nei_seq12;
+
+typedef struct __nei_seq24_ {
+    u8 count;
+    move coord[NEI_DST_3_MAX];
+} nei_seq24;
+
+typedef struct __nei_seq40_ {
+    u8 count;
+    move coord[NEI_DST_4_MAX];
+} nei_seq40;
+
 /*
 Special move values
 NONE is used when there is no information, like at the first turn of a match.
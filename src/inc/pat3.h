@@ -5,12 +5,13 @@ of GNU Go, MoGo and others over the years.
 The life of these patterns is as follow:
  * On startup a pat3 file is loaded with a number of 3x3 patterns suggesting
  play at the center intersection. The pattern is flipped and rotated and stored
- in a hash table for both players (with the color inverted for white). They are
- stored in their 16-bit value form.
+ in a compact table from the perspective of the black player. They are stored
+ in their 16-bit value form.
 
  * In MCTS each candidate position can be transposed to a 3x3 array, which fixed
  out of bounds codification, fliped and rotated (but the color remains the same)
- and searched for in the appropriate hash table.
+ and searched for in the table; for white the colors of the 16-bit value are
+ swapped first.
 */
 
 #ifndef MATILDA_PAT3_H
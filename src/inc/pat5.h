@@ -0,0 +1,70 @@
+/*
+Functions that support the use of large patterns, covering the 5x5 diamond
+neighborhood (manhattan distance 2 or less) of a play.
+
+The life of these patterns is as follow:
+ * On startup the .pat5 files are loaded, with a number of patterns suggesting
+ play at the center intersection. The pattern is flipped and rotated, and its
+ 64-bit Zobrist hash stored in a compact dictionary for both players (with the
+ color inverted for white).
+
+ * The hashes of the neighborhood of every intersection are maintained
+ incrementally by the cfg_board structure, so looking up a candidate play costs
+ a single hash table probe.
+*/
+
+#ifndef MATILDA_PAT5_H
+#define MATILDA_PAT5_H
+
+#include "config.h"
+
+#include "board.h"
+#include "types.h"
+
+/*
+Maximum number of rotated and flipped patterns in the dictionary.
+*/
+#define PAT5_MAX_PATTERNS (1 << 16)
+
+
+/*
+Lookup of pattern weight for the specified player.
+RETURNS pattern weight or 0 if not found
+*/
+u16 pat5_find(
+    u64 hash,
+    bool is_black
+);
+
+/*
+Calculates the 5x5 diamond hash of the neighborhood of an intersection from
+scratch, with board safety. For testing the incremental hashes.
+RETURNS 64-bit hash of the neighborhood
+*/
+u64 pat5_hash_slow(
+    const u8 p[static TOTAL_BOARD_SIZ],
+    move m
+);
+
+/*
+RETURNS the number of patterns in the dictionary, counting each rotation, flip
+and color
+*/
+u32 pat5_dictionary_size();
+
+/*
+Reads patterns in the .pat5 format into the dictionary, expanding them. The text
+is modified.
+RETURNS the number of patterns read
+*/
+u32 pat5_read_patterns(
+    char * text
+);
+
+/*
+Reads the .pat5 patterns files and expands all patterns into all possible and
+patternable configurations.
+*/
+void pat5_init();
+
+#endif
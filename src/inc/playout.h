@@ -1,16 +1,19 @@
 /*
-Heavy playout implementation with probability distribution selection and the use
-of a play status cache.
+Playout implementation with selectable move policies and the use of a play
+status cache.
 
-The move selection policy uses the following restrictions:
+The light policy plays uniformly at random, only avoiding filling its own eyes.
+
+The heavy policies select plays with a probability distribution. They use the
+following restrictions:
     1. No illegal plays
     2. No playing in own proper eyes
     3. No plays ending in self-atari except if forming a single stone group
     (throw-in)
 And chooses a play based on (by order of importance):
-    1. Nakade
-    2. Capture
-    3. Avoid capture
+    1. Avoid capture
+    2. Nakade (heavy_nakade policy only)
+    3. Capture
     4. Handcrafted 3x3 patterns
     5. Random play
 */
@@ -28,6 +31,20 @@ And chooses a play based on (by order of importance):
 
 #define MERCY_THRESHOLD (TOTAL_BOARD_SIZ / 5)
 
+/*
+Playouts test if the result is already decided by the settled area, when there
+are less than SETTLED_CHECK_EMPTY empty intersections, every
+SETTLED_CHECK_INTERVAL plays.
+*/
+#define SETTLED_CHECK_EMPTY (TOTAL_BOARD_SIZ / 6)
+#define SETTLED_CHECK_INTERVAL 4
+
+/*
+Playout policy used by default: 0 for light, 1 for heavy, 2 for heavy with
+nakade. Can be changed at runtime.
+*/
+#define DEFAULT_PLAYOUT_POLICY 1
+
 
 /*
 Probability of skipping a check in parts of 128 (instead of 100 for performance
@@ -63,13 +80,26 @@ Cache state bits (must fit in 1 byte)
 
 
 /*
-Make a heavy playout and returns whether black wins.
-Does not play in own proper eyes or self-ataris except for possible throw-ins.
-Avoids too many ko battles. Also uses mercy threshold.
+Selects the playout policy by name: light, heavy or heavy_nakade.
+RETURNS false if the name is not recognized
+*/
+bool playout_set_policy(
+    const char * name
+);
+
+/*
+RETURNS the name of the playout policy in use
+*/
+const char * playout_policy_name();
+
+/*
+Make a playout with the selected policy and returns whether black wins.
+Does not play in own proper eyes. Avoids too many ko battles. Also uses mercy
+threshold, and stops as soon as the winner is decided by the settled area.
 Also updates AMAF transitions information.
 RETURNS the final score
 */
-d16 playout_heavy_amaf(
+d16 playout_amaf(
     cfg_board * cb,
     bool is_black,
     u8 traversed[static TOTAL_BOARD_SIZ]
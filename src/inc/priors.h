@@ -37,6 +37,7 @@ Tuned with CLOP in 9x9 with 10k playouts/turn in self-play for 34k games.
 #define PRIOR_ATTACK     28
 #define PRIOR_DEFEND     19
 #define PRIOR_PAT3       23 /* 3x3 patterns centered on play */
+#define PRIOR_PAT5       23 /* 5x5 diamond patterns; not tuned */
 #define PRIOR_NEAR_LAST  11 /* bonuses for distance to another stone */
 #define PRIOR_LINE2      45 /* if empty in a certain distance around it */
 #define PRIOR_LINE3      29
@@ -46,9 +47,16 @@ Tuned with CLOP in 9x9 with 10k playouts/turn in self-play for 34k games.
 #define PRIOR_PASS      130
 #define PRIOR_STARTING   76 /* starting point like around the hoshi */
 
+/*
+Number of visits to an expanded state before the expensive tactical priors
+(attack, defense and self-atari) are added to it. Set to 0 to add them on
+expansion.
+*/
+#define PRIOR_DEFERRED_VISITS 8
+
 /*
 Initializes a game state structure with prior values and AMAF/LGRF/Criticality
-information.
+information. The tactical priors are deferred to init_deferred_priors.
 */
 void init_new_state(
     tt_stats * stats,
@@ -56,8 +64,22 @@ void init_new_state(
     bool is_black
 );
 
+/*
+Adds the tactical priors to a game state structure already initialized by
+init_new_state, keeping the statistics gathered meanwhile.
+*/
+void init_deferred_priors(
+    tt_stats * stats,
+    cfg_board * cb,
+    bool is_black
+);
+
 #if PRIOR_EVEN == 0
 #error Error: MCTS prior weights: even heuristic weight cannot be zero.
 #endif
 
+#if PRIOR_DEFERRED_VISITS > 127
+#error Error: MCTS prior weights: deferred priors visits must fit in 7 bits.
+#endif
+
 #endif
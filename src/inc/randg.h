@@ -1,6 +1,11 @@
 /*
 Non-cryptographic random number generation functions
 
+The generator is xoshiro256** with an independent 256-bit state per OpenMP
+thread. Besides the classic single value functions there is a bulk version,
+to be used in hot loops like MCTS playouts, and a generator of random bit masks
+used to precompute yes/no decisions with a fixed probability.
+
 Reminder: maximums are exclusive for integer functions and inclusive (and very
 unlikely) for floating point functions.
 */
@@ -25,7 +30,31 @@ Initiate the seeds for the different thread RNG.
 void rand_init();
 
 /*
-Fast and well distributed 16-bit RNG based on the glibc mixed LCG.
+Fast 64-bit RNG with all bits of good quality.
+RETURNS pseudo random 64-bit number
+*/
+u64 rand_u64();
+
+/*
+Fills a buffer with pseudo random 64-bit numbers. Cheaper than calling rand_u64
+repeatedly since the thread state is only looked up once.
+*/
+void rand_fill(
+    u64 * buf,
+    u32 count
+);
+
+/*
+Generates a mask of 64 independent random bits, each set with probability
+prob/128. Uses seven pseudo random words.
+RETURNS random bit mask
+*/
+u64 rand_mask128(
+    u16 prob /* 0 to 128 */
+);
+
+/*
+Fast and well distributed 16-bit RNG.
 RETURNS pseudo random 16-bit number
 */
 u16 rand_u16(
@@ -33,7 +62,7 @@ u16 rand_u16(
 );
 
 /*
-Slow alternative for 32-bit. Avoid using.
+Fast and well distributed 32-bit RNG.
 RETURNS pseudo random 32-bit number
 */
 u32 rand_u32(
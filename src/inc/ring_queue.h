@@ -0,0 +1,66 @@
+/*
+Implementation of a bounded lock-free queue of 32-bit values, safe for multiple
+producers and multiple consumers (D. Vyukov's array based design).
+*/
+
+#ifndef MATILDA_RING_QUEUE_H
+#define MATILDA_RING_QUEUE_H
+
+#include "config.h"
+
+#include "types.h"
+
+typedef struct __ring_queue_ {
+    u32 mask;
+    u64 * sequence;
+    u32 * values;
+    u64 head __attribute__((aligned(64)));
+    u64 tail __attribute__((aligned(64)));
+} ring_queue;
+
+
+
+/*
+Creates a queue able to hold at least capacity values. The capacity is rounded
+up to a power of two.
+RETURNS queue instance
+*/
+ring_queue * ring_queue_create(
+    u32 capacity
+);
+
+/*
+Frees the memory used by the queue. The queue must not be in use.
+*/
+void ring_queue_destroy(
+    ring_queue * q
+);
+
+/*
+Inserts a value at the end of the queue.
+RETURNS false if the queue is full
+*/
+bool ring_queue_push(
+    ring_queue * q,
+    u32 value
+);
+
+/*
+Removes the value at the front of the queue.
+RETURNS false if the queue is empty
+*/
+bool ring_queue_pop(
+    ring_queue * q,
+    u32 * value
+);
+
+/*
+Number of values in the queue. Only approximate if the queue is being modified
+concurrently.
+RETURNS number of values in the queue
+*/
+u32 ring_queue_size(
+    const ring_queue * q
+);
+
+#endif
@@ -75,4 +75,14 @@ bool import_game_from_sgf2(
     u32 buf_siz
 );
 
+/*
+Import a game record from SGF text, in a null terminated buffer that is modified
+in the process. The komi, if present, is set as the current komi.
+RETURNS true if the game has been found and read correctly
+*/
+bool import_game_from_sgf_text(
+    game_record * gr,
+    char * buf
+);
+
 #endif
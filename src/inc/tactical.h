@@ -17,7 +17,40 @@ purpose of eye counting.
 #include "move.h"
 #include "types.h"
 
+/*
+Nakade lookup table flags. nakade_shape stores the size estimate in the low
+bits, the kind of shape and the color of the surrounding stones; the
+black/white_nakade_side tables classify the empty intersections next to the
+vital point.
+*/
+#define NAKADE_SIZE_MASK 0x1f
+#define NAKADE_BULKY 0x20
+#define NAKADE_BLACK 0x40
+#define NAKADE_WHITE 0x80
+
+#define NAKADE_SIDE_EDGE 1
+#define NAKADE_SIDE_CORNER 2
+
+
+
+/*
+Initiate the tactical reading cache. Until it is called the tactical functions
+work without it.
+*/
+void tactical_cache_init();
 
+/*
+Reads the tactical reading cache counters of the calling thread.
+*/
+void tactical_cache_stats(
+    u64 * hits,
+    u64 * misses
+);
+
+/*
+Resets the tactical reading cache counters of the calling thread.
+*/
+void tactical_cache_reset_stats();
 
 /*
 An eye is a point that may eventually become untakeable (without playing
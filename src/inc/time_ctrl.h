@@ -23,6 +23,13 @@ is the objective.
 
 #define EXPECTED_GAME_LENGTH ((TOTAL_BOARD_SIZ * 2) / 3)
 
+/*
+Limits to the time a search may be extended to: a multiple of the time
+calculated for the play, and a fraction of the main time remaining.
+*/
+#define TIME_MAX_EXTENSION 2.0
+#define TIME_MAX_MAIN_FRACTION 4.0
+
 
 typedef struct __time_system_ {
     bool can_timeout;
@@ -39,11 +46,40 @@ typedef struct __time_system_ {
     u32 byo_yomi_periods_remaining;
 } time_system;
 
+/*
+The effective latency -- the time the server charges for a play over the time
+measured locally -- is estimated from the time_left reports of the server. The
+first samples are averaged; afterwards a moving average with this weight is
+used, so the estimate follows changes in lag. Samples are clamped to +/-
+LATENCY_MAX_SAMPLE milliseconds.
+*/
+#define LATENCY_SMOOTHING 0.25
+#define LATENCY_MAX_SAMPLE 5000
+
+/*
+Running estimate of the effective latency of a connection, in milliseconds.
+*/
+typedef struct __latency_estimator_ {
+    double estimate;
+    u32 samples;
+} latency_estimator;
+
+/*
+Clock reports from the server of one player, in milliseconds.
+*/
+typedef struct __latency_probe_ {
+    bool synced; /* clock reported since the last play answered */
+    bool measuring; /* play answered after a report, awaiting the next */
+    u32 time_remaining;
+    u32 stones_remaining;
+    u32 think_time;
+} latency_probe;
+
 
 
 /*
 Calculate the time available based on a Canadian byo-yomi time system. Also
-compensates for network latency.
+compensates for the network latency estimated.
 RETURNS time available in milliseconds
 */
 u32 calc_time_to_play(
@@ -51,6 +87,75 @@ u32 calc_time_to_play(
     u16 turns_played
 );
 
+/*
+Calculate the maximum time that may be used for a play, if the search is
+extended beyond the time given by calc_time_to_play. It is limited to a
+fraction of the main time remaining, or otherwise to the byo-yomi time per
+stone. Also compensates for network latency.
+RETURNS maximum time available in milliseconds
+*/
+u32 calc_max_time_to_play(
+    time_system * ts,
+    u16 turns_played
+);
+
+/*
+RETURNS the current estimate of the effective latency in milliseconds
+*/
+u32 latency_compensation();
+
+/*
+RETURNS the number of plays the latency estimate is based on
+*/
+u32 latency_sample_count();
+
+/*
+Reset the latency estimate to the constant LATENCY_COMPENSATION.
+*/
+void reset_latency_estimate();
+
+/*
+Copies the latency estimate in use, for example to keep one per connection.
+*/
+void get_latency_estimator(
+    latency_estimator * dst
+);
+
+/*
+Replaces the latency estimate in use.
+*/
+void set_latency_estimator(
+    const latency_estimator * src
+);
+
+/*
+Forget the clock reports of a player, for example when the time system changes.
+*/
+void latency_probe_reset(
+    latency_probe * lp
+);
+
+/*
+Mark that a play was answered after thinking for think_time milliseconds, as
+measured locally since the command was started. It is measured only if the
+clock of the player was reported before the play.
+*/
+void latency_play_answered(
+    latency_probe * lp,
+    u32 think_time
+);
+
+/*
+Update the clock of a player with a time_left report from the server. If a play
+was answered since the previous report, the time the server charged for it over
+the think time measured locally is folded into the latency estimate.
+*/
+void latency_clock_reported(
+    latency_probe * lp,
+    u32 time_remaining,
+    u32 stones_remaining
+);
+
 /*
 Set the complete Canadian byo-yomi time system.
 */
@@ -0,0 +1,112 @@
+/*
+Search time managers, that decide during a timed MCTS when to stop it: before
+the time planned for the play if the result can no longer change, or after it
+if the search is still unstable.
+
+Managers available, selectable at runtime:
+ * fixed - stops at the time planned, or after the early stop time if the win
+ rate is overwhelming.
+ * stable - like fixed, but also stops as soon as the most visited play cannot
+ be overtaken in visits in the time remaining, and extends the search while the
+ best play has changed recently, up to the maximum time given.
+*/
+
+#ifndef MATILDA_TIME_MANAGER_H
+#define MATILDA_TIME_MANAGER_H
+
+#include "config.h"
+
+#include "move.h"
+#include "transpositions.h"
+#include "types.h"
+
+/*
+Time manager used by default: 0 for fixed, 1 for stable. Can be changed at
+runtime.
+*/
+#define DEFAULT_TIME_MANAGER 1
+
+/*
+Minimum interval, in milliseconds, between inspections of the root state.
+*/
+#define TM_CHECK_INTERVAL 10
+
+/*
+Fraction of the time planned that must have elapsed before the visits rate is
+trusted to stop the search early.
+*/
+#define TM_MIN_ELAPSED_FRACTION 0.2
+
+/*
+The search is extended if the best play changed in the last fraction of the time
+planned, by another fraction of the time planned each time.
+*/
+#define TM_UNSTABLE_FRACTION 0.25
+#define TM_EXTENSION_FRACTION 0.5
+
+/*
+State of the time management of a single search.
+*/
+typedef struct __search_time_ {
+    u64 start_time;
+    u64 early_stop_time;
+    u64 planned_stop_time;
+    u64 max_stop_time;
+    u64 stop_time; /* current deadline, possibly extended */
+    u64 next_check;
+    u64 best_changed_time;
+    move best;
+    u16 extensions;
+    const char * reason; /* why the search was stopped */
+} search_time;
+
+
+/*
+Selects the time manager by name: fixed or stable.
+RETURNS false if the name is not recognized
+*/
+bool time_manager_set(
+    const char * name
+);
+
+/*
+RETURNS the name of the time manager in use
+*/
+const char * time_manager_name();
+
+/*
+Initializes the time management of a new search.
+*/
+void time_manager_start(
+    search_time * st,
+    u64 start_time,
+    u64 stop_time,
+    u64 early_stop_time,
+    u64 max_stop_time
+);
+
+/*
+Tests whether the search should stop. Should only be called by one thread. The
+root state lock is taken for a short time, at most every TM_CHECK_INTERVAL
+milliseconds.
+RETURNS true if the search should stop
+*/
+bool time_manager_should_stop(
+    search_time * st,
+    tt_stats * root,
+    u64 curr_time,
+    u32 wins,
+    u32 losses,
+    u32 simulations
+);
+
+/*
+Logs the time saved or reinvested by the time manager in the search, compared
+with the time planned.
+*/
+void time_manager_log(
+    const search_time * st,
+    u64 end_time
+);
+
+#endif
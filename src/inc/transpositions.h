@@ -51,19 +51,57 @@ typedef struct __tt_stats_ {
     u8 p[TOTAL_BOARD_SIZ];
     move last_eaten_passed; // position of last single stone eaten or NONE/PASS
     u8 maintenance_mark;
+    u8 owner; // session the state belongs to, see tt_set_owner
     d8 expansion_delay;
+    d8 deferred_priors; // visits left before the tactical priors, or -1
     move plays_count;
     tt_play plays[MAX_PLAYS_COUNT];
     omp_lock_t lock;
     struct __tt_stats_ * next;
 } tt_stats;
 
+/*
+A transpositions table. Besides the table initialized by tt_init, separate
+tables can be created for independent searches in the same process.
+*/
+typedef struct __tt_table_ tt_table;
+
 
 /*
 Initialize the transpositions table structures.
 */
 void tt_init();
 
+/*
+Creates a separate transpositions table, with mbs MiB of memory.
+RETURNS the new table
+*/
+tt_table * tt_create(
+    u64 mbs
+);
+
+/*
+Frees a table created with tt_create, and all its states. The table must not be
+selected by any thread.
+*/
+void tt_destroy(
+    tt_table * t
+);
+
+/*
+Selects the table used by the calling thread, or with NULL the table initialized
+by tt_init. Threads that take part in a search must select the same table.
+*/
+void tt_select(
+    tt_table * t
+);
+
+/*
+RETURNS the table selected by the calling thread, or NULL for the table
+initialized by tt_init
+*/
+tt_table * tt_selected();
+
 /*
 Looks up a previously stored state, or generates a new one. No assumptions are
 made about whether the board state is in reduced form already. Never fails. If
@@ -100,10 +138,35 @@ u32 tt_clean_unreachable(
 );
 
 /*
-Frees all game states and resets counters.
+Frees all game states of the current owner and resets counters.
 */
 u32 tt_clean_all();
 
+/*
+Selects the owner of the states looked up, created and freed from now on. States
+of other owners are never found nor freed, so several games can share the table
+without mixing their statistics. The owner 0 is used by default. Not
+thread-safe; should only be changed between searches.
+*/
+void tt_set_owner(
+    u8 new_owner
+);
+
+/*
+Limits the number of states an owner may have in use, beyond which the search
+stops expanding new states like when the table is full. By default every owner
+may use the whole table.
+*/
+void tt_set_quota(
+    u8 quota_owner,
+    u32 max_states
+);
+
+/*
+RETURNS the maximum number of states that fit in the table
+*/
+u32 tt_max_states();
+
 /*
 Mostly for debugging -- log the current memory status of the transpositions
 table to stderr and log file.
@@ -1,6 +1,6 @@
 /*
 For creating and updating Zobrist hashes on board states, both for full board
-hashes and position invariant 3x3 hashes.
+hashes and position invariant 3x3 and 5x5 diamond hashes.
 */
 
 #ifndef MATILDA_ZOBRIST_H
@@ -35,4 +35,17 @@ void zobrist_update_hash(
     u8 change
 );
 
+/*
+Generate the Zobrist hash of the stones inside a rectangular region of the
+board, delimited by the inclusive coordinates (x0,y0) and (x1,y1).
+RETURNS Zobrist hash of the region
+*/
+u64 zobrist_region_hash(
+    const u8 p[static TOTAL_BOARD_SIZ],
+    u8 x0,
+    u8 y0,
+    u8 x1,
+    u8 y1
+);
+
 #endif
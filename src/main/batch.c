@@ -0,0 +1,338 @@
+/*
+Matilda application in batch mode, for the offline evaluation of many positions
+
+Positions are read from the standard input, one per line, in one of the
+formats:
+    an SGF game record, in a single line starting with ( - the position after
+    its last play is evaluated, for the player to play next, with its komi;
+    the path of an SGF file, in the same way;
+    board <b or w> <hex> - the stones of the board packed with pack_matrix, as
+    2 * PACKED_BOARD_SIZ hexadecimal digits, and the player to play.
+Empty lines and lines starting with # are ignored.
+
+Independent positions are evaluated at the same time, each by an engine with
+one thread, with as many engines as threads in use. For each position a line
+is written to the standard output, in the order the evaluations finish:
+    <line number> <b or w> <play, pass or resign> <value>
+or, if the line could not be read:
+    <line number> error <reason>
+The value is the estimated win rate of the play for the player to play. The
+opening books are not used, since they do not estimate values.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "alloc.h"
+#include "board.h"
+#include "cfg_board.h"
+#include "engine.h"
+#include "flog.h"
+#include "game_record.h"
+#include "move.h"
+#include "sgf.h"
+#include "stringm.h"
+#include "timem.h"
+#include "types.h"
+
+#define BATCH_MAX_LINE_SIZ (64 * 1024)
+
+/* from constants */
+extern __thread d16 komi;
+extern u64 max_size_in_mbs;
+
+static pthread_mutex_t input_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static u32 lines_read = 0;
+static u32 positions_evaluated = 0;
+
+static u32 batch_playouts;
+static u32 batch_milliseconds;
+
+
+/*
+Reads the next line of the input, removing the line break. The rest of a line
+longer than the buffer is discarded, and the line is flagged as too long.
+RETURNS false if the input has ended
+*/
+static bool read_line(
+    char * buf,
+    u32 * line_nr,
+    bool * too_long
+) {
+    *too_long = false;
+
+    pthread_mutex_lock(&input_lock);
+    bool ret = fgets(buf, BATCH_MAX_LINE_SIZ, stdin) != NULL;
+    *line_nr = ++lines_read;
+
+    if (ret && strchr(buf, '\n') == NULL) {
+        int c = getc(stdin);
+        if (c != EOF && c != '\n') {
+            *too_long = true;
+
+            while (c != EOF && c != '\n') {
+                c = getc(stdin);
+            }
+        }
+    }
+    pthread_mutex_unlock(&input_lock);
+
+    if (ret) {
+        buf[strcspn(buf, "\r\n")] = 0;
+    }
+
+    return ret;
+}
+
+static void output_line(
+    const char * s
+) {
+    pthread_mutex_lock(&output_lock);
+    fprintf(stdout, "%s\n", s);
+    fflush(stdout);
+    pthread_mutex_unlock(&output_lock);
+}
+
+static u8 hex_value(
+    char c
+) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return 16;
+}
+
+/*
+Reads a position in the compact format: board <b or w> <hex>.
+RETURNS NULL on success, or the reason of the failure
+*/
+static const char * read_packed_board(
+    board * b,
+    bool * is_black,
+    char * line
+) {
+    char * save_ptr;
+    strtok_r(line, " \t", &save_ptr);
+    char * color = strtok_r(NULL, " \t", &save_ptr);
+    char * hex = strtok_r(NULL, " \t", &save_ptr);
+
+    if (color == NULL || hex == NULL || !parse_color(is_black, color)) {
+        return "expected board <b or w> <hex>";
+    }
+
+    if (strlen(hex) != 2 * PACKED_BOARD_SIZ) {
+        return "wrong board size";
+    }
+
+    u8 packed[PACKED_BOARD_SIZ];
+    for (u16 i = 0; i < PACKED_BOARD_SIZ; ++i) {
+        u8 hi = hex_value(hex[2 * i]);
+        u8 lo = hex_value(hex[2 * i + 1]);
+
+        if (hi > 15 || lo > 15) {
+            return "illegal hexadecimal digit";
+        }
+
+        packed[i] = (hi << 4) | lo;
+    }
+
+    clear_board(b);
+    unpack_matrix(b->p, packed);
+
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        if (b->p[m] != EMPTY && b->p[m] != BLACK_STONE && b->p[m] != WHITE_STONE) {
+            return "illegal stone value";
+        }
+    }
+
+    /* groups without liberties would have been captured */
+    cfg_board cb;
+    cfg_from_board(&cb, b);
+    bool captured = false;
+    for (u8 i = 0; i < cb.unique_groups_count; ++i) {
+        if (cb.g[cb.unique_groups[i]]->liberties == 0) {
+            captured = true;
+        }
+    }
+    cfg_board_free(&cb);
+
+    return captured ? "group without liberties" : NULL;
+}
+
+/*
+Sets the position of a line of the input in the engine.
+RETURNS NULL on success, or the reason of the failure
+*/
+static const char * read_position(
+    engine_ctx * ctx,
+    game_record * gr,
+    bool * is_black,
+    char * line
+) {
+    if (strncmp(line, "board", 5) == 0 && (line[5] == ' ' || line[5] == '\t')) {
+        board b;
+        const char * err = read_packed_board(&b, is_black, line);
+        if (err != NULL) {
+            return err;
+        }
+
+        engine_set_komi(ctx, DEFAULT_KOMI);
+        engine_set_board(ctx, &b, *is_black);
+        return NULL;
+    }
+
+    komi = DEFAULT_KOMI;
+
+    if (line[0] == '(') {
+        if (!import_game_from_sgf_text(gr, line)) {
+            return "SGF format error";
+        }
+    } else {
+        char * buf = malloc(MAX_FILE_SIZ);
+        if (buf == NULL) {
+            flog_crit("btch", "system out of memory");
+        }
+
+        bool imported = import_game_from_sgf2(gr, line, buf, MAX_FILE_SIZ);
+        free(buf);
+
+        if (!imported) {
+            return "could not read SGF file";
+        }
+    }
+
+    *is_black = current_player_color(gr);
+    engine_set_komi(ctx, komi);
+    engine_set_position(ctx, gr);
+    return NULL;
+}
+
+static void * batch_worker(
+    void * arg
+) {
+    engine_ctx * ctx = (engine_ctx *)arg;
+    char * line = malloc(BATCH_MAX_LINE_SIZ);
+    game_record * gr = malloc(sizeof(game_record));
+    if (line == NULL || gr == NULL) {
+        flog_crit("btch", "system out of memory");
+    }
+
+    char * s = alloc();
+    char * mstr = alloc();
+    u32 line_nr;
+
+    bool too_long;
+
+    while (read_line(line, &line_nr, &too_long)) {
+        if (too_long) {
+            snprintf(s, MAX_PAGE_SIZ, "%u error line too long", line_nr);
+            output_line(s);
+            continue;
+        }
+
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+
+        bool is_black;
+        const char * err = read_position(ctx, gr, &is_black, line);
+        if (err != NULL) {
+            snprintf(s, MAX_PAGE_SIZ, "%u error %s", line_nr, err);
+            output_line(s);
+            continue;
+        }
+
+        out_board out_b;
+        bool has_play;
+        if (batch_milliseconds > 0) {
+            has_play = engine_search_timed(ctx, batch_milliseconds, &out_b);
+        } else {
+            has_play = engine_search_sims(ctx, batch_playouts, &out_b);
+        }
+
+        move m = engine_best_play(ctx, &out_b);
+        double value = is_board_move(m) ? out_b.value[m] : out_b.pass;
+
+        if (!has_play) {
+            snprintf(mstr, MAX_PAGE_SIZ, "resign");
+        } else if (m == PASS) {
+            snprintf(mstr, MAX_PAGE_SIZ, "pass");
+        } else {
+            coord_to_alpha_num(mstr, m);
+        }
+
+        snprintf(s, MAX_PAGE_SIZ, "%u %c %s %.3f", line_nr, is_black ? 'b' : 'w',
+            mstr, value);
+        output_line(s);
+        __atomic_add_fetch(&positions_evaluated, 1, __ATOMIC_RELAXED);
+    }
+
+    release(mstr);
+    release(s);
+    free(gr);
+    free(line);
+    return NULL;
+}
+
+/*
+Evaluates the positions of the standard input, each with the number of playouts
+or, if not zero, milliseconds given, until the input ends.
+*/
+void main_batch(
+    u32 playouts,
+    u32 milliseconds
+) {
+    batch_playouts = playouts;
+    batch_milliseconds = milliseconds;
+    set_use_of_opening_book(false);
+
+    u16 workers = MIN(omp_get_max_threads(), MAXIMUM_NUM_THREADS);
+    u64 memory = MAX(max_size_in_mbs / workers, 2);
+
+    engine_ctx * engines[MAXIMUM_NUM_THREADS];
+    pthread_t threads[MAXIMUM_NUM_THREADS];
+
+    for (u16 i = 0; i < workers; ++i) {
+        engines[i] = engine_create(memory, 1);
+    }
+
+    char * s = alloc();
+    snprintf(s, MAX_PAGE_SIZ, "batch mode with %u engines of %" PRIu64
+        " MiB\n", workers, memory);
+    flog_info("btch", s);
+
+    u64 start_time = current_time_in_millis();
+
+    for (u16 i = 0; i < workers; ++i) {
+        if (pthread_create(&threads[i], NULL, batch_worker, engines[i]) != 0) {
+            flog_crit("btch", "failed to create batch thread");
+        }
+    }
+
+    for (u16 i = 0; i < workers; ++i) {
+        pthread_join(threads[i], NULL);
+        engine_destroy(engines[i]);
+    }
+
+    u64 elapsed = MAX(current_time_in_millis() - start_time, 1);
+    snprintf(s, MAX_PAGE_SIZ, "batch evaluated %u positions in %" PRIu64
+        " ms (%.1f positions/s)\n", positions_evaluated, elapsed,
+        positions_evaluated / (elapsed / 1000.0));
+    flog_info("btch", s);
+    release(s);
+}
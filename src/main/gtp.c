@@ -25,7 +25,11 @@ GTP_README.
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
-#include <sys/select.h> /* fd_set in macOS */
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "alloc.h"
 #include "board.h"
@@ -48,7 +52,7 @@ GTP_README.
 #include "version.h"
 
 
-extern d16 komi;
+extern __thread d16 komi;
 
 const char * supported_commands[] = {
     "boardsize",
@@ -72,7 +76,9 @@ const char * supported_commands[] = {
     "komi",
     "list_commands",
     "loadsgf",
+    "lz-analyze",
     "mtld-game_info",
+    "mtld-interrupt",
     "mtld-last_evaluation",
     "mtld-time_left",
     "name",
@@ -100,6 +106,7 @@ extern time_system current_clock_black;
 extern time_system current_clock_white;
 extern u32 limit_by_playouts;
 extern char * sentinel_file;
+extern bool tt_requires_maintenance;
 
 static bool out_on_time_warning = false;
 
@@ -110,10 +117,136 @@ only used for naming the players in SGF records.
 static bool has_genmoved_as_black = false;
 static bool has_genmoved_as_white = false;
 
+/*
+Time the command being executed was started, in both the standard input and the
+server modes. Any time waiting in the queue is charged by the opponent clock,
+and so is measured as part of the latency.
+*/
 static u64 request_received_mark;
 
+/*
+Number of server sessions waiting for a play to be generated, the one being
+served included. They are answered in turn, so each gets only its share of the
+planned time; otherwise the clocks of the commands served last would keep
+running while they wait for the others.
+*/
+static u16 genmoves_pending = 1;
+
+/*
+Standard input is read and parsed by a separate thread. Commands that don't
+change the game state are answered by it immediately, even during a search; the
+others are queued and executed in order by the main thread. The clock reports
+are only answered immediately when no other command is queued or running, so
+they are never applied out of order. While lz-analyze is streaming its response
+every command is queued, ending the analysis. The pending flag is also used to
+interrupt the pondering search and the analysis.
+*/
+#define GTP_QUEUE_SIZ 64
+
+
+static const char * immediate_commands[] = {
+    "cputime",
+    "echo",
+    "echo_err",
+    "gomill-cpu_time",
+    "help",
+    "known_command",
+    "list_commands",
+    "mtld-interrupt",
+    "name",
+    "protocol_version",
+    "version",
+    NULL
+};
+
+static const char * clock_commands[] = {
+    "mtld-time_left",
+    "time_left",
+    NULL
+};
+
+static const char * genmove_commands[] = {
+    "genmove",
+    "kgs-genmove_cleanup",
+    "reg_genmove",
+    NULL
+};
+
+static pthread_t input_thread;
+static pthread_mutex_t input_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t input_cond = PTHREAD_COND_INITIALIZER;
+static char * input_queue[GTP_QUEUE_SIZ];
+static u16 input_queue_start = 0;
+static u16 input_queue_count = 0;
+static bool input_closed = false;
+static bool command_running = false;
+static volatile bool input_pending = false;
+
+/*
+Responses may be written by both threads; the clocks may be updated by the
+input thread while a play is being generated.
+*/
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+Held by the input thread while answering a command immediately, and by the
+analysis while opening and closing its response.
+*/
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool command_streaming = false;
+
+/*
+Clock reports of each player, used to estimate the network latency.
+*/
+static latency_probe latency_black;
+static latency_probe latency_white;
+
 static out_board last_out_board;
 
+static FILE * analysis_fp;
+
+/*
+In server mode several GTP sessions, each over its own TCP connection, share the
+process: the static tables, the thread pool and the transpositions table. A
+thread per connection reads its commands; a single thread executes them, taking
+the sessions with commands pending in turn. The game state of the session is
+swapped into the global variables while its command is executed, and each
+session owns its states in the transpositions table, up to an equal share of it.
+*/
+typedef struct __gtp_session_ {
+    u8 id; /* also the owner of its transpositions table states */
+    int fd;
+    FILE * fp;
+    pthread_t reader;
+    char * queue[GTP_QUEUE_SIZ];
+    u16 queue_start;
+    u16 queue_count;
+    bool closed; /* no more commands will be read */
+    bool quit;
+
+    /* state swapped with the global variables */
+    game_record game;
+    time_system clock_black;
+    time_system clock_white;
+    latency_probe latency_black;
+    latency_probe latency_white;
+    latency_estimator latency;
+    d16 komi;
+    bool has_genmoved_as_black;
+    bool has_genmoved_as_white;
+    bool out_on_time_warning;
+    bool tt_requires_maintenance;
+    out_board last_out_board;
+} gtp_session;
+
+static gtp_session * sessions[MAX_SERVER_SESSIONS + 1];
+static gtp_session * current_session = NULL;
+static u16 max_sessions;
+static time_system initial_clock_black;
+static time_system initial_clock_white;
+static latency_estimator initial_latency;
+
 extern clock_t start_cpu_time;
 
 static void update_player_names() {
@@ -138,6 +271,20 @@ static void update_player_names() {
     return;
 }
 
+static void gtp_write(
+    FILE * fp,
+    const char * s
+) {
+    pthread_mutex_lock(&output_lock);
+    size_t w = fwrite(s, 1, strlen(s), fp);
+    if (w != strlen(s)) {
+        flog_crit("gtp", "failed to write to comm. file descriptor");
+    }
+
+    fflush(fp);
+    pthread_mutex_unlock(&output_lock);
+}
+
 static void gtp_error(
     FILE * fp,
     int id,
@@ -150,12 +297,7 @@ static void gtp_error(
         snprintf(buf, MAX_PAGE_SIZ, "?%d %s\n\n", id, s);
     }
 
-    size_t w = fwrite(buf, 1, strlen(buf), fp);
-    if (w != strlen(buf)) {
-        flog_crit("gtp", "failed to write to comm. file descriptor");
-    }
-
-    fflush(fp);
+    gtp_write(fp, buf);
 
     flog_prot("gtp", buf);
     release(buf);
@@ -181,12 +323,7 @@ static void gtp_answer(
         }
     }
 
-    size_t w = fwrite(buf, 1, strlen(buf), fp);
-    if (w != strlen(buf)) {
-        flog_crit("gtp", "failed to write to comm. file descriptor");
-    }
-
-    fflush(fp);
+    gtp_write(fp, buf);
 
     flog_prot("gtp", buf);
     release(buf);
@@ -258,9 +395,27 @@ static void gtp_quit(
 ) {
     gtp_answer(fp, id, NULL);
 
+    if (current_session != NULL) {
+        current_session->quit = true;
+        return;
+    }
+
     exit(EXIT_SUCCESS);
 }
 
+static void gtp_interrupt(
+    FILE * fp,
+    int id
+) {
+    pthread_mutex_lock(&input_lock);
+    if (command_running) {
+        interrupt_evaluation();
+    }
+    pthread_mutex_unlock(&input_lock);
+
+    gtp_answer(fp, id, NULL);
+}
+
 static void gtp_clear_cache(
     FILE * fp,
     int id
@@ -313,8 +468,12 @@ static void gtp_clear_board(
     }
 
     clear_game_record(&current_game);
+    pthread_mutex_lock(&clock_lock);
     reset_clock(&current_clock_black);
     reset_clock(&current_clock_white);
+    latency_probe_reset(&latency_black);
+    latency_probe_reset(&latency_white);
+    pthread_mutex_unlock(&clock_lock);
     out_on_time_warning = false;
 }
 
@@ -497,7 +656,15 @@ static void generic_genmove(
         has_play = evaluate_position_sims(&current_state, is_black, &out_b, limit_by_playouts);
     } else {
         u16 stones = stone_count(current_state.p);
+        pthread_mutex_lock(&clock_lock);
         time_to_play = calc_time_to_play(curr_clock, stones);
+        u32 max_time_to_play = calc_max_time_to_play(curr_clock, stones);
+        pthread_mutex_unlock(&clock_lock);
+
+        if (genmoves_pending > 1 && time_to_play != UINT32_MAX) {
+            time_to_play /= genmoves_pending;
+            max_time_to_play /= genmoves_pending;
+        }
 
         if (time_to_play == UINT32_MAX) {
             snprintf(buf, MAX_PAGE_SIZ, "time to play: infinite");
@@ -512,8 +679,9 @@ static void generic_genmove(
 
         u64 stop_time = request_received_mark + time_to_play;
         u64 early_stop_time = request_received_mark + (time_to_play / 3);
+        u64 max_stop_time = request_received_mark + max_time_to_play;
 
-        has_play = evaluate_position_timed(&current_state, is_black, &out_b, stop_time, early_stop_time);
+        has_play = evaluate_position_timed(&current_state, is_black, &out_b, stop_time, early_stop_time, max_stop_time);
     }
 
     memcpy(&last_out_board, &out_b, sizeof(out_board));
@@ -557,7 +725,10 @@ static void generic_genmove(
         if (limit_by_playouts == 0) {
             u32 elapsed = (u32)(current_time_in_millis() - request_received_mark);
 
+            pthread_mutex_lock(&clock_lock);
             advance_clock(curr_clock, elapsed);
+            latency_play_answered(is_black ? &latency_black : &latency_white, elapsed);
+            pthread_mutex_unlock(&clock_lock);
         }
 
         /*
@@ -662,8 +833,12 @@ static void gtp_time_settings(
 
     gtp_answer(fp, id, NULL);
 
+    pthread_mutex_lock(&clock_lock);
     set_time_system(&current_clock_black, new_main_time * 1000, new_byo_yomi_time * 1000, new_byo_yomi_stones, 1);
     set_time_system(&current_clock_white, new_main_time * 1000, new_byo_yomi_time * 1000, new_byo_yomi_stones, 1);
+    latency_probe_reset(&latency_black);
+    latency_probe_reset(&latency_white);
+    pthread_mutex_unlock(&clock_lock);
 
 
     char * new_ts_as_s = alloc();
@@ -716,8 +891,12 @@ static void gtp_kgs_time_settings(
             return;
         }
 
+        pthread_mutex_lock(&clock_lock);
         set_time_system(&current_clock_black, new_main_time * 1000, 0, 0, 0);
         set_time_system(&current_clock_white, new_main_time * 1000, 0, 0, 0);
+        latency_probe_reset(&latency_black);
+        latency_probe_reset(&latency_white);
+        pthread_mutex_unlock(&clock_lock);
     } else if (strcmp(systemstr, "byoyomi") == 0) {
         const char * byo_yomi_periods = byo_yomi_stones;
 
@@ -742,8 +921,12 @@ static void gtp_kgs_time_settings(
             return;
         }
 
+        pthread_mutex_lock(&clock_lock);
         set_time_system(&current_clock_black, new_main_time * 1000, new_byo_yomi_time * 1000, 1, new_byo_yomi_periods);
         set_time_system(&current_clock_white, new_main_time * 1000, new_byo_yomi_time * 1000, 1, new_byo_yomi_periods);
+        latency_probe_reset(&latency_black);
+        latency_probe_reset(&latency_white);
+        pthread_mutex_unlock(&clock_lock);
     } else if (strcmp(systemstr, "canadian") == 0) {
         u32 new_main_time;
         u32 new_byo_yomi_time;
@@ -767,8 +950,12 @@ static void gtp_kgs_time_settings(
             return;
         }
 
+        pthread_mutex_lock(&clock_lock);
         set_time_system(&current_clock_black, new_main_time * 1000, new_byo_yomi_time * 1000, new_byo_yomi_stones, 1);
         set_time_system(&current_clock_white, new_main_time * 1000, new_byo_yomi_time * 1000, new_byo_yomi_stones, 1);
+        latency_probe_reset(&latency_black);
+        latency_probe_reset(&latency_white);
+        pthread_mutex_unlock(&clock_lock);
     } else {
         gtp_error(fp, id, "syntax error");
         release(previous_ts_as_s);
@@ -829,6 +1016,9 @@ static void gtp_time_left_seconds(
 
     time_system * curr_clock = is_black ? &current_clock_black : &current_clock_white;
 
+    pthread_mutex_lock(&clock_lock);
+    latency_clock_reported(is_black ? &latency_black : &latency_white,
+        new_time_remaining * 1000, new_byo_yomi_stones_remaining);
     if (new_byo_yomi_stones_remaining == 0) {
         /* Main time is still counting down */
         curr_clock->main_time_remaining = new_time_remaining * 1000;
@@ -837,6 +1027,7 @@ static void gtp_time_left_seconds(
         curr_clock->byo_yomi_time_remaining = new_time_remaining * 1000;
         curr_clock->byo_yomi_stones_remaining = new_byo_yomi_stones_remaining;
     }
+    pthread_mutex_unlock(&clock_lock);
 }
 
 static void gtp_time_left_millis(
@@ -875,6 +1066,9 @@ static void gtp_time_left_millis(
 
     time_system * curr_clock = is_black ? &current_clock_black : &current_clock_white;
 
+    pthread_mutex_lock(&clock_lock);
+    latency_clock_reported(is_black ? &latency_black : &latency_white,
+        new_time_remaining, new_byo_yomi_stones_remaining);
     if (new_byo_yomi_stones_remaining == 0) {
         /* Main time is still counting down */
         curr_clock->main_time_remaining = new_time_remaining;
@@ -883,6 +1077,7 @@ static void gtp_time_left_millis(
         curr_clock->byo_yomi_time_remaining = new_time_remaining;
         curr_clock->byo_yomi_stones_remaining = new_byo_yomi_stones_remaining;
     }
+    pthread_mutex_unlock(&clock_lock);
 }
 
 static void gtp_cputime(
@@ -967,6 +1162,15 @@ static void gtp_game_info(
     }
 
     game_record_to_string(s, MAX_FILE_SIZ, &current_game);
+
+    pthread_mutex_lock(&clock_lock);
+    u32 latency = latency_compensation();
+    u32 samples = latency_sample_count();
+    pthread_mutex_unlock(&clock_lock);
+
+    u32 idx = strlen(s);
+    snprintf(s + idx, MAX_FILE_SIZ - idx, "Latency estimate: %u ms (%u plays measured)\n",
+        latency, samples);
     gtp_answer(fp, id, s);
     free(s);
 }
@@ -1026,6 +1230,95 @@ static void gtp_last_evaluation(
     release(s);
 }
 
+static void report_analysis(
+    const analysis_snapshot * snapshot
+) {
+    char * buf = alloc();
+    char * vertex = alloc();
+    u32 idx = 0;
+
+    for (u16 i = 0; i < snapshot->plays_count; ++i) {
+        const analysis_play * ap = &snapshot->plays[i];
+        if (idx > MAX_PAGE_SIZ - 256) {
+            break;
+        }
+
+        coord_to_gtp_vertex(vertex, ap->m);
+        idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "%sinfo move %s visits %u "
+            "winrate %u rave %u order %u pv", i == 0 ? "" : " ", vertex,
+            ap->visits, (u32)(ap->winrate * 10000.0), (u32)(ap->rave_winrate *
+            10000.0), i);
+
+        for (u8 j = 0; j < ap->pv_len; ++j) {
+            coord_to_gtp_vertex(vertex, ap->pv[j]);
+            idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, " %s", vertex);
+        }
+    }
+
+    snprintf(buf + idx, MAX_PAGE_SIZ - idx, "\n");
+    gtp_write(analysis_fp, buf);
+
+    release(vertex);
+    release(buf);
+}
+
+/*
+Searches the current position until another command is received, streaming the
+most visited plays every interval centiseconds (100 by default).
+*/
+static void gtp_lz_analyze(
+    FILE * fp,
+    int id,
+    u16 argc,
+    char * argv[]
+) {
+    bool is_black = current_player_color(&current_game);
+    u32 interval = 100;
+
+    for (u16 i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "interval") == 0) {
+            continue;
+        }
+
+        if (!parse_color(&is_black, argv[i]) && (!parse_uint(&interval, argv[i])
+            || interval == 0)) {
+            gtp_error(fp, id, "syntax error");
+            return;
+        }
+    }
+
+    if (current_session != NULL) {
+        gtp_error(fp, id, "not available in server mode");
+        return;
+    }
+
+    board current_state;
+    current_game_state(&current_state, &current_game);
+
+    char * buf = alloc();
+    if (id == -1) {
+        snprintf(buf, MAX_PAGE_SIZ, "= \n");
+    } else {
+        snprintf(buf, MAX_PAGE_SIZ, "=%d\n", id);
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    command_streaming = true;
+    gtp_write(fp, buf);
+    pthread_mutex_unlock(&stream_lock);
+
+    flog_prot("gtp", buf);
+    release(buf);
+
+    analysis_fp = fp;
+    analyze_in_background(&current_state, is_black, &input_pending, interval * 10, report_analysis);
+
+    pthread_mutex_lock(&stream_lock);
+    gtp_write(fp, "\n");
+    command_streaming = false;
+    pthread_mutex_unlock(&stream_lock);
+}
+
 static void gtp_final_score(
     FILE * fp,
     int id
@@ -1216,12 +1509,420 @@ static void gtp_printsgf(
     release(buf);
 }
 
+/*
+Parses and executes a single command, writing the response.
+*/
+static void gtp_execute(
+    FILE * fp,
+    char * line
+) {
+    flog_prot("gtp", line);
+
+    char * save_ptr;
+    char * id = strtok_r(line, " |", &save_ptr);
+    d32 idn;
+    char * cmd;
+    if (parse_int(&idn, id)) {
+        cmd = strtok_r(NULL, " |", &save_ptr);
+    } else {
+        cmd = id;
+        id = NULL;
+        idn = -1;
+    }
+
+    if (cmd == NULL) {
+        return;
+    }
+
+    u16 argc = 0;
+    char * args[TOTAL_BOARD_SIZ];
+    for (u16 i = 0; i < TOTAL_BOARD_SIZ; ++i) {
+        args[i] = strtok_r(NULL, " |", &save_ptr);
+
+        if (args[i] == NULL) {
+            ++i;
+
+            for (; i < TOTAL_BOARD_SIZ; ++i) {
+                args[i] = NULL;
+            }
+
+            break;
+        }
+
+        ++argc;
+    }
+
+lbl_parse_command:
+    /*
+    Commands more commonly used should be parsed first:
+    */
+    if (argc == 2 && strcmp(cmd, "play") == 0) {
+        gtp_play(fp, idn, args[0], args[1], false);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "genmove") == 0) {
+        gtp_genmove(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 3 && strcmp(cmd, "time_left") == 0) {
+        gtp_time_left_seconds(fp, idn, args[0], args[1], args[2]);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "reg_genmove") == 0) {
+        gtp_reg_genmove(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "clear_board") == 0) {
+        gtp_clear_board(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "kgs-game_over") == 0) {
+        gtp_kgs_game_over(fp, idn);
+        return;
+    }
+
+    if (argc <= 1 && strcmp(cmd, "komi") == 0) {
+        gtp_komi(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "kgs-genmove_cleanup") == 0) {
+        gtp_genmove_cleanup(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "final_status_list") == 0) {
+        gtp_final_status_list(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 3 && strcmp(cmd, "mtld-time_left") == 0) {
+        gtp_time_left_millis(fp, idn, args[0], args[1], args[2]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "undo") == 0) {
+        gtp_undo(fp, idn, NULL);
+        return;
+    }
+
+    if (argc <= 1 && strcmp(cmd, "gg-undo") == 0) {
+        gtp_undo(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "protocol_version") == 0) {
+        gtp_protocol_version(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "name") == 0) {
+        gtp_name(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "version") == 0) {
+        gtp_version(fp, idn);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "known_command") == 0) {
+        gtp_known_command(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 0 && (strcmp(cmd, "list_commands") == 0 || strcmp(cmd, "help") == 0)) {
+        gtp_list_commands(fp, idn);
+        return;
+    }
+
+    if (argc <= 1 && strcmp(cmd, "boardsize") == 0) {
+        gtp_boardsize(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "showboard") == 0) {
+        gtp_showboard(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "final_score") == 0) {
+        gtp_final_score(fp, idn);
+        return;
+    }
+
+    if (argc == 1 && strcmp(cmd, "place_free_handicap") == 0) {
+        gtp_place_free_handicap(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc > 1 && strcmp(cmd, "set_free_handicap") == 0) {
+        gtp_set_free_handicap(fp, idn, argc, args);
+        return;
+    }
+
+    if (argc == 3 && strcmp(cmd, "time_settings") == 0) {
+        gtp_time_settings(fp, idn, args[0], args[1], args[2]);
+        return;
+    }
+
+    if (argc > 1 && argc < 5 && strcmp(cmd, "kgs-time_settings") == 0) {
+        gtp_kgs_time_settings(fp, idn, args[0], args[1], args[2], args[3]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "cputime") == 0) {
+        gtp_cputime(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "gomill-cpu_time") == 0) {
+        gtp_cputime(fp, idn);
+        return;
+    }
+
+    if (strcmp(cmd, "echo") == 0) {
+        gtp_echo(fp, idn, argc, args, false);
+        return;
+    }
+
+    if (strcmp(cmd, "echo_err") == 0) {
+        gtp_echo(fp, idn, argc, args, true);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "mtld-last_evaluation") == 0) {
+        gtp_last_evaluation(fp, idn);
+        return;
+    }
+
+    if ((argc == 1 || argc == 2) && strcmp(cmd, "loadsgf") == 0) {
+        gtp_loadsgf(fp, idn, args[0], args[1]);
+        return;
+    }
+
+    if (argc <= 1 && strcmp(cmd, "printsgf") == 0) {
+        gtp_printsgf(fp, idn, args[0]);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "clear_cache") == 0) {
+        gtp_clear_cache(fp, idn);
+        return;
+    }
+
+    if (argc <= 3 && strcmp(cmd, "lz-analyze") == 0) {
+        gtp_lz_analyze(fp, idn, argc, args);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "mtld-interrupt") == 0) {
+        gtp_interrupt(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "mtld-game_info") == 0) {
+        gtp_game_info(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "gomill-describe_engine") == 0) {
+        gtp_gomill_describe_engine(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "quit") == 0) {
+        gtp_quit(fp, idn);
+        return;
+    }
+
+    if (argc == 0 && strcmp(cmd, "exit") == 0) {
+        gtp_quit(fp, idn);
+        return;
+    }
+
+
+    const char * best_dst_str = NULL;
+    u16 best_dst_val = 0;
+    bool command_exists = false;
+    u16 i = 0;
+
+    while (supported_commands[i] != NULL) {
+        if (strcmp(cmd, supported_commands[i]) == 0) {
+            command_exists = true;
+            break;
+        } else {
+            u16 lev_dst = levenshtein_dst(supported_commands[i], cmd);
+
+            if (best_dst_str == NULL || lev_dst < best_dst_val) {
+                best_dst_str = supported_commands[i];
+                best_dst_val = lev_dst;
+            }
+        }
+        ++i;
+    }
+
+    if (command_exists) {
+        fprintf(stderr, "warning: command '%s' exists but the parameter list is wrong; please check the documentation\n", cmd);
+        gtp_error(fp, idn, "syntax error");
+    } else {
+        if (best_dst_val < 2) {
+            strcpy(cmd, best_dst_str);
+            goto lbl_parse_command;
+        }
+
+        if (best_dst_val < 4) {
+            fprintf(stderr, "warning: command '%s' does not exist; did you mean '%s'?\n", cmd, best_dst_str);
+        } else {
+            fprintf(stderr, "warning: command '%s' does not exist; run \"help\" for a list of available commands\n", cmd);
+        }
+
+        gtp_error(fp, idn, "unknown command");
+    }
+}
+
+/*
+RETURNS whether the command of the line, ignoring its id, is in the list
+*/
+static bool command_in_list(
+    const char * line,
+    const char * const list[]
+) {
+    char * buf = alloc();
+    strncpy(buf, line, MAX_PAGE_SIZ);
+
+    char * save_ptr;
+    char * cmd = strtok_r(buf, " |", &save_ptr);
+    d32 idn;
+    if (cmd != NULL && parse_int(&idn, cmd)) {
+        cmd = strtok_r(NULL, " |", &save_ptr);
+    }
+
+    bool ret = false;
+    if (cmd != NULL) {
+        for (u16 i = 0; list[i] != NULL; ++i) {
+            if (strcmp(cmd, list[i]) == 0) {
+                ret = true;
+                break;
+            }
+        }
+    }
+
+    release(buf);
+    return ret;
+}
+
+static void * input_reader(
+    void * arg
+) {
+    FILE * fp = (FILE *)arg;
+    char * buf = alloc();
+
+    while (1) {
+        char * line = fgets(buf, MAX_PAGE_SIZ, stdin);
+        if (line == NULL) {
+            pthread_mutex_lock(&input_lock);
+            input_closed = true;
+            input_pending = true;
+            pthread_cond_broadcast(&input_cond);
+            pthread_mutex_unlock(&input_lock);
+            release(buf);
+            return NULL;
+        }
+
+        char * comment = strchr(line, '#');
+        if (comment != NULL) {
+            comment[0] = 0;
+        }
+
+        line = trim(line);
+        if (line == NULL) {
+            continue;
+        }
+
+        pthread_mutex_lock(&stream_lock);
+        if (!command_streaming && command_in_list(line, immediate_commands)) {
+            gtp_execute(fp, line);
+            pthread_mutex_unlock(&stream_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&stream_lock);
+
+        pthread_mutex_lock(&input_lock);
+        if (input_queue_count == 0 && !command_running &&
+            command_in_list(line, clock_commands)) {
+            pthread_mutex_unlock(&input_lock);
+            gtp_execute(fp, line);
+            continue;
+        }
+
+        while (input_queue_count == GTP_QUEUE_SIZ) {
+            pthread_cond_wait(&input_cond, &input_lock);
+        }
+
+        char * req = alloc();
+        strncpy(req, line, MAX_PAGE_SIZ);
+        input_queue[(input_queue_start + input_queue_count) % GTP_QUEUE_SIZ] = req;
+        input_queue_count++;
+
+        input_pending = true;
+        pthread_cond_broadcast(&input_cond);
+        pthread_mutex_unlock(&input_lock);
+    }
+}
+
+/*
+Waits for the next queued command and marks it as running. The time the command
+is taken is used as the time the request was received, like when reading each
+line only after finishing the previous command. The line must be released after
+the command is finished.
+RETURNS the command line or NULL if standard input was closed and no more
+commands are queued
+*/
+static char * next_command() {
+    pthread_mutex_lock(&input_lock);
+    while (input_queue_count == 0 && !input_closed) {
+        pthread_cond_wait(&input_cond, &input_lock);
+    }
+
+    if (input_queue_count == 0) {
+        pthread_mutex_unlock(&input_lock);
+        return NULL;
+    }
+
+    char * req = input_queue[input_queue_start];
+    request_received_mark = current_time_in_millis();
+    input_queue_start = (input_queue_start + 1) % GTP_QUEUE_SIZ;
+    input_queue_count--;
+    input_pending = input_queue_count > 0 || input_closed;
+
+    command_running = true;
+    clear_evaluation_interrupt();
+
+    pthread_cond_broadcast(&input_cond);
+    pthread_mutex_unlock(&input_lock);
+    return req;
+}
+
+static void command_finished() {
+    pthread_mutex_lock(&input_lock);
+    command_running = false;
+    clear_evaluation_interrupt();
+    pthread_mutex_unlock(&input_lock);
+}
+
 /*
 Main function for GTP mode - performs command selction.
 
 Thinking in opponents turns should be disabled for most matches. It doesn't
 limit itself, so it will keep using the MCTS if used previously until the
-opponent plays or memory runs out.
+opponent plays or memory runs out. The pondering search runs continuously and is
+interrupted as soon as a new line is read.
 */
 void main_gtp(
     bool think_in_opt_turn
@@ -1250,9 +1951,9 @@ void main_gtp(
     clear_out_board(&last_out_board);
     clear_game_record(&current_game);
 
-    fd_set readfs;
-    memset(&readfs, 0, sizeof(fd_set));
-    char * in_buf = alloc();
+    if (pthread_create(&input_thread, NULL, input_reader, out_fp) != 0) {
+        flog_crit("gtp", "failed to start standard input thread");
+    }
 
     while (1) {
         bool is_black = current_player_color(&current_game);
@@ -1260,301 +1961,343 @@ void main_gtp(
         board current_state;
         current_game_state(&current_state, &current_game);
 
-        if (think_in_opt_turn) {
-            do {
-                FD_ZERO(&readfs);
-                FD_SET(STDIN_FILENO, &readfs);
-                struct timeval tm;
-                tm.tv_sec = 0;
-                tm.tv_usec = 2000;
-
-                int ready = select(STDIN_FILENO + 1, &readfs, NULL, NULL, &tm);
-                if (ready == -1) {
-                    flog_crit("gtp", "standard input file descriptor closed");
-                } else if (ready == 0) { /* nothing to read */
-                    evaluate_in_background(&current_state, is_black);
-                } else {
-                    break;
-                }
-            } while(1);
-        }
-
         opt_turn_maintenance(&current_state, is_black);
         reset_mcts_can_resume();
 
-        char * line = fgets(in_buf, MAX_PAGE_SIZ, stdin);
-        request_received_mark = current_time_in_millis();
-        if (line == NULL) {
-            flog_crit("gtp", "standard input file descriptor closed");
+        if (think_in_opt_turn) {
+            evaluate_in_background(&current_state, is_black, &input_pending);
         }
 
-        line = strtok(line, "#");
+        char * line = next_command();
         if (line == NULL) {
-            continue;
+            flog_crit("gtp", "standard input file descriptor closed");
+            return;
         }
 
-        line = trim(line);
+        gtp_execute(out_fp, line);
+        release(line);
+        command_finished();
+    }
+}
+
+static void session_swap_in(
+    gtp_session * s
+) {
+    memcpy(&current_game, &s->game, sizeof(game_record));
+    memcpy(&last_out_board, &s->last_out_board, sizeof(out_board));
+    current_clock_black = s->clock_black;
+    current_clock_white = s->clock_white;
+    latency_black = s->latency_black;
+    latency_white = s->latency_white;
+    set_latency_estimator(&s->latency);
+    komi = s->komi;
+    has_genmoved_as_black = s->has_genmoved_as_black;
+    has_genmoved_as_white = s->has_genmoved_as_white;
+    out_on_time_warning = s->out_on_time_warning;
+    tt_requires_maintenance = s->tt_requires_maintenance;
+
+    tt_set_owner(s->id);
+    current_session = s;
+}
+
+static void session_swap_out(
+    gtp_session * s
+) {
+    memcpy(&s->game, &current_game, sizeof(game_record));
+    memcpy(&s->last_out_board, &last_out_board, sizeof(out_board));
+    s->clock_black = current_clock_black;
+    s->clock_white = current_clock_white;
+    s->latency_black = latency_black;
+    s->latency_white = latency_white;
+    get_latency_estimator(&s->latency);
+    s->komi = komi;
+    s->has_genmoved_as_black = has_genmoved_as_black;
+    s->has_genmoved_as_white = has_genmoved_as_white;
+    s->out_on_time_warning = out_on_time_warning;
+    s->tt_requires_maintenance = tt_requires_maintenance;
+
+    tt_set_owner(0);
+    current_session = NULL;
+}
+
+static void * session_reader(
+    void * arg
+) {
+    gtp_session * s = (gtp_session *)arg;
+    char * buf = alloc();
+
+    int fd = dup(s->fd);
+    FILE * in = (fd == -1) ? NULL : fdopen(fd, "r");
+
+    while (in != NULL) {
+        char * line = fgets(buf, MAX_PAGE_SIZ, in);
         if (line == NULL) {
-            continue;
+            break;
         }
 
-        flog_prot("gtp", line);
-
-        char * save_ptr;
-        char * id = strtok_r(line, " |", &save_ptr);
-        d32 idn;
-        char * cmd;
-        if (parse_int(&idn, id)) {
-            cmd = strtok_r(NULL, " |", &save_ptr);
-        } else {
-            cmd = id;
-            id = NULL;
-            idn = -1;
+        char * comment = strchr(line, '#');
+        if (comment != NULL) {
+            comment[0] = 0;
         }
 
-        if (cmd == NULL) {
+        line = trim(line);
+        if (line == NULL) {
             continue;
         }
 
-        u16 argc = 0;
-        char * args[TOTAL_BOARD_SIZ];
-        for (u16 i = 0; i < TOTAL_BOARD_SIZ; ++i) {
-            args[i] = strtok_r(NULL, " |", &save_ptr);
-
-            if (args[i] == NULL) {
-                ++i;
+        pthread_mutex_lock(&input_lock);
+        while (s->queue_count == GTP_QUEUE_SIZ) {
+            pthread_cond_wait(&input_cond, &input_lock);
+        }
 
-                for (; i < TOTAL_BOARD_SIZ; ++i) {
-                    args[i] = NULL;
-                }
+        char * req = alloc();
+        strncpy(req, line, MAX_PAGE_SIZ);
+        s->queue[(s->queue_start + s->queue_count) % GTP_QUEUE_SIZ] = req;
+        s->queue_count++;
 
-                break;
-            }
+        pthread_cond_broadcast(&input_cond);
+        pthread_mutex_unlock(&input_lock);
+    }
 
-            ++argc;
-        }
+    if (in != NULL) {
+        fclose(in);
+    } else if (fd != -1) {
+        close(fd);
+    }
 
-lbl_parse_command:
-        /*
-        Commands more commonly used should be parsed first:
-        */
-        if (argc == 2 && strcmp(cmd, "play") == 0) {
-            gtp_play(out_fp, idn, args[0], args[1], false);
-            continue;
-        }
+    release(buf);
 
-        if (argc == 1 && strcmp(cmd, "genmove") == 0) {
-            gtp_genmove(out_fp, idn, args[0]);
-            continue;
-        }
+    pthread_mutex_lock(&input_lock);
+    s->closed = true;
+    pthread_cond_broadcast(&input_cond);
+    pthread_mutex_unlock(&input_lock);
+    return NULL;
+}
 
-        if (argc == 3 && strcmp(cmd, "time_left") == 0) {
-            gtp_time_left_seconds(out_fp, idn, args[0], args[1], args[2]);
-            continue;
-        }
+static void * session_acceptor(
+    void * arg
+) {
+    int server_fd = *((int *)arg);
+    char * buf = alloc();
 
-        if (argc == 1 && strcmp(cmd, "reg_genmove") == 0) {
-            gtp_reg_genmove(out_fp, idn, args[0]);
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(server_fd, (struct sockaddr *)&addr, &addr_len);
+        if (fd == -1) {
+            flog_warn("gtp", "failed to accept connection");
             continue;
         }
 
-        if (argc == 0 && strcmp(cmd, "clear_board") == 0) {
-            gtp_clear_board(out_fp, idn);
-            continue;
+        gtp_session * s = calloc(1, sizeof(gtp_session));
+        if (s == NULL) {
+            flog_crit("gtp", "system out of memory");
         }
 
-        if (argc == 0 && strcmp(cmd, "kgs-game_over") == 0) {
-            gtp_kgs_game_over(out_fp, idn);
+        s->fd = fd;
+        s->fp = fdopen(fd, "w");
+        if (s->fp == NULL) {
+            flog_warn("gtp", "file descriptor duplication failure");
+            close(fd);
+            free(s);
             continue;
         }
 
-        if (argc <= 1 && strcmp(cmd, "komi") == 0) {
-            gtp_komi(out_fp, idn, args[0]);
-            continue;
+        clear_game_record(&s->game);
+        clear_out_board(&s->last_out_board);
+        s->clock_black = initial_clock_black;
+        s->clock_white = initial_clock_white;
+        latency_probe_reset(&s->latency_black);
+        latency_probe_reset(&s->latency_white);
+        s->latency = initial_latency;
+        s->komi = DEFAULT_KOMI;
+
+        pthread_mutex_lock(&input_lock);
+        for (u16 i = 1; i <= max_sessions; ++i) {
+            if (sessions[i] == NULL) {
+                s->id = i;
+                sessions[i] = s;
+                break;
+            }
         }
+        pthread_mutex_unlock(&input_lock);
 
-        if (argc == 1 && strcmp(cmd, "kgs-genmove_cleanup") == 0) {
-            gtp_genmove_cleanup(out_fp, idn, args[0]);
+        if (s->id == 0) {
+            flog_warn("gtp", "connection refused: too many sessions");
+            gtp_write(s->fp, "? too many sessions\n\n");
+            fclose(s->fp);
+            free(s);
             continue;
         }
 
-        if (argc == 1 && strcmp(cmd, "final_status_list") == 0) {
-            gtp_final_status_list(out_fp, idn, args[0]);
-            continue;
+        if (pthread_create(&s->reader, NULL, session_reader, s) != 0) {
+            flog_crit("gtp", "failed to start session thread");
         }
 
-        if (argc == 3 && strcmp(cmd, "mtld-time_left") == 0) {
-            gtp_time_left_millis(out_fp, idn, args[0], args[1], args[2]);
-            continue;
-        }
+        snprintf(buf, MAX_PAGE_SIZ, "session %u connected from %s", s->id,
+            inet_ntoa(addr.sin_addr));
+        flog_info("gtp", buf);
+    }
 
-        if (argc == 0 && strcmp(cmd, "undo") == 0) {
-            gtp_undo(out_fp, idn, NULL);
-            continue;
-        }
+    return NULL;
+}
 
-        if (argc <= 1 && strcmp(cmd, "gg-undo") == 0) {
-            gtp_undo(out_fp, idn, args[0]);
-            continue;
-        }
+/*
+Waits for a session with commands pending, or closed, taking the sessions in
+turn.
+RETURNS the session
+*/
+static gtp_session * next_session() {
+    static u16 last_served = 0;
 
-        if (argc == 0 && strcmp(cmd, "protocol_version") == 0) {
-            gtp_protocol_version(out_fp, idn);
-            continue;
+    pthread_mutex_lock(&input_lock);
+    while (1) {
+        for (u16 k = 0; k < max_sessions; ++k) {
+            u16 i = (last_served + k) % max_sessions + 1;
+            gtp_session * s = sessions[i];
+
+            if (s != NULL && (s->queue_count > 0 || s->closed)) {
+                last_served = i;
+                pthread_mutex_unlock(&input_lock);
+                return s;
+            }
         }
 
-        if (argc == 0 && strcmp(cmd, "name") == 0) {
-            gtp_name(out_fp, idn);
-            continue;
-        }
+        pthread_cond_wait(&input_cond, &input_lock);
+    }
+}
 
-        if (argc == 0 && strcmp(cmd, "version") == 0) {
-            gtp_version(out_fp, idn);
-            continue;
-        }
+static void close_session(
+    gtp_session * s
+) {
+    pthread_join(s->reader, NULL);
 
-        if (argc == 1 && strcmp(cmd, "known_command") == 0) {
-            gtp_known_command(out_fp, idn, args[0]);
-            continue;
-        }
+    pthread_mutex_lock(&input_lock);
+    sessions[s->id] = NULL;
+    pthread_mutex_unlock(&input_lock);
 
-        if (argc == 0 && (strcmp(cmd, "list_commands") == 0 || strcmp(cmd, "help") == 0)) {
-            gtp_list_commands(out_fp, idn);
-            continue;
-        }
+    tt_set_owner(s->id);
+    u32 freed = tt_clean_all();
+    tt_set_owner(0);
 
-        if (argc <= 1 && strcmp(cmd, "boardsize") == 0) {
-            gtp_boardsize(out_fp, idn, args[0]);
-            continue;
-        }
+    char * buf = alloc();
+    snprintf(buf, MAX_PAGE_SIZ, "session %u closed; %u states freed", s->id,
+        freed);
+    flog_info("gtp", buf);
+    release(buf);
 
-        if (argc == 0 && strcmp(cmd, "showboard") == 0) {
-            gtp_showboard(out_fp, idn);
-            continue;
-        }
+    fclose(s->fp);
+    free(s);
+}
 
-        if (argc == 0 && strcmp(cmd, "final_score") == 0) {
-            gtp_final_score(out_fp, idn);
-            continue;
-        }
+/*
+Main function for the GTP server mode. Listens on a TCP port of the loopback
+interface and plays up to nr_sessions games at the same time, one per
+connection. Each command is executed with the whole thread pool, in turn with
+the commands of the other sessions; thinking in the opponents turns and
+analysis commands are not available.
+*/
+void main_gtp_server(
+    u16 port,
+    u16 nr_sessions
+) {
+    load_hoshi_points();
+    tt_init();
 
-        if (argc == 1 && strcmp(cmd, "place_free_handicap") == 0) {
-            gtp_place_free_handicap(out_fp, idn, args[0]);
-            continue;
-        }
+    char * s = alloc();
+    build_info(s);
+    flog_debug("gtp", s);
 
-        if (argc > 1 && strcmp(cmd, "set_free_handicap") == 0) {
-            gtp_set_free_handicap(out_fp, idn, argc, args);
-            continue;
-        }
+    signal(SIGPIPE, SIG_IGN);
 
-        if (argc == 3 && strcmp(cmd, "time_settings") == 0) {
-            gtp_time_settings(out_fp, idn, args[0], args[1], args[2]);
-            continue;
-        }
+    max_sessions = nr_sessions;
+    u32 quota = tt_max_states() / nr_sessions;
+    for (u16 i = 1; i <= nr_sessions; ++i) {
+        tt_set_quota(i, quota);
+    }
 
-        if (argc > 1 && argc < 5 && strcmp(cmd, "kgs-time_settings") == 0) {
-            gtp_kgs_time_settings(out_fp, idn, args[0], args[1], args[2], args[3]);
-            continue;
-        }
+    initial_clock_black = current_clock_black;
+    initial_clock_white = current_clock_white;
+    get_latency_estimator(&initial_latency);
 
-        if (argc == 0 && strcmp(cmd, "cputime") == 0) {
-            gtp_cputime(out_fp, idn);
-            continue;
-        }
+    static int server_fd;
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd == -1) {
+        flog_crit("gtp", "failed to create server socket");
+    }
 
-        if (argc == 0 && strcmp(cmd, "gomill-cpu_time") == 0) {
-            gtp_cputime(out_fp, idn);
-            continue;
-        }
+    int reuse = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
-        if (strcmp(cmd, "echo") == 0) {
-            gtp_echo(out_fp, idn, argc, args, false);
-            continue;
-        }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
 
-        if (strcmp(cmd, "echo_err") == 0) {
-            gtp_echo(out_fp, idn, argc, args, true);
-            continue;
-        }
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server_fd, nr_sessions) != 0) {
+        flog_crit("gtp", "failed to listen on server port");
+    }
 
-        if (argc == 0 && strcmp(cmd, "mtld-last_evaluation") == 0) {
-            gtp_last_evaluation(out_fp, idn);
-            continue;
-        }
+    snprintf(s, MAX_PAGE_SIZ, "matilda now serving GTP on port %u for up to %u "
+        "sessions", port, nr_sessions);
+    flog_info("gtp", s);
+    release(s);
 
-        if ((argc == 1 || argc == 2) && strcmp(cmd, "loadsgf") == 0) {
-            gtp_loadsgf(out_fp, idn, args[0], args[1]);
-            continue;
-        }
+    if (pthread_create(&input_thread, NULL, session_acceptor, &server_fd) != 0) {
+        flog_crit("gtp", "failed to start server thread");
+    }
 
-        if (argc <= 1 && strcmp(cmd, "printsgf") == 0) {
-            gtp_printsgf(out_fp, idn, args[0]);
-            continue;
-        }
+    while (1) {
+        gtp_session * session = next_session();
 
-        if (argc == 0 && strcmp(cmd, "clear_cache") == 0) {
-            gtp_clear_cache(out_fp, idn);
+        pthread_mutex_lock(&input_lock);
+        if (session->queue_count == 0) {
+            pthread_mutex_unlock(&input_lock);
+            close_session(session);
             continue;
         }
 
-        if (argc == 0 && strcmp(cmd, "mtld-game_info") == 0) {
-            gtp_game_info(out_fp, idn);
-            continue;
-        }
+        char * line = session->queue[session->queue_start];
+        request_received_mark = current_time_in_millis();
 
-        if (argc == 0 && strcmp(cmd, "gomill-describe_engine") == 0) {
-            gtp_gomill_describe_engine(out_fp, idn);
-            continue;
+        genmoves_pending = 1;
+        if (command_in_list(line, genmove_commands)) {
+            for (u16 i = 1; i <= max_sessions; ++i) {
+                gtp_session * s = sessions[i];
+                if (s != NULL && s != session && s->queue_count > 0 &&
+                    command_in_list(s->queue[s->queue_start], genmove_commands)) {
+                    genmoves_pending++;
+                }
+            }
         }
 
-        if (argc == 0 && strcmp(cmd, "quit") == 0) {
-            gtp_quit(out_fp, idn);
-            continue;
-        }
+        session->queue_start = (session->queue_start + 1) % GTP_QUEUE_SIZ;
+        session->queue_count--;
+        pthread_cond_broadcast(&input_cond);
+        pthread_mutex_unlock(&input_lock);
 
-        if (argc == 0 && strcmp(cmd, "exit") == 0) {
-            gtp_quit(out_fp, idn);
+        if (session->quit) { /* discard the commands after quit */
+            release(line);
             continue;
         }
 
+        session_swap_in(session);
 
-        const char * best_dst_str = NULL;
-        u16 best_dst_val = 0;
-        bool command_exists = false;
-        u16 i = 0;
-
-        while (supported_commands[i] != NULL) {
-            if (strcmp(cmd, supported_commands[i]) == 0) {
-                command_exists = true;
-                break;
-            } else {
-                u16 lev_dst = levenshtein_dst(supported_commands[i], cmd);
-
-                if (best_dst_str == NULL || lev_dst < best_dst_val) {
-                    best_dst_str = supported_commands[i];
-                    best_dst_val = lev_dst;
-                }
-            }
-            ++i;
-        }
+        bool is_black = current_player_color(&current_game);
+        board current_state;
+        current_game_state(&current_state, &current_game);
+        opt_turn_maintenance(&current_state, is_black);
+        reset_mcts_can_resume();
 
-        if (command_exists) {
-            fprintf(stderr, "warning: command '%s' exists but the parameter list is wrong; please check the documentation\n", cmd);
-            gtp_error(out_fp, idn, "syntax error");
-        } else {
-            if (best_dst_val < 2) {
-                strcpy(cmd, best_dst_str);
-                goto lbl_parse_command;
-            }
+        gtp_execute(session->fp, line);
+        release(line);
 
-            if (best_dst_val < 4) {
-                fprintf(stderr, "warning: command '%s' does not exist; did you mean '%s'?\n", cmd, best_dst_str);
-            } else {
-                fprintf(stderr, "warning: command '%s' does not exist; run \"help\" for a list of available commands\n", cmd);
-            }
+        session_swap_out(session);
 
-            gtp_error(out_fp, idn, "unknown command");
+        if (session->quit) {
+            shutdown(session->fd, SHUT_RDWR);
         }
     }
 }
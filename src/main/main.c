@@ -22,10 +22,12 @@ Also deals with updating some internal parameters at startup time.
 #include "game_record.h"
 #include "mcts.h"
 #include "opening_book.h"
+#include "playout.h"
 #include "pts_file.h"
 #include "randg.h"
 #include "stringm.h"
 #include "time_ctrl.h"
+#include "time_manager.h"
 #include "timem.h"
 #include "transpositions.h"
 #include "version.h"
@@ -55,6 +57,7 @@ extern u16 prior_self_atari;
 extern u16 prior_attack;
 extern u16 prior_defend;
 extern u16 prior_pat3;
+extern u16 prior_pat5;
 extern u16 prior_near_last;
 extern u16 prior_line2;
 extern u16 prior_line3;
@@ -63,6 +66,7 @@ extern u16 prior_corner;
 extern u16 prior_bad_play;
 extern u16 prior_pass;
 extern u16 prior_starting_point;
+extern u16 prior_deferred_visits;
 extern double rave_equiv;
 extern u16 pl_skip_saving;
 extern u16 pl_skip_nakade;
@@ -70,6 +74,8 @@ extern u16 pl_skip_pattern;
 extern u16 pl_skip_capture;
 extern u16 pl_ban_self_atari;
 extern u16 expansion_delay;
+extern u16 playouts_per_leaf;
+extern u16 pipeline_descenders;
 static u16 _dummy; /* used for testing CLOP */
 
 
@@ -82,6 +88,7 @@ const void * tunable[] = {
     "i", "prior_attack", &prior_attack,
     "i", "prior_defend", &prior_defend,
     "i", "prior_pat3", &prior_pat3,
+    "i", "prior_pat5", &prior_pat5,
     "i", "prior_near_last", &prior_near_last,
     "i", "prior_line2", &prior_line2,
     "i", "prior_line3", &prior_line3,
@@ -90,6 +97,7 @@ const void * tunable[] = {
     "i", "prior_bad_play", &prior_bad_play,
     "i", "prior_pass", &prior_pass,
     "i", "prior_starting_point", &prior_starting_point,
+    "i", "prior_deferred_visits", &prior_deferred_visits,
     "f", "rave_equiv", &rave_equiv,
     "i", "pl_skip_saving", &pl_skip_saving,
     "i", "pl_skip_nakade", &pl_skip_nakade,
@@ -97,6 +105,8 @@ const void * tunable[] = {
     "i", "pl_skip_capture", &pl_skip_capture,
     "i", "pl_ban_self_atari", &pl_ban_self_atari,
     "i", "expansion_delay", &expansion_delay,
+    "i", "playouts_per_leaf", &playouts_per_leaf,
+    "i", "pipeline_descenders", &pipeline_descenders,
     "i", "dummy", &_dummy,
     NULL
 };
@@ -159,10 +169,20 @@ void main_gtp(
     bool think_in_opt_turn
 );
 
+void main_gtp_server(
+    u16 port,
+    u16 nr_sessions
+);
+
 void main_text(
     bool is_black
 );
 
+void main_batch(
+    u32 playouts,
+    u32 milliseconds
+);
+
 static void startup(
     bool opening_books_enabled,
     d16 desired_num_threads
@@ -206,6 +226,19 @@ static void usage() {
         fprintf(stderr, "        \033[1m-m, --mode <gtp or text>\033[0m\n\n");
         fprintf(stderr, "        Matilda attempts to detect if its input file descriptor is a terminal\n        and if it is it uses the text mode interface. Otherwise it uses the GTP\n        interface. This command overrides this with the specific mode you want\n        to be used.\n\n");
 
+        fprintf(stderr, "        \033[1m--server <port>\033[0m\n\n");
+        fprintf(stderr, "        Use GTP over TCP connections to the port, on the loopback interface,\n        instead of the standard input and output. Each connection is a separate\n        game; the games share the threads and memory of the program, and their\n        commands are executed in turn.\n\n");
+
+        fprintf(stderr, "        \033[1m--sessions <number>\033[0m\n\n");
+        fprintf(stderr, "        Maximum number of connections in server mode. Each game may use an\n        equal share of the transpositions table memory. The default is %u.\n\n",
+            DEFAULT_SERVER_SESSIONS);
+
+        fprintf(stderr, "        \033[1m--batch\033[0m\n\n");
+        fprintf(stderr, "        Evaluate the positions read from the standard input, one per line, as\n        SGF game records, SGF file paths or packed boards, writing the play\n        and value of each to the standard output. Independent positions are\n        evaluated at the same time, one per thread, without the opening books.\n        See main/batch.c for the formats.\n\n");
+
+        fprintf(stderr, "        \033[1m--batch_time <milliseconds>\033[0m\n\n");
+        fprintf(stderr, "        Time to evaluate each position in batch mode, instead of a number of\n        playouts. The default is %u.\n\n", DEFAULT_TIME_PER_TURN);
+
         fprintf(stderr, "        \033[1m-c, --color <black or white>\033[0m\n\n");
         fprintf(stderr, "        Select human player color (text mode only).\n\n");
 
@@ -250,6 +283,12 @@ static void usage() {
         fprintf(stderr, "        \033[1m--threads <number>\033[0m\n\n");
         fprintf(stderr, "        Override the number of OpenMP threads to use. The default is the total\n        number of normal plus hyperthreaded CPU cores.\n\n");
 
+        fprintf(stderr, "        \033[1m--playout_policy <name>\033[0m\n\n");
+        fprintf(stderr, "        Select the MCTS playout policy: light (uniformly random), heavy or\n        heavy_nakade (heavy with a nakade stage). Default: heavy\n\n");
+
+        fprintf(stderr, "        \033[1m--time_manager <name>\033[0m\n\n");
+        fprintf(stderr, "        Select when timed searches stop: fixed (at the time planned, or early\n        if the win rate is overwhelming) or stable (also stops when the best\n        play can no longer change, and extends the search while it is\n        unstable). Default: stable\n\n");
+
         fprintf(stderr, "        \033[1m--benchmark\033[0m\n\n");
         fprintf(stderr, "        Run a two minute benchmark of the system, returning a linear measure of\n        MCTS performance (number of simulations per second.\n\n");
 
@@ -291,6 +330,10 @@ int main(
     bool human_player_color = true;
     bool think_in_opt_turn = false;
     bool opening_books_enabled = true;
+    u16 server_port = 0;
+    u16 server_sessions = DEFAULT_SERVER_SESSIONS;
+    bool batch_mode = false;
+    u32 batch_time = 0;
     set_time_per_turn(&current_clock_black, DEFAULT_TIME_PER_TURN);
     set_time_per_turn(&current_clock_white, DEFAULT_TIME_PER_TURN);
     d16 desired_num_threads = DEFAULT_NUM_THREADS;
@@ -455,6 +498,30 @@ int main(
             ++i;
             continue;
         }
+
+        if (strcmp(argv[i], "--playout_policy") == 0 && i < argc - 1) {
+            args_understood += 2;
+
+            if (!playout_set_policy(argv[i + 1])) {
+                fprintf(stderr, "unknown playout policy %s\n", argv[i + 1]);
+                exit(EXIT_FAILURE);
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--time_manager") == 0 && i < argc - 1) {
+            args_understood += 2;
+
+            if (!time_manager_set(argv[i + 1])) {
+                fprintf(stderr, "unknown time manager %s\n", argv[i + 1]);
+                exit(EXIT_FAILURE);
+            }
+
+            ++i;
+            continue;
+        }
     }
 
     for (int i = 1; i < argc; ++i) {
@@ -530,6 +597,66 @@ int main(
             continue;
         }
 
+        if (strcmp(argv[i], "--server") == 0 && i < argc - 1) {
+            args_understood += 2;
+
+            d32 v;
+            if (!parse_int(&v, argv[i + 1]) || v < 1 || v > 65535) {
+                fprintf(stderr, "illegal server port\n");
+                exit(EXIT_FAILURE);
+            }
+
+            server_port = v;
+            use_gtp = true;
+
+            if (!flog_dest_set) {
+                flog_config_destinations(LOG_DEST_STDF | LOG_DEST_FILE);
+            }
+
+            pass_when_losing = true;
+            ++i;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--sessions") == 0 && i < argc - 1) {
+            args_understood += 2;
+
+            d32 v;
+            if (!parse_int(&v, argv[i + 1]) || v < 1 || v > MAX_SERVER_SESSIONS) {
+                fprintf(stderr, "invalid number of sessions\n");
+                exit(EXIT_FAILURE);
+            }
+
+            server_sessions = v;
+            ++i;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--batch") == 0) {
+            args_understood += 1;
+
+            batch_mode = true;
+            if (!flog_dest_set) {
+                flog_config_destinations(LOG_DEST_FILE);
+            }
+
+            continue;
+        }
+
+        if (strcmp(argv[i], "--batch_time") == 0 && i < argc - 1) {
+            args_understood += 2;
+
+            d32 v;
+            if (!parse_int(&v, argv[i + 1]) || v < 1) {
+                fprintf(stderr, "invalid batch evaluation time\n");
+                exit(EXIT_FAILURE);
+            }
+
+            batch_time = v;
+            ++i;
+            continue;
+        }
+
         if (strcmp(argv[i], "--save_all") == 0) {
             args_understood += 1;
 
@@ -661,11 +788,26 @@ int main(
         exit(EXIT_FAILURE);
     }
 
+    if (think_in_opt_turn && server_port > 0) {
+        fprintf(stderr, "--think_in_opt_time flag set in server mode\n");
+        exit(EXIT_FAILURE);
+    }
+
     if (use_gtp && color_set) {
         fprintf(stderr, "--color option set outside of text mode\n");
         exit(EXIT_FAILURE);
     }
 
+    if (batch_mode && (server_port > 0 || think_in_opt_turn || color_set)) {
+        fprintf(stderr, "--batch option set with options of other modes\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (batch_time > 0 && (!batch_mode || limit_by_playouts > 0)) {
+        fprintf(stderr, "--batch_time option set outside of batch mode or with --playouts\n");
+        exit(EXIT_FAILURE);
+    }
+
     if (time_related_set && limit_by_playouts > 0) {
         fprintf(stderr, "--playouts option set as well as time settings\n");
         exit(EXIT_FAILURE);
@@ -684,9 +826,17 @@ int main(
         flog_info("init", "MCTS using a constant number of simulations per turn");
     }
 
-    startup(opening_books_enabled, desired_num_threads);
+    startup(opening_books_enabled && !batch_mode, desired_num_threads);
+
+    if (batch_mode) {
+        if (limit_by_playouts == 0 && batch_time == 0) {
+            batch_time = DEFAULT_TIME_PER_TURN;
+        }
 
-    if (use_gtp) {
+        main_batch(limit_by_playouts, batch_time);
+    } else if (server_port > 0) {
+        main_gtp_server(server_port, server_sessions);
+    } else if (use_gtp) {
         main_gtp(think_in_opt_turn);
     } else {
         main_text(human_player_color);
@@ -101,21 +101,19 @@ static void text_genmove(
     current_game_state(&current_state, &current_game);
 
     u16 stones = stone_count(current_state.p);
-    u32 milliseconds;
-    if (is_black) {
-        milliseconds = calc_time_to_play(&current_clock_black, stones);
-    } else {
-        milliseconds = calc_time_to_play(&current_clock_white, stones);
-    }
+    time_system * curr_clock = is_black ? &current_clock_black : &current_clock_white;
+    u32 milliseconds = calc_time_to_play(curr_clock, stones);
+    u32 max_milliseconds = calc_max_time_to_play(curr_clock, stones);
 
     u64 curr_time = current_time_in_millis();
     u64 stop_time = curr_time + milliseconds;
     u64 early_stop_time = curr_time + (milliseconds / 4);
+    u64 max_stop_time = curr_time + max_milliseconds;
     bool has_play;
     if (limit_by_playouts > 0) {
         has_play = evaluate_position_sims(&current_state, is_black, &out_b,limit_by_playouts);
     } else {
-        has_play = evaluate_position_timed(&current_state, is_black, &out_b,stop_time, early_stop_time);
+        has_play = evaluate_position_timed(&current_state, is_black, &out_b, stop_time, early_stop_time, max_stop_time);
     }
 
     if (!has_play) {
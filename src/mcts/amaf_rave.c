@@ -53,38 +53,22 @@ double uct1_rave(
 
 /*
 Batch update of all transitions that were visited anytime after the current
-state (if visited first by the player).
+state (if visited first by the player), for one or more simulations.
+For each intersection is given the number of simulations where it was first
+visited by the player, and how many of those the player won.
 */
 void update_amaf_stats(
     tt_stats * stats,
-    const u8 traversed[static TOTAL_BOARD_SIZ],
-    bool is_black,
-    double z
+    const u16 visits[static TOTAL_BOARD_SIZ],
+    const u16 wins[static TOTAL_BOARD_SIZ]
 ) {
     for (u16 k = 0; k < stats->plays_count; ++k) {
-        if (stats->plays[k].m != PASS && traversed[stats->plays[k].m] != EMPTY && (traversed[stats->plays[k].m] == BLACK_STONE) == is_black) {
-            stats->plays[k].amaf_n++;
+        move m = stats->plays[k].m;
 
-            stats->plays[k].amaf_q += ((z - stats->plays[k].amaf_q) / stats->plays[k].amaf_n);
-        }
-    }
-}
-
-/*
-Batch update of all transitions that were visited anytime after the current
-state (if visited first by the player).
-This version only adds losses -- it is meant to be used when a draw occurs.
-*/
-void update_amaf_stats2(
-    tt_stats * stats,
-    const u8 traversed[static TOTAL_BOARD_SIZ],
-    bool is_black
-) {
-    for (u16 k = 0; k < stats->plays_count; ++k) {
-        if (stats->plays[k].m != PASS && traversed[stats->plays[k].m] != EMPTY && (traversed[stats->plays[k].m] == BLACK_STONE) == is_black) {
-            stats->plays[k].amaf_n++;
+        if (m != PASS && visits[m] > 0) {
+            stats->plays[k].amaf_n += visits[m];
 
-            stats->plays[k].amaf_q -= (stats->plays[k].amaf_q / stats->plays[k].amaf_n);
+            stats->plays[k].amaf_q += ((wins[m] - visits[m] * stats->plays[k].amaf_q) / stats->plays[k].amaf_n);
         }
     }
 }
@@ -1,16 +1,19 @@
 /*
-Heavy playout implementation with probability distribution selection and the use
-of a play status cache.
+Playout implementation with selectable move policies and the use of a play
+status cache.
 
-The move selection policy uses the following restrictions:
+The light policy plays uniformly at random, only avoiding filling its own eyes.
+
+The heavy policies select plays with a probability distribution. They use the
+following restrictions:
     1. No illegal plays
     2. No playing in own proper eyes
     3. No plays ending in self-atari except if forming a single stone group
     (throw-in)
 And chooses a play based on (by order of importance):
-    1. Nakade
-    2. Capture
-    3. Avoid capture
+    1. Avoid capture
+    2. Nakade (heavy_nakade policy only)
+    3. Capture
     4. Handcrafted 3x3 patterns
     5. Random play
 */
@@ -38,12 +41,82 @@ u16 pl_skip_pattern = PL_SKIP_PATTERN;
 u16 pl_skip_capture = PL_SKIP_CAPTURE;
 u16 pl_ban_self_atari = PL_BAN_SELF_ATARI;
 
-extern move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+extern u8 out_neighbors4[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+extern nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
+extern u8 nakade_shape[65536];
 
 /*
 For mercy Threshold
 */
-extern d16 komi;
+extern __thread d16 komi;
+
+/*
+Random decisions of a playout, generated in batches of 64 moves so no RNG work
+is left in the move selection besides reading a bit and a word.
+A set bit means the policy stage is skipped (or the self-atari banned).
+*/
+typedef struct __playout_rng_ {
+    u64 skip_saving;
+    u64 skip_capture;
+    u64 skip_pattern;
+    u64 skip_nakade;
+    u64 ban_self_atari;
+    u64 words[64];
+    u8 move_idx;
+    u8 ban_idx;
+} playout_rng;
+
+
+static void playout_rng_init(
+    playout_rng * rng
+) {
+    rng->move_idx = 64;
+    rng->ban_idx = 64;
+}
+
+/*
+Takes the random decisions for the next move.
+RETURNS the bit of the move in the skip masks
+*/
+static u64 playout_rng_next_move(
+    playout_rng * rng
+) {
+    if (rng->move_idx == 64) {
+        rng->skip_saving = rand_mask128(pl_skip_saving);
+        rng->skip_capture = rand_mask128(pl_skip_capture);
+        rng->skip_pattern = rand_mask128(pl_skip_pattern);
+        rng->skip_nakade = rand_mask128(pl_skip_nakade);
+        rand_fill(rng->words, 64);
+        rng->move_idx = 0;
+    }
+
+    return 1ULL << rng->move_idx++;
+}
+
+/*
+RETURNS pseudo random number in [0, max[ from the word of the current move
+*/
+static u16 playout_rng_choose(
+    const playout_rng * rng,
+    u16 max /* exclusive */
+) {
+    return ((rng->words[rng->move_idx - 1] >> 32) * max) >> 32;
+}
+
+/*
+RETURNS whether a self-atari is forbidden
+*/
+static bool playout_rng_ban_self_atari(
+    playout_rng * rng
+) {
+    if (rng->ban_idx == 64) {
+        rng->ban_self_atari = rand_mask128(pl_ban_self_atari);
+        rng->ban_idx = 0;
+    }
+
+    return (rng->ban_self_atari >> rng->ban_idx++) & 1;
+}
 
 static void invalidate_cache_of_the_past(
     const cfg_board * cb,
@@ -70,7 +143,8 @@ static void invalidate_cache_after_play(
     u8 c1[static TOTAL_BOARD_SIZ],
     u8 c2[static TOTAL_BOARD_SIZ],
     bool stones_captured[static TOTAL_BOARD_SIZ],
-    u8 libs_of_nei_of_captured[static LIB_BITMAP_SIZ]
+    u64 libs_of_nei_of_captured[static LIB_BITMAP_SIZ],
+    bool captures
 ) {
     assert(is_board_move(cb->last_played));
 
@@ -121,29 +195,37 @@ static void invalidate_cache_after_play(
     }
 
 
-    /* Dirty liberties and positions eaten */
-    for (m = 0; m < TOTAL_BOARD_SIZ; ++m) {
-        if (stones_captured[m]) {
+    /* Dirty liberties */
+    for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
+        u64 word = libs_of_nei_of_captured[i];
+
+        while (word) {
+            m = i * 64 + __builtin_ctzll(word);
             c1[m] = c2[m] = CACHE_PLAY_DIRTY;
-            continue;
+            word &= word - 1;
         }
+    }
 
-        u8 mask = (1 << (m % 8));
-        if (libs_of_nei_of_captured[m / 8] & mask) {
-            c1[m] = c2[m] = CACHE_PLAY_DIRTY;
+    /* Dirty positions eaten */
+    if (captures) {
+        for (m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+            if (stones_captured[m]) {
+                c1[m] = c2[m] = CACHE_PLAY_DIRTY;
+            }
         }
     }
 }
 
 
 /*
-Selects the next play of a heavy playout - MoGo style.
-Uses a cache of play statuses that is updated as needed.
+Updates the dirty entries of the cache of play statuses. Self-ataris are
+randomly forbidden if they don't put the opponent in atari.
 */
-static move heavy_select_play(
+static void update_cache(
     cfg_board * cb,
     bool is_black,
-    u8 cache[static TOTAL_BOARD_SIZ]
+    u8 cache[static TOTAL_BOARD_SIZ],
+    playout_rng * rng
 ) {
     move ko = get_ko_play(cb);
 
@@ -157,7 +239,7 @@ static move heavy_select_play(
                 (this definition covers throw-ins)
                 */
                 if (libs == 1 && ((is_black && cb->black_neighbors4[m] > 0) || (!is_black && cb->white_neighbors4[m] > 0))) {
-                    if (rand_u16(128) < pl_ban_self_atari) {
+                    if (playout_rng_ban_self_atari(rng)) {
                         cache[m] = 0;
                     } else {
                         cache[m] = CACHE_PLAY_LEGAL;
@@ -177,6 +259,102 @@ static move heavy_select_play(
             }
         }
     }
+}
+
+/*
+Cheaper legality test, without the number of liberties after playing: a play is
+legal if it is next to an empty intersection, a group of the player with more
+than one liberty or an opponent group that is captured. Does not test ko.
+RETURNS true if legal
+*/
+static bool is_legal_light(
+    const cfg_board * cb,
+    bool is_black,
+    move m
+) {
+    if (cb->white_neighbors4[m] + cb->black_neighbors4[m] + out_neighbors4[m] < 4) {
+        return true;
+    }
+
+    for (u8 k = 0; k < neighbors_side[m].count; ++k) {
+        const group * n = cb->g[neighbors_side[m].coord[k]];
+
+        if ((n->is_black == is_black) == (n->liberties > 1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+Updates the dirty entries of the cache of play statuses, only for legality.
+*/
+static void update_cache_light(
+    const cfg_board * cb,
+    bool is_black,
+    u8 cache[static TOTAL_BOARD_SIZ]
+) {
+    move ko = get_ko_play(cb);
+
+    for (u16 k = 0; k < cb->empty.count; ++k) {
+        move m = cb->empty.coord[k];
+
+        if (cache[m] & CACHE_PLAY_DIRTY) {
+            if (!is_eye(cb, is_black, m) && ko != m && is_legal_light(cb, is_black, m)) {
+                cache[m] = CACHE_PLAY_LEGAL;
+            } else {
+                cache[m] = 0;
+            }
+        }
+    }
+}
+
+/*
+Selects a legal play uniformly at random, or a pass if there are none.
+*/
+static move random_legal_play(
+    const cfg_board * cb,
+    const u8 cache[static TOTAL_BOARD_SIZ],
+    const playout_rng * rng
+) {
+    u16 candidate_plays = 0;
+    move candidate_play[TOTAL_BOARD_SIZ];
+
+    for (u16 k = 0; k < cb->empty.count; ++k) {
+        move m = cb->empty.coord[k];
+
+        if (cache[m] & CACHE_PLAY_LEGAL) {
+            candidate_play[candidate_plays] = m;
+            ++candidate_plays;
+        }
+    }
+
+    if (candidate_plays > 0) {
+        u16 p = playout_rng_choose(rng, candidate_plays);
+
+        return candidate_play[p];
+    }
+
+    /*
+        Pass
+    */
+    return PASS;
+}
+
+/*
+Selects the next play of a heavy playout - MoGo style.
+Uses a cache of play statuses that is updated as needed.
+*/
+static move heavy_select_play_stages(
+    cfg_board * cb,
+    bool is_black,
+    u8 cache[static TOTAL_BOARD_SIZ],
+    playout_rng * rng,
+    bool use_nakade
+) {
+    u64 bit = playout_rng_next_move(rng);
+    update_cache(cb, is_black, cache, rng);
 
     u16 candidate_plays = 0;
     /* x2 because the same liberties can appear repeated when adding neighbor
@@ -185,7 +363,7 @@ static move heavy_select_play(
     u16 weights[TOTAL_BOARD_SIZ * 2];
     u16 weight_total = 0;
 
-    if (rand_u16(128) >= pl_skip_saving && is_board_move(cb->last_played)) {
+    if (!(rng->skip_saving & bit) && is_board_move(cb->last_played)) {
         /*
         Avoid being captured after last play
         */
@@ -198,7 +376,7 @@ static move heavy_select_play(
                 move m = get_1st_liberty(g);
 
                 if (cache[m] & CACHE_PLAY_SAFE) {
-                    u16 w = g->stones.count + 2;
+                    u16 w = g->stones_count + 2;
                     weights[candidate_plays] = w;
                     candidate_play[candidate_plays] = m;
                     weight_total += w;
@@ -213,7 +391,7 @@ static move heavy_select_play(
                         m = get_1st_liberty(h);
 
                         if (cache[m] & CACHE_PLAY_LEGAL) {
-                            u16 w = h->stones.count + 2;
+                            u16 w = h->stones_count + 2;
 
                             if (cache[m] & CACHE_PLAY_SAFE) {
                                 w *= 2;
@@ -230,7 +408,7 @@ static move heavy_select_play(
         }
 
         if (candidate_plays > 0) {
-            d32 w = (d32)rand_u16(weight_total);
+            d32 w = (d32)playout_rng_choose(rng, weight_total);
 
             for (u16 i = 0; ; ++i) {
                 w -= weights[i];
@@ -243,15 +421,15 @@ static move heavy_select_play(
     }
 
 
-#if 0
     /*
     Nakade
     */
-    if (rand_u16(128) >= pl_skip_nakade) {
+    if (use_nakade && !(rng->skip_nakade & bit)) {
         for (u16 k = 0; k < cb->empty.count; ++k) {
             move m = cb->empty.coord[k];
 
-            if (cache[m] & CACHE_PLAY_SAFE) {
+            /* cheap pre-filter on the vital point shape */
+            if (nakade_shape[cb->hash[m]] != 0 && (cache[m] & CACHE_PLAY_SAFE)) {
                 u16 w;
                 if ((w = is_nakade(cb, m)) > 0) {
                     weights[candidate_plays] = w;
@@ -263,7 +441,7 @@ static move heavy_select_play(
         }
 
         if (candidate_plays > 0) {
-            d32 w = (d32)rand_u16(weight_total);
+            d32 w = (d32)playout_rng_choose(rng, weight_total);
 
             for (u16 i = 0; ; ++i) {
                 w -= weights[i];
@@ -274,12 +452,11 @@ static move heavy_select_play(
             }
         }
     }
-#endif
 
     /*
     Play a capturing move
     */
-    if (rand_u16(128) >= pl_skip_capture) {
+    if (!(rng->skip_capture & bit)) {
         for (u8 i = 0; i < cb->unique_groups_count; ++i) {
             group * g = cb->g[cb->unique_groups[i]];
 
@@ -287,7 +464,7 @@ static move heavy_select_play(
                 move m = get_1st_liberty(g);
 
                 if (cache[m] & CACHE_PLAY_LEGAL) {
-                    u16 w = g->stones.count;
+                    u16 w = g->stones_count;
                     weights[candidate_plays] = w;
                     candidate_play[candidate_plays] = m;
                     weight_total += w;
@@ -297,7 +474,7 @@ static move heavy_select_play(
         }
 
         if (candidate_plays > 0) {
-            d32 w = (d32)rand_u16(weight_total);
+            d32 w = (d32)playout_rng_choose(rng, weight_total);
 
             for (u16 i = 0; ; ++i) {
                 w -= weights[i];
@@ -310,7 +487,7 @@ static move heavy_select_play(
     }
 
 
-    if (rand_u16(128) >= pl_skip_pattern && is_board_move(cb->last_played)) {
+    if (!(rng->skip_pattern & bit) && is_board_move(cb->last_played)) {
         /*
         Match 3x3 patterns in 8 neighbor intersections
         */
@@ -330,7 +507,7 @@ static move heavy_select_play(
         }
 
         if (candidate_plays > 0) {
-            d32 w = (d32)rand_u16(weight_total);
+            d32 w = (d32)playout_rng_choose(rng, weight_total);
 
             for (u16 i = 0; ; ++i) {
                 w -= weights[i];
@@ -342,39 +519,231 @@ static move heavy_select_play(
         }
     }
 
-    /*
-    Play random legal play
-    */
+    return random_legal_play(cb, cache, rng);
+}
+
+/*
+Heavy playout policy: MoGo style stages of capturing, saving groups and 3x3
+patterns.
+*/
+static move heavy_select_play(
+    cfg_board * cb,
+    bool is_black,
+    u8 cache[static TOTAL_BOARD_SIZ],
+    playout_rng * rng
+) {
+    return heavy_select_play_stages(cb, is_black, cache, rng, false);
+}
+
+/*
+Heavy playout policy with an extra nakade stage.
+*/
+static move heavy_nakade_select_play(
+    cfg_board * cb,
+    bool is_black,
+    u8 cache[static TOTAL_BOARD_SIZ],
+    playout_rng * rng
+) {
+    return heavy_select_play_stages(cb, is_black, cache, rng, true);
+}
+
+/*
+Light playout policy: uniformly random legal plays that don't fill eyes.
+*/
+static move light_select_play(
+    cfg_board * cb,
+    bool is_black,
+    u8 cache[static TOTAL_BOARD_SIZ],
+    playout_rng * rng
+) {
+    playout_rng_next_move(rng);
+    update_cache_light(cb, is_black, cache);
+    return random_legal_play(cb, cache, rng);
+}
+
+
+/*
+Playout move selection policies, selectable at runtime.
+*/
+typedef struct __playout_policy_ {
+    const char * name;
+    move (* select_play)(cfg_board *, bool, u8 *, playout_rng *);
+} playout_policy;
+
+static const playout_policy policies[] = {
+    { "light", light_select_play },
+    { "heavy", heavy_select_play },
+    { "heavy_nakade", heavy_nakade_select_play },
+    { NULL, NULL }
+};
+
+static const playout_policy * policy = &policies[DEFAULT_PLAYOUT_POLICY];
+
+/*
+Selects the playout policy by name: light, heavy or heavy_nakade.
+RETURNS false if the name is not recognized
+*/
+bool playout_set_policy(
+    const char * name
+) {
+    for (u8 i = 0; policies[i].name != NULL; ++i) {
+        if (strcmp(policies[i].name, name) == 0) {
+            policy = &policies[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+RETURNS the name of the playout policy in use
+*/
+const char * playout_policy_name() {
+    return policy->name;
+}
+
+
+/*
+Tests whether the winner of the playout is already decided, by counting the area
+that can no longer change owner. Uses Benson's algorithm restricted to single
+point regions: the eyes enclosed by a single color, which are liberties of all
+the chains around them. Chains with two or more eyes whose surrounding chains
+are all still alive are pass-alive; their stones and eyes are settled. The other
+intersections are assumed to go to the player that is behind.
+RETURNS true if the winner is decided, with a bound of the final score in score
+*/
+static bool settled_result(
+    const cfg_board * cb,
+    d16 * score
+) {
+    /* chains around each eye, NULL terminated if less than 4 */
+    group * eye_chains[TOTAL_BOARD_SIZ][4];
+    u8 eye_chains_count[TOTAL_BOARD_SIZ];
+    bool eye_alive[TOTAL_BOARD_SIZ];
+    u8 chain_eyes[TOTAL_BOARD_SIZ];
+    bool chain_alive[TOTAL_BOARD_SIZ];
+    u16 eyes = 0;
+
     for (u16 k = 0; k < cb->empty.count; ++k) {
         move m = cb->empty.coord[k];
 
-        if (cache[m] & CACHE_PLAY_LEGAL) {
-            candidate_play[candidate_plays] = m;
-            ++candidate_plays;
+        if (cb->black_neighbors4[m] + out_neighbors4[m] != 4 && cb->white_neighbors4[m] + out_neighbors4[m] != 4) {
+            continue;
         }
+
+        u8 count = 0;
+
+        for (u8 i = 0; i < neighbors_side[m].count; ++i) {
+            group * g = cb->g[neighbors_side[m].coord[i]];
+            bool repeated = false;
+
+            for (u8 j = 0; j < count; ++j) {
+                if (eye_chains[eyes][j] == g) {
+                    repeated = true;
+                    break;
+                }
+            }
+
+            if (!repeated) {
+                eye_chains[eyes][count++] = g;
+            }
+        }
+
+        eye_chains_count[eyes] = count;
+        eye_alive[eyes] = true;
+        ++eyes;
     }
 
-    if (candidate_plays > 0) {
-        u16 p = rand_u16(candidate_plays);
+    if (eyes < 2) {
+        return false;
+    }
 
-        return candidate_play[p];
+    for (u8 i = 0; i < cb->unique_groups_count; ++i) {
+        chain_alive[cb->unique_groups[i]] = true;
     }
 
-    /*
-        Pass
-    */
-    return PASS;
-}
+    bool changed = true;
 
+    while (changed) {
+        changed = false;
+
+        for (u8 i = 0; i < cb->unique_groups_count; ++i) {
+            chain_eyes[cb->unique_groups[i]] = 0;
+        }
+
+        for (u16 k = 0; k < eyes; ++k) {
+            if (eye_alive[k]) {
+                for (u8 j = 0; j < eye_chains_count[k]; ++j) {
+                    chain_eyes[eye_chains[k][j]->first_stone]++;
+                }
+            }
+        }
+
+        for (u8 i = 0; i < cb->unique_groups_count; ++i) {
+            move id = cb->unique_groups[i];
+
+            if (chain_alive[id] && chain_eyes[id] < 2) {
+                chain_alive[id] = false;
+                changed = true;
+            }
+        }
+
+        for (u16 k = 0; k < eyes; ++k) {
+            if (!eye_alive[k]) {
+                continue;
+            }
+
+            for (u8 j = 0; j < eye_chains_count[k]; ++j) {
+                if (!chain_alive[eye_chains[k][j]->first_stone]) {
+                    eye_alive[k] = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    d16 settled[2] = {0, 0};
+
+    for (u16 k = 0; k < eyes; ++k) {
+        if (eye_alive[k]) {
+            settled[eye_chains[k][0]->is_black]++;
+        }
+    }
+
+    for (u8 i = 0; i < cb->unique_groups_count; ++i) {
+        group * g = cb->g[cb->unique_groups[i]];
+
+        if (chain_alive[g->first_stone]) {
+            settled[g->is_black] += g->stones_count;
+        }
+    }
+
+    d16 unsettled = TOTAL_BOARD_SIZ - settled[0] - settled[1];
+    /* stones are counted as 2 units in matilda */
+    d16 lead = (settled[1] - settled[0]) * 2 - komi;
+
+    if (lead > unsettled * 2) {
+        *score = lead - unsettled * 2;
+        return true;
+    }
+
+    if (lead < -unsettled * 2) {
+        *score = lead + unsettled * 2;
+        return true;
+    }
+
+    return false;
+}
 
 /*
-Make a heavy playout and returns whether black wins.
-Does not play in own proper eyes or self-ataris except for possible throw-ins.
-Avoids too many ko battles. Also uses mercy threshold.
+Make a playout with the selected policy and returns whether black wins.
+Does not play in own proper eyes. Avoids too many ko battles. Also uses mercy
+threshold, and stops as soon as the winner is decided by the settled area.
 Also updates AMAF transitions information.
 RETURNS the final score
 */
-d16 playout_heavy_amaf(
+d16 playout_amaf(
     cfg_board * cb,
     bool is_black,
     u8 traversed[static TOTAL_BOARD_SIZ]
@@ -389,10 +758,12 @@ d16 playout_heavy_amaf(
     memset(b_cache, CACHE_PLAY_DIRTY, TOTAL_BOARD_SIZ);
     memset(w_cache, CACHE_PLAY_DIRTY, TOTAL_BOARD_SIZ);
     bool stones_captured[TOTAL_BOARD_SIZ];
-    u8 libs_of_nei_of_captured[LIB_BITMAP_SIZ];
+    u64 libs_of_nei_of_captured[LIB_BITMAP_SIZ];
+    playout_rng rng;
+    playout_rng_init(&rng);
 
     while (--depth_max) {
-        move m = heavy_select_play(cb, is_black, is_black ? b_cache : w_cache);
+        move m = policy->select_play(cb, is_black, is_black ? b_cache : w_cache, &rng);
         assert(verify_cfg_board(cb));
 
         if (m == PASS) { /* only passes when there are no more plays */
@@ -409,9 +780,9 @@ d16 playout_heavy_amaf(
             invalidate_cache_of_the_past(cb, b_cache, w_cache);
 
             memset(stones_captured, 0, TOTAL_BOARD_SIZ);
-            memset(libs_of_nei_of_captured, 0, LIB_BITMAP_SIZ);
+            memset(libs_of_nei_of_captured, 0, LIB_BITMAP_SIZ * sizeof(u64));
 
-            just_play3(cb, is_black, m, &diff, stones_captured, libs_of_nei_of_captured);
+            move captures = just_play3(cb, is_black, m, &diff, stones_captured, libs_of_nei_of_captured);
 
             assert(verify_cfg_board(cb));
 
@@ -423,7 +794,15 @@ d16 playout_heavy_amaf(
                 return diff;
             }
 
-            invalidate_cache_after_play(cb, b_cache, w_cache, stones_captured, libs_of_nei_of_captured);
+            if (cb->empty.count < SETTLED_CHECK_EMPTY && (depth_max % SETTLED_CHECK_INTERVAL) == 0) {
+                d16 score;
+
+                if (settled_result(cb, &score)) {
+                    return score;
+                }
+            }
+
+            invalidate_cache_after_play(cb, b_cache, w_cache, stones_captured, libs_of_nei_of_captured, captures > 0);
             assert(verify_cfg_board(cb));
         }
 
@@ -446,9 +825,11 @@ void playout_as_strategy(
 
     u8 ignored_cache[TOTAL_BOARD_SIZ];
     memset(ignored_cache, CACHE_PLAY_DIRTY, TOTAL_BOARD_SIZ);
+    playout_rng rng;
+    playout_rng_init(&rng);
 
     /* only passes when there are no more plays */
-    move m = heavy_select_play(&cb, true, ignored_cache);
+    move m = policy->select_play(&cb, true, ignored_cache, &rng);
 
     clear_out_board(out_b);
 
@@ -0,0 +1,243 @@
+/*
+Search time managers, that decide during a timed MCTS when to stop it: before
+the time planned for the play if the result can no longer change, or after it
+if the search is still unstable.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "alloc.h"
+#include "amaf_rave.h"
+#include "flog.h"
+#include "mcts.h"
+#include "move.h"
+#include "stringm.h"
+#include "time_manager.h"
+#include "transpositions.h"
+#include "types.h"
+
+
+static bool fixed_should_stop(
+    search_time * st,
+    tt_stats * root,
+    u64 curr_time,
+    u32 wins,
+    u32 losses,
+    u32 simulations
+) {
+    (void)root;
+    (void)simulations;
+
+#if UCT_CAN_STOP_EARLY
+    if (curr_time >= st->early_stop_time && curr_time < st->stop_time) {
+        double wr = ((double)wins) / ((double)(wins + losses));
+
+        if (wr >= UCT_EARLY_WINRATE) {
+            st->reason = "win rate";
+            return true;
+        }
+    }
+#endif
+
+    if (curr_time >= st->stop_time) {
+        st->reason = "time";
+        return true;
+    }
+
+    return false;
+}
+
+static bool stable_should_stop(
+    search_time * st,
+    tt_stats * root,
+    u64 curr_time,
+    u32 wins,
+    u32 losses,
+    u32 simulations
+) {
+    if (curr_time < st->next_check && curr_time < st->stop_time) {
+        return fixed_should_stop(st, root, curr_time, wins, losses, simulations);
+    }
+
+    st->next_check = curr_time + TM_CHECK_INTERVAL;
+
+    /*
+    The best play is the one with the highest value, like in the final play
+    selection; the visit gap is measured between the two most visited plays.
+    */
+    move best = NONE;
+    double best_value = -1.0;
+    move most_visited = NONE;
+    u32 most_visits = 0;
+    u32 second_visits = 0;
+
+    omp_set_lock(&root->lock);
+    for (move k = 0; k < root->plays_count; ++k) {
+        const tt_play * play = &root->plays[k];
+        double value = uct1_rave(play);
+
+        if (value > best_value) {
+            best_value = value;
+            best = play->m;
+        }
+
+        if (play->mc_n > most_visits) {
+            second_visits = most_visits;
+            most_visits = play->mc_n;
+            most_visited = play->m;
+        } else if (play->mc_n > second_visits) {
+            second_visits = play->mc_n;
+        }
+    }
+    omp_unset_lock(&root->lock);
+
+    if (best != st->best) {
+        st->best = best;
+        st->best_changed_time = curr_time;
+    }
+
+    u64 planned = st->planned_stop_time - st->start_time;
+    u64 elapsed = curr_time - st->start_time;
+
+    /*
+    Stop if the most visited play cannot be overtaken in the time remaining
+    */
+    if (best == most_visited && curr_time < st->stop_time && elapsed > 0 &&
+        elapsed >= planned * TM_MIN_ELAPSED_FRACTION) {
+        double rate = ((double)simulations) / elapsed;
+        double remaining = rate * (st->stop_time - curr_time);
+
+        if (most_visits - second_visits > remaining) {
+            st->reason = "visit gap";
+            return true;
+        }
+    }
+
+    /*
+    Extend the search if the best play changed recently
+    */
+    if (curr_time >= st->stop_time && st->stop_time < st->max_stop_time &&
+        curr_time - st->best_changed_time < planned * TM_UNSTABLE_FRACTION) {
+        st->stop_time = MIN(st->stop_time + (u64)(planned * TM_EXTENSION_FRACTION), st->max_stop_time);
+        st->extensions++;
+    }
+
+    return fixed_should_stop(st, root, curr_time, wins, losses, simulations);
+}
+
+
+/*
+Time managers, selectable at runtime.
+*/
+typedef struct __time_manager_ {
+    const char * name;
+    bool (* should_stop)(search_time *, tt_stats *, u64, u32, u32, u32);
+} time_manager;
+
+static const time_manager managers[] = {
+    { "fixed", fixed_should_stop },
+    { "stable", stable_should_stop },
+    { NULL, NULL }
+};
+
+static const time_manager * manager = &managers[DEFAULT_TIME_MANAGER];
+
+/*
+Selects the time manager by name: fixed or stable.
+RETURNS false if the name is not recognized
+*/
+bool time_manager_set(
+    const char * name
+) {
+    for (u8 i = 0; managers[i].name != NULL; ++i) {
+        if (strcmp(managers[i].name, name) == 0) {
+            manager = &managers[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+RETURNS the name of the time manager in use
+*/
+const char * time_manager_name() {
+    return manager->name;
+}
+
+/*
+Initializes the time management of a new search.
+*/
+void time_manager_start(
+    search_time * st,
+    u64 start_time,
+    u64 stop_time,
+    u64 early_stop_time,
+    u64 max_stop_time
+) {
+    st->start_time = start_time;
+    st->early_stop_time = early_stop_time;
+    st->planned_stop_time = stop_time;
+    st->max_stop_time = MAX(stop_time, max_stop_time);
+    st->stop_time = stop_time;
+    st->next_check = start_time;
+    st->best_changed_time = start_time;
+    st->best = NONE;
+    st->extensions = 0;
+    st->reason = "interrupted";
+}
+
+/*
+Tests whether the search should stop. Should only be called by one thread. The
+root state lock is taken for a short time, at most every TM_CHECK_INTERVAL
+milliseconds.
+RETURNS true if the search should stop
+*/
+bool time_manager_should_stop(
+    search_time * st,
+    tt_stats * root,
+    u64 curr_time,
+    u32 wins,
+    u32 losses,
+    u32 simulations
+) {
+    return manager->should_stop(st, root, curr_time, wins, losses, simulations);
+}
+
+/*
+Logs the time saved or reinvested by the time manager in the search, compared
+with the time planned.
+*/
+void time_manager_log(
+    const search_time * st,
+    u64 end_time
+) {
+    if (st->planned_stop_time - st->start_time >= UINT32_MAX) {
+        return; /* infinite time */
+    }
+
+    char * s = alloc();
+    char * s2 = alloc();
+
+    if (end_time < st->planned_stop_time) {
+        format_nr_millis(s2, st->planned_stop_time - end_time);
+        snprintf(s, MAX_PAGE_SIZ, "time manager %s: stopped by %s, %s saved\n",
+            manager->name, st->reason, s2);
+    } else if (st->extensions > 0) {
+        format_nr_millis(s2, end_time - st->planned_stop_time);
+        snprintf(s, MAX_PAGE_SIZ, "time manager %s: stopped by %s, %s reinvested "
+            "in %u extensions\n", manager->name, st->reason, s2, st->extensions);
+    } else {
+        snprintf(s, MAX_PAGE_SIZ, "time manager %s: stopped by %s, as planned\n",
+            manager->name, st->reason);
+    }
+
+    flog_info("uct", s);
+    release(s2);
+    release(s);
+}
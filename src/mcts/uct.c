@@ -10,6 +10,9 @@ Last-good-reply with forgetting (LGRF1) is also used.
 A virtual loss is also added on play traversion, that is later corrected if
 needed.
 
+Optionally the search can be pipelined: descender threads queue the leaves
+reached to be played out by the other threads, and apply the results queued back.
+
 MCTS can be resumed on demand by a few extra simulations at a time.
 It can also record the average final score, for the purpose of score estimation.
 */
@@ -21,6 +24,7 @@ It can also record the average final score, for the purpose of score estimation.
 #include <math.h> /* for round, sqrt */
 #include <stdlib.h>
 #include <assert.h>
+#include <sched.h> /* for sched_yield */
 #include <omp.h>
 
 #include "alloc.h"
@@ -32,31 +36,148 @@ It can also record the average final score, for the purpose of score estimation.
 #include "mcts.h"
 #include "move.h"
 #include "pat3.h"
+#include "pat5.h"
 #include "playout.h"
 #include "priors.h"
 #include "pts_file.h"
 #include "randg.h"
+#include "ring_queue.h"
 #include "scoring.h"
 #include "state_changes.h"
 #include "stringm.h"
+#include "tactical.h"
+#include "time_manager.h"
 #include "timem.h"
 #include "transpositions.h"
 #include "types.h"
 #include "zobrist.h"
 
 /* from board_constants */
+extern __thread d16 komi;
 extern u8 distances_to_border[TOTAL_BOARD_SIZ];
-extern move_seq nei_dst_3[TOTAL_BOARD_SIZ];
+extern nei_seq24 nei_dst_3[TOTAL_BOARD_SIZ];
+
+
+
+/*
+Number of playouts performed from each leaf reached, amortizing the tree descent
+over several simulations.
+*/
+u16 playouts_per_leaf = UCT_PLAYOUTS_PER_LEAF;
+
+/*
+Aggregated results of the playouts started from a leaf. Indexes of two are by
+color: 0 for white and 1 for black.
+*/
+typedef struct __leaf_outcome_ {
+    u16 playouts;
+    u16 wins[2];
+    /* playouts where the intersection was first visited by the color */
+    u16 amaf_n[2][TOTAL_BOARD_SIZ];
+    /* ... and that the color won */
+    u16 amaf_wins[2][TOTAL_BOARD_SIZ];
+    /* decisive playouts ending with a stone of the color on the intersection */
+    u16 owned[2][TOTAL_BOARD_SIZ];
+    /* decisive playouts ending with a stone of the winner on the intersection */
+    u16 winner_owns[TOTAL_BOARD_SIZ];
+} leaf_outcome;
+
+/*
+Path taken by a tree descent, to be used when backing up the leaf results.
+*/
+typedef struct __leaf_path_ {
+    d16 depth;
+    bool is_black; /* player at the leaf */
+    u16 playouts;
+    tt_stats * stats[MAX_UCT_DEPTH + 6];
+    tt_play * plays[MAX_UCT_DEPTH + 7];
+} leaf_path;
+
+/*
+Number of threads that descend the tree in pipelined search mode; the remaining
+threads only run playouts. Use 0 to disable the pipelined mode.
+*/
+u16 pipeline_descenders = UCT_PIPELINE_DESCENDERS;
+
+/*
+Leaf in the pipeline, from the descent until its results are backed up.
+*/
+typedef struct __leaf_job_ {
+    cfg_board cb;
+    leaf_path path;
+    leaf_outcome lo;
+} leaf_job;
+
+#define PIPELINE_JOBS (4 * MAXIMUM_NUM_THREADS)
 
-static bool ran_out_of_memory;
-static bool search_stop;
-static u16 max_depths[MAXIMUM_NUM_THREADS];
+/*
+State of the searches of an engine. Each thread uses the state selected with
+mcts_select_state, or a default state shared by the process.
+*/
+struct __mcts_state_ {
+    bool ran_out_of_memory;
+    bool search_stop;
+    volatile bool search_interrupted;
+    u16 max_depths[MAXIMUM_NUM_THREADS];
+
+    /* cost of the states expansions of the last search, per thread */
+    u32 expansions[MAXIMUM_NUM_THREADS];
+    u32 deferred_expansions[MAXIMUM_NUM_THREADS];
+    double expansion_time[MAXIMUM_NUM_THREADS]; /* in seconds */
+
+    /* tactical reading cache use of the last search, summed over its threads */
+    u64 tact_cache_hits;
+    u64 tact_cache_misses;
+
+    leaf_job * pipeline_jobs;
+    ring_queue * free_jobs;
+    ring_queue * pending_jobs;
+    ring_queue * finished_jobs;
+    u32 jobs_in_flight;
+
+    /* queue depth metrics, sampled when a leaf is queued */
+    u64 pipeline_samples;
+    u64 pending_depth_sum;
+    u64 finished_depth_sum;
+    u32 pending_depth_max;
+    u32 finished_depth_max;
+    u32 pipeline_helped;
+
+    /* whether a MCTS can be started on background; is disabled if memory runs
+    out, and needs to be reset before testing again if can be run */
+    bool mcts_can_resume;
+};
+
+static mcts_state default_state = { .mcts_can_resume = true };
+static __thread mcts_state * ms = &default_state;
 
 /*
-Whether a MCTS can be started on background. Is disabled if memory runs out, and
-needs to be reset before testing again if can be run.
+Engine of the thread starting a search, that all the threads of its parallel
+regions must use as well.
 */
-static bool mcts_can_resume = true;
+typedef struct __search_env_ {
+    mcts_state * ms;
+    tt_table * tt;
+    d16 komi;
+} search_env;
+
+static void search_env_get(
+    search_env * env
+) {
+    env->ms = ms;
+    env->tt = tt_selected();
+    env->komi = komi;
+}
+
+static void search_env_set(
+    const search_env * env
+) {
+    ms = env->ms;
+    tt_select(env->tt);
+    komi = env->komi;
+}
+
+
 
 
 
@@ -73,13 +194,145 @@ void mcts_init() {
     board_constants_init();
     zobrist_init();
     pat3_init();
+    pat5_init();
+    tactical_cache_init();
     tt_init();
     load_starting_points();
 
     uct_inited = true;
 }
 
+/*
+Creates a new search state, for an engine independent from the default one.
+RETURNS the new state
+*/
+mcts_state * mcts_state_create() {
+    mcts_state * s = calloc(1, sizeof(mcts_state));
+    if (s == NULL) {
+        flog_crit("uct", "system out of memory");
+    }
+
+    s->mcts_can_resume = true;
+    return s;
+}
+
+/*
+Frees a search state that is not in use by any thread.
+*/
+void mcts_state_destroy(
+    mcts_state * s
+) {
+    if (s->pipeline_jobs != NULL) {
+        ring_queue_destroy(s->free_jobs);
+        ring_queue_destroy(s->pending_jobs);
+        ring_queue_destroy(s->finished_jobs);
+        free(s->pipeline_jobs);
+    }
+
+    free(s);
+}
+
+/*
+Selects the search state used by the calling thread, and by the threads of the
+searches it starts. NULL selects the default state.
+RETURNS the state previously selected, or NULL if it was the default one
+*/
+mcts_state * mcts_select_state(
+    mcts_state * s
+) {
+    mcts_state * prev = (ms == &default_state) ? NULL : ms;
+    ms = (s == NULL) ? &default_state : s;
+    return prev;
+}
+
+
+
+static void reset_tactical_cache_stats() {
+    ms->tact_cache_hits = 0;
+    ms->tact_cache_misses = 0;
+}
+
+/*
+Adds the tactical reading cache counters of the calling thread to the search.
+To be called by every thread at the end of the parallel region of the search,
+having reset its counters at the start.
+*/
+static void add_tactical_cache_stats() {
+    u64 hits;
+    u64 misses;
+    tactical_cache_stats(&hits, &misses);
+    __atomic_add_fetch(&ms->tact_cache_hits, hits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ms->tact_cache_misses, misses, __ATOMIC_RELAXED);
+}
+
+/*
+Logs the tactical reading cache hit rate of the last search.
+*/
+static void log_tactical_cache_stats() {
+    u64 hits = ms->tact_cache_hits;
+    u64 misses = ms->tact_cache_misses;
+
+    if (hits + misses == 0) {
+        return;
+    }
+
+    char * s = alloc();
+    snprintf(s, MAX_PAGE_SIZ, "tactical cache hits=%" PRIu64 " misses=%" PRIu64
+        " (%.1f%%)\n", hits, misses, (100.0 * hits) / (hits + misses));
+    flog_info("uct", s);
+    release(s);
+}
+
+static void reset_expansion_stats() {
+    memset(ms->expansions, 0, sizeof(u32) * MAXIMUM_NUM_THREADS);
+    memset(ms->deferred_expansions, 0, sizeof(u32) * MAXIMUM_NUM_THREADS);
+    memset(ms->expansion_time, 0, sizeof(double) * MAXIMUM_NUM_THREADS);
+}
 
+/*
+Logs the number and time spent in states expansions of the last search,
+including the deferred tactical priors.
+*/
+static void log_expansion_stats(
+    u32 simulations
+) {
+    if (simulations == 0) {
+        return;
+    }
+
+    u32 total = 0;
+    u32 deferred = 0;
+    double time = 0.0;
+    for (u16 k = 0; k < MAXIMUM_NUM_THREADS; ++k) {
+        total += ms->expansions[k];
+        deferred += ms->deferred_expansions[k];
+        time += ms->expansion_time[k];
+    }
+
+    char * s = alloc();
+    snprintf(s, MAX_PAGE_SIZ, "expansions=%u deferred=%u time=%.1fms (%.2fus/sim)"
+        "\n", total, deferred, time * 1000.0, (time * 1000000.0) / simulations);
+    flog_info("uct", s);
+    release(s);
+}
+
+/*
+Fully initializes the root state, including the deferred priors, if needed.
+*/
+static void expand_root(
+    tt_stats * stats,
+    cfg_board * cb,
+    bool is_black
+) {
+    if (stats->expansion_delay != -1) {
+        stats->expansion_delay = -1;
+        init_new_state(stats, cb, is_black);
+    }
+
+    if (stats->deferred_priors != -1) {
+        init_deferred_priors(stats, cb, is_black);
+    }
+}
 
 static void select_play(
     tt_stats * stats,
@@ -126,45 +379,156 @@ static void select_play(
     flog_crit("mcts", "play selection exception");
 }
 
-static d16 mcts_expansion(
+/*
+Adds the result of a simulation to the leaf outcome. The final board is used for
+the criticality estimate and only counted for decisive results.
+*/
+static void leaf_outcome_add(
+    leaf_outcome * lo,
+    const u8 p[static TOTAL_BOARD_SIZ],
+    const u8 traversed[static TOTAL_BOARD_SIZ],
+    d16 outcome
+) {
+    lo->playouts++;
+
+    if (outcome == 0) {
+        for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+            if (traversed[m] != EMPTY) {
+                lo->amaf_n[traversed[m] == BLACK_STONE][m]++;
+            }
+        }
+        return;
+    }
+
+    bool black_won = outcome > 0;
+    lo->wins[black_won]++;
+
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        if (traversed[m] != EMPTY) {
+            bool c = (traversed[m] == BLACK_STONE);
+            lo->amaf_n[c][m]++;
+            lo->amaf_wins[c][m] += (c == black_won);
+        }
+
+        if (p[m] != EMPTY) {
+            bool c = (p[m] == BLACK_STONE);
+            lo->owned[c][m]++;
+            lo->winner_owns[m] += (c == black_won);
+        }
+    }
+}
+
+/*
+Adds the same result for all the simulations of the leaf, for when the outcome
+is known without playing out.
+*/
+static void leaf_outcome_add_fixed(
+    leaf_outcome * lo,
+    const cfg_board * cb,
+    d16 outcome,
+    u16 playouts
+) {
+    u8 traversed[TOTAL_BOARD_SIZ];
+    memset(traversed, EMPTY, TOTAL_BOARD_SIZ);
+
+    for (u16 i = 0; i < playouts; ++i) {
+        leaf_outcome_add(lo, cb->p, traversed, outcome);
+    }
+}
+
+/*
+Runs playouts from the leaf, each from its own copy of the board. The last one
+is played on the board itself.
+*/
+static void leaf_playouts(
     cfg_board * cb,
     bool is_black,
-    tt_stats * stats,
-    u8 traversed[static TOTAL_BOARD_SIZ]
+    leaf_outcome * lo,
+    u16 playouts
+) {
+    u8 traversed[TOTAL_BOARD_SIZ];
+
+    for (u16 i = 1; i < playouts; ++i) {
+        cfg_board tmp;
+        cfg_board_clone(&tmp, cb);
+        memset(traversed, EMPTY, TOTAL_BOARD_SIZ);
+        d16 outcome = playout_amaf(&tmp, is_black, traversed);
+        leaf_outcome_add(lo, tmp.p, traversed, outcome);
+        cfg_board_free(&tmp);
+    }
+
+    memset(traversed, EMPTY, TOTAL_BOARD_SIZ);
+    d16 outcome = playout_amaf(cb, is_black, traversed);
+    leaf_outcome_add(lo, cb->p, traversed, outcome);
+}
+
+static void mcts_expansion(
+    cfg_board * cb,
+    bool is_black,
+    tt_stats * stats
 ) {
     stats->expansion_delay--;
 
     if (stats->expansion_delay == -1) {
+        double start = omp_get_wtime();
         init_new_state(stats, cb, is_black);
+        ms->expansion_time[omp_get_thread_num()] += omp_get_wtime() - start;
+        ms->expansions[omp_get_thread_num()]++;
     }
 
     omp_unset_lock(&stats->lock);
-    d16 outcome = playout_heavy_amaf(cb, is_black, traversed);
+}
 
-    return outcome;
+/*
+Counts a visit to an expanded state, adding the tactical priors once enough
+visits have been made. Does not unset the lock.
+*/
+static void mcts_deferred_expansion(
+    cfg_board * cb,
+    bool is_black,
+    tt_stats * stats
+) {
+    stats->deferred_priors--;
+
+    if (stats->deferred_priors == -1) {
+        double start = omp_get_wtime();
+        init_deferred_priors(stats, cb, is_black);
+        ms->expansion_time[omp_get_thread_num()] += omp_get_wtime() - start;
+        ms->deferred_expansions[omp_get_thread_num()]++;
+    }
 }
 
-static d16 mcts_selection(
+/*
+Descends the tree from the given state until a leaf is reached, recording the
+path taken. A virtual loss for all the playouts of the leaf is added on each
+play traversed.
+If the outcome of the leaf is already known (superko, end of game, excessive
+depth) it is added to the leaf outcome.
+RETURNS true if the leaf still needs to be evaluated with playouts
+*/
+static bool mcts_descend(
     cfg_board * cb,
     u64 zobrist_hash,
-    bool is_black
+    bool is_black,
+    leaf_path * path,
+    leaf_outcome * lo
 ) {
+    u16 playouts = MAX(1, MIN(playouts_per_leaf, UCT_MAX_PLAYOUTS_PER_LEAF));
     d16 depth = 6;
-    tt_stats * stats[MAX_UCT_DEPTH + 6];
-    tt_play * plays[MAX_UCT_DEPTH + 7];
+    tt_stats ** stats = path->stats;
+    tt_play ** plays = path->plays;
     /* for testing superko */
     stats[0] = stats[1] = stats[2] = stats[3] = stats[4] = stats[5] = NULL;
 
-    u8 traversed[TOTAL_BOARD_SIZ];
-    memset(traversed, EMPTY, TOTAL_BOARD_SIZ);
+    memset(lo, 0, sizeof(leaf_outcome));
 
-    d16 outcome;
     tt_stats * curr_stats = NULL;
     tt_play * play = NULL;
+    bool needs_playouts = false;
 
     while (1) {
         if (depth >= MAX_UCT_DEPTH + 6) {
-            outcome = score_stones_and_area(cb->p);
+            leaf_outcome_add_fixed(lo, cb, score_stones_and_area(cb->p), playouts);
             break;
         }
 
@@ -172,12 +536,12 @@ static d16 mcts_selection(
             curr_stats = tt_lookup_null(cb, is_black, zobrist_hash);
 
             if (curr_stats == NULL) {
-                if (!ran_out_of_memory) {
-                    ran_out_of_memory = true;
-                    search_stop = true;
+                if (!ms->ran_out_of_memory) {
+                    ms->ran_out_of_memory = true;
+                    ms->search_stop = true;
                 }
 
-                outcome = playout_heavy_amaf(cb, is_black, traversed);
+                needs_playouts = true;
                 break;
             } else if (play != NULL) {
                 play->next_stats = curr_stats;
@@ -194,25 +558,31 @@ static d16 mcts_selection(
                                                stats[depth - 6] == curr_stats)) {
             omp_unset_lock(&curr_stats->lock);
             /* loss for player that committed superko */
-            outcome = is_black ? 1 : -1;
+            leaf_outcome_add_fixed(lo, cb, is_black ? 1 : -1, playouts);
             break;
         }
 
         if (curr_stats->expansion_delay >= 0) {
             /* already unsets lock */
-            outcome = mcts_expansion(cb, is_black, curr_stats, traversed);
+            mcts_expansion(cb, is_black, curr_stats);
+            needs_playouts = true;
             break;
         }
 
+        if (curr_stats->deferred_priors >= 0) {
+            mcts_deferred_expansion(cb, is_black, curr_stats);
+        }
+
         select_play(curr_stats, &play);
 
-        play->mc_n++;
-        play->mc_q -= play->mc_q / play->mc_n;
+        /* virtual loss for all the playouts of the leaf */
+        play->mc_n += playouts;
+        play->mc_q -= (play->mc_q * playouts) / play->mc_n;
         omp_unset_lock(&curr_stats->lock);
 
         if (play->m == PASS) {
             if (cb->last_played == PASS) {
-                outcome = score_stones_and_area(cb->p);
+                leaf_outcome_add_fixed(lo, cb, score_stones_and_area(cb->p), playouts);
                 break;
             }
 
@@ -228,75 +598,307 @@ static d16 mcts_selection(
         is_black = !is_black;
     }
 
-    if (outcome == 0) {
-        for (d16 k = depth - 1; k >= 6; --k) {
-            is_black = !is_black;
-            move m = plays[k]->m;
-            omp_set_lock(&stats[k]->lock);
+    plays[depth] = NULL;
+    path->depth = depth;
+    path->is_black = is_black;
+    path->playouts = playouts;
+
+    if (depth > ms->max_depths[omp_get_thread_num()]) {
+        ms->max_depths[omp_get_thread_num()] = depth;
+    }
+
+    return needs_playouts;
+}
 
-            /* LGRF */
+/*
+Backs up the aggregated results of the leaf playouts along the path descended,
+correcting the virtual loss.
+*/
+static void mcts_backup(
+    const leaf_path * path,
+    leaf_outcome * lo
+) {
+    tt_stats * const * stats = path->stats;
+    tt_play * const * plays = path->plays;
+    bool is_black = path->is_black;
+
+    for (d16 k = path->depth - 1; k >= 6; --k) {
+        is_black = !is_black;
+        move m = plays[k]->m;
+        u16 player_wins = lo->wins[is_black];
+        u16 opponent_wins = lo->wins[!is_black];
+
+        omp_set_lock(&stats[k]->lock);
+        /* MC sampling */
+        if (player_wins > 0) {
+            plays[k]->mc_q += ((double)player_wins) / plays[k]->mc_n;
+        }
+
+        /* AMAF/RAVE */
+        if (m != PASS) {
+            lo->amaf_n[is_black][m] = lo->playouts;
+            lo->amaf_wins[is_black][m] = player_wins;
+            lo->amaf_n[!is_black][m] = 0;
+            lo->amaf_wins[!is_black][m] = 0;
+        }
+        update_amaf_stats(stats[k], lo->amaf_n[is_black], lo->amaf_wins[is_black]);
+
+        /* LGRF */
+        if (opponent_wins * 2 > lo->playouts) {
+            plays[k]->lgrf1_reply = plays[k + 1];
+        } else {
             plays[k]->lgrf1_reply = NULL;
+        }
+
+        /* Criticality */
+        if (m != PASS) {
+            u16 owned = lo->owned[0][m] + lo->owned[1][m];
 
-            /* AMAF/RAVE */
-            if (m != PASS) {
-                traversed[m] = is_black ? BLACK_STONE : WHITE_STONE;
+            if (owned > 0) {
+                plays[k]->owner_winning += (lo->winner_owns[m] - owned * plays[k]->owner_winning) / plays[k]->mc_n;
+                plays[k]->color_owning += (lo->owned[is_black][m] - owned * plays[k]->color_owning) / plays[k]->mc_n;
             }
-            update_amaf_stats2(stats[k], traversed, is_black);
-            omp_unset_lock(&stats[k]->lock);
         }
-    } else {
-        plays[depth] = NULL;
 
-        for (d16 k = depth - 1; k >= 6; --k) {
-            is_black = !is_black;
-            move m = plays[k]->m;
-            double z = (is_black == (outcome > 0)) ? 1.0 : 0.0;
+        omp_unset_lock(&stats[k]->lock);
+    }
+}
 
-            omp_set_lock(&stats[k]->lock);
-            /* MC sampling */
-            if (is_black == (outcome > 0)) {
-                plays[k]->mc_q += 1.0 / plays[k]->mc_n;
-            }
+/*
+Descends the tree from the given state, evaluates the leaf reached with one or
+more playouts (see playouts_per_leaf) and backs up their aggregated results.
+*/
+static void mcts_selection(
+    cfg_board * cb,
+    u64 zobrist_hash,
+    bool is_black,
+    leaf_outcome * lo
+) {
+    leaf_path path;
 
-            /* AMAF/RAVE */
-            if (m != PASS) {
-                traversed[m] = is_black ? BLACK_STONE : WHITE_STONE;
-            }
-            update_amaf_stats(stats[k], traversed, is_black, z);
+    if (mcts_descend(cb, zobrist_hash, is_black, &path, lo)) {
+        leaf_playouts(cb, path.is_black, lo, path.playouts);
+    }
 
-            /* LGRF */
-            if (is_black == (outcome > 0)) {
-                plays[k]->lgrf1_reply = NULL;
-            } else {
-                plays[k]->lgrf1_reply = plays[k + 1];
-            }
+    mcts_backup(&path, lo);
+}
 
-            /* Criticality */
-            if (m != PASS && cb->p[m] != EMPTY) {
-                double winner_owns_coord = ((outcome > 0) == (cb->p[m] == BLACK_STONE)) ? 1.0 : 0.0;
-                plays[k]->owner_winning += (winner_owns_coord - plays[k]->owner_winning) / plays[k]->mc_n;
+static void pipeline_init() {
+    if (ms->pipeline_jobs != NULL) {
+        return;
+    }
 
-                double player_owns_coord = (is_black == (cb->p[m] == BLACK_STONE)) ? 1.0 : 0.0;
-                plays[k]->color_owning += (player_owns_coord - plays[k]->color_owning) / plays[k]->mc_n;
-            }
+    ms->pipeline_jobs = malloc(PIPELINE_JOBS * sizeof(leaf_job));
+    if (ms->pipeline_jobs == NULL) {
+        flog_crit("uct", "could not allocate pipeline memory");
+    }
 
-            omp_unset_lock(&stats[k]->lock);
-        }
+    ms->free_jobs = ring_queue_create(PIPELINE_JOBS);
+    ms->pending_jobs = ring_queue_create(PIPELINE_JOBS);
+    ms->finished_jobs = ring_queue_create(PIPELINE_JOBS);
+
+    for (u32 i = 0; i < PIPELINE_JOBS; ++i) {
+        ring_queue_push(ms->free_jobs, i);
     }
+}
+
+/*
+Whether the pipelined search mode is to be used with the current threads.
+*/
+static bool use_pipeline() {
+    return pipeline_descenders > 0 && omp_get_max_threads() > 1;
+}
+
+static void pipeline_sample_depths() {
+    u32 pending = ring_queue_size(ms->pending_jobs);
+    u32 finished = ring_queue_size(ms->finished_jobs);
+
+    #pragma omp critical(pipeline_metrics)
+    {
+        ms->pipeline_samples++;
+        ms->pending_depth_sum += pending;
+        ms->finished_depth_sum += finished;
+        ms->pending_depth_max = MAX(ms->pending_depth_max, pending);
+        ms->finished_depth_max = MAX(ms->finished_depth_max, finished);
+    }
+}
+
+/*
+Logs the queue depths of the last pipelined search.
+*/
+static void log_pipeline_stats(
+    u16 descenders,
+    u16 workers
+) {
+    if (ms->pipeline_samples == 0) {
+        return;
+    }
+
+    char * s = alloc();
+    snprintf(s, MAX_PAGE_SIZ, "pipeline descenders=%u workers=%u leaves=%" PRIu64
+        " pending depth avg=%.1f max=%u finished depth avg=%.1f max=%u helped=%u\n",
+        descenders, workers, ms->pipeline_samples, ((double)ms->pending_depth_sum) /
+        ms->pipeline_samples, ms->pending_depth_max, ((double)ms->finished_depth_sum) /
+        ms->pipeline_samples, ms->finished_depth_max, ms->pipeline_helped);
+    flog_info("uct", s);
+    release(s);
+}
+
+/*
+Backup stage: applies the results of a leaf, counts them and releases the job.
+*/
+static void pipeline_backup(
+    u32 idx,
+    bool is_black,
+    u32 * wins,
+    u32 * losses,
+    u32 * draws
+) {
+    leaf_job * job = &ms->pipeline_jobs[idx];
+    mcts_backup(&job->path, &job->lo);
+    cfg_board_free(&job->cb);
+
+    #pragma omp atomic
+    *draws += job->lo.playouts - job->lo.wins[0] - job->lo.wins[1];
+    #pragma omp atomic
+    *wins += job->lo.wins[is_black];
+    #pragma omp atomic
+    *losses += job->lo.wins[!is_black];
+
+    ring_queue_push(ms->free_jobs, idx);
+    __atomic_sub_fetch(&ms->jobs_in_flight, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+Playout stage.
+*/
+static void pipeline_playouts(
+    u32 idx
+) {
+    leaf_job * job = &ms->pipeline_jobs[idx];
+    leaf_playouts(&job->cb, job->path.is_black, &job->lo, job->path.playouts);
+    ring_queue_push(ms->finished_jobs, idx);
+}
+
+/*
+Pipelined search: the descender threads walk the tree and queue the leaves
+reached, from where the other threads take them to run the playouts. The
+results are queued back to be applied by the descenders. Virtual losses keep the
+concurrent descents diverse. Descenders help with the playouts when all the
+jobs are in use.
+*/
+static void mcts_pipelined_search(
+    const cfg_board * initial_cfg_board,
+    u64 start_zobrist_hash,
+    bool is_black,
+    u32 max_leaves,
+    tt_stats * root,
+    search_time * st,
+    u32 * wins,
+    u32 * losses,
+    u32 * draws
+) {
+    pipeline_init();
+
+    u32 leaves_started = 0;
+    ms->jobs_in_flight = 0;
+    ms->pipeline_samples = 0;
+    ms->pending_depth_sum = 0;
+    ms->finished_depth_sum = 0;
+    ms->pending_depth_max = 0;
+    ms->finished_depth_max = 0;
+    ms->pipeline_helped = 0;
+
+    u16 threads = omp_get_max_threads();
+    u16 descenders = MIN(pipeline_descenders, threads - 1);
+
+    search_env env;
+    search_env_get(&env);
+
+    #pragma omp parallel
+    {
+        search_env_set(&env);
+        tactical_cache_reset_stats();
+
+        u32 idx;
+
+        if (omp_get_thread_num() < descenders) {
+            while (true) {
+                while (ring_queue_pop(ms->finished_jobs, &idx)) {
+                    pipeline_backup(idx, is_black, wins, losses, draws);
+                }
+
+                if (omp_get_thread_num() == 0 && st != NULL) {
+                    u64 curr_time = current_time_in_millis();
+                    u32 w = __atomic_load_n(wins, __ATOMIC_RELAXED);
+                    u32 l = __atomic_load_n(losses, __ATOMIC_RELAXED);
+                    u32 d = __atomic_load_n(draws, __ATOMIC_RELAXED);
+
+                    if (time_manager_should_stop(st, root, curr_time, w, l, w + l + d)) {
+                        __atomic_store_n(&ms->search_stop, true, __ATOMIC_SEQ_CST);
+                    }
+                }
+
+                if (!__atomic_load_n(&ms->search_stop, __ATOMIC_SEQ_CST) && ring_queue_pop(ms->free_jobs, &idx)) {
+                    /* announced before testing for the stop, see worker exit */
+                    __atomic_add_fetch(&ms->jobs_in_flight, 1, __ATOMIC_SEQ_CST);
 
-    if (depth > max_depths[omp_get_thread_num()]) {
-        max_depths[omp_get_thread_num()] = depth;
+                    if (__atomic_load_n(&ms->search_stop, __ATOMIC_SEQ_CST) ||
+                        __atomic_fetch_add(&leaves_started, 1, __ATOMIC_SEQ_CST) >= max_leaves) {
+                        __atomic_store_n(&ms->search_stop, true, __ATOMIC_SEQ_CST);
+                        ring_queue_push(ms->free_jobs, idx);
+                        __atomic_sub_fetch(&ms->jobs_in_flight, 1, __ATOMIC_SEQ_CST);
+                        continue;
+                    }
+
+                    leaf_job * job = &ms->pipeline_jobs[idx];
+                    cfg_board_clone(&job->cb, initial_cfg_board);
+
+                    if (mcts_descend(&job->cb, start_zobrist_hash, is_black, &job->path, &job->lo)) {
+                        ring_queue_push(ms->pending_jobs, idx);
+                        pipeline_sample_depths();
+                    } else {
+                        pipeline_backup(idx, is_black, wins, losses, draws);
+                    }
+                } else if (ring_queue_pop(ms->pending_jobs, &idx)) {
+                    #pragma omp atomic
+                    ms->pipeline_helped++;
+
+                    pipeline_playouts(idx);
+                } else if (__atomic_load_n(&ms->search_stop, __ATOMIC_SEQ_CST) &&
+                    __atomic_load_n(&ms->jobs_in_flight, __ATOMIC_SEQ_CST) == 0) {
+                    break;
+                } else {
+                    sched_yield();
+                }
+            }
+        } else {
+            while (true) {
+                if (ring_queue_pop(ms->pending_jobs, &idx)) {
+                    pipeline_playouts(idx);
+                } else if (__atomic_load_n(&ms->search_stop, __ATOMIC_SEQ_CST) &&
+                    __atomic_load_n(&ms->jobs_in_flight, __ATOMIC_SEQ_CST) == 0) {
+                    break;
+                } else {
+                    sched_yield();
+                }
+            }
+        }
+
+        add_tactical_cache_stats();
     }
 
-    return outcome;
+    log_pipeline_stats(descenders, threads - descenders);
 }
 
 /*
 Performs a MCTS in at least the available time.
 
-The search may end early if the estimated win rate is very one sided, in which
-case the play selected is a pass. The search is also interrupted if memory runs
-out.
+When to stop is decided by the time manager in use: the search may end early if
+the estimated win rate is very one sided, in which case the play selected is a
+pass, or if the best play can no longer change; it may also be extended up to
+max_stop_time if the best play is unstable. The search is also interrupted if
+memory runs out.
 RETURNS true if a play or pass is suggested instead of resigning
 */
 bool mcts_start_timed(
@@ -304,10 +906,14 @@ bool mcts_start_timed(
     const board * b,
     bool is_black,
     u64 stop_time,
-    u64 early_stop_time
+    u64 early_stop_time,
+    u64 max_stop_time
 ) {
     mcts_init();
 
+    search_time st;
+    time_manager_start(&st, current_time_in_millis(), stop_time, early_stop_time, max_stop_time);
+
     u64 start_zobrist_hash = zobrist_new_hash(b);
     tt_stats * stats = tt_lookup_create(b, is_black, start_zobrist_hash);
     omp_unset_lock(&stats->lock);
@@ -315,81 +921,71 @@ bool mcts_start_timed(
     cfg_board initial_cfg_board;
     cfg_from_board(&initial_cfg_board, b);
 
-    if (stats->expansion_delay != -1) {
-        stats->expansion_delay = -1;
-        init_new_state(stats, &initial_cfg_board, is_black);
-    }
+    expand_root(stats, &initial_cfg_board, is_black);
 
-    memset(max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    memset(ms->max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    reset_expansion_stats();
 
     u32 draws = 0;
     u32 wins = 0;
     u32 losses = 0;
 
-    ran_out_of_memory = false;
-    search_stop = false;
-    bool stopped_early_by_wr = false;
+    ms->ran_out_of_memory = false;
+    reset_tactical_cache_stats();
+    ms->search_stop = ms->search_interrupted;
 
-    #pragma omp parallel for
-    for (u32 sim = 0; sim < INT32_MAX; ++sim) {
-        if (search_stop) {
-            /* there is no way to simultaneously cancel all OMP threads */
-            sim = INT32_MAX;
-            continue;
-        }
+    if (use_pipeline()) {
+        mcts_pipelined_search(&initial_cfg_board, start_zobrist_hash, is_black, INT32_MAX, stats, &st, &wins, &losses, &draws);
+    } else {
+        search_env env;
+        search_env_get(&env);
+
+        #pragma omp parallel
+        {
+            search_env_set(&env);
+            tactical_cache_reset_stats();
+
+            #pragma omp for
+            for (u32 sim = 0; sim < INT32_MAX; ++sim) {
+                if (ms->search_stop) {
+                    /* there is no way to simultaneously cancel all OMP threads */
+                    sim = INT32_MAX;
+                    continue;
+                }
 
-        cfg_board cb;
-        cfg_board_clone(&cb, &initial_cfg_board);
-        d16 outcome = mcts_selection(&cb, start_zobrist_hash, is_black);
-        cfg_board_free(&cb);
-        if (outcome == 0) {
-            #pragma omp atomic
-            draws++;
-        } else if ((outcome > 0) == is_black) {
-            #pragma omp atomic
-            wins++;
-        } else {
-            #pragma omp atomic
-            losses++;
-        }
+                cfg_board cb;
+                cfg_board_clone(&cb, &initial_cfg_board);
+                leaf_outcome lo;
+                mcts_selection(&cb, start_zobrist_hash, is_black, &lo);
+                cfg_board_free(&cb);
 
-        if (omp_get_thread_num() == 0) {
-            u64 curr_time = current_time_in_millis();
+                #pragma omp atomic
+                draws += lo.playouts - lo.wins[0] - lo.wins[1];
+                #pragma omp atomic
+                wins += lo.wins[is_black];
+                #pragma omp atomic
+                losses += lo.wins[!is_black];
 
-#if UCT_CAN_STOP_EARLY
-            if (curr_time >= early_stop_time) {
-                if (curr_time >= stop_time) {
-                    search_stop = true;
-                } else {
-                    double wr = ((double)wins) / ((double)(wins + losses));
+                if (omp_get_thread_num() == 0) {
+                    u64 curr_time = current_time_in_millis();
 
-                    if (wr >= UCT_EARLY_WINRATE) {
-                        stopped_early_by_wr = true;
-                        search_stop = true;
+                    if (time_manager_should_stop(&st, stats, curr_time, wins, losses, wins + losses + draws)) {
+                        ms->search_stop = true;
                     }
                 }
             }
-#else
-            if (curr_time >= stop_time) {
-                search_stop = true;
-            }
-#endif
+
+            add_tactical_cache_stats();
         }
     }
 
-    if (ran_out_of_memory) {
+    if (ms->ran_out_of_memory) {
         flog_warn("uct", "search ran out of memory");
     }
 
+    time_manager_log(&st, current_time_in_millis());
+
     char * s = alloc();
-    if (stopped_early_by_wr) {
-        d64 diff = stop_time - current_time_in_millis();
-        char * s2 = alloc();
-        format_nr_millis(s2, diff);
-        snprintf(s, MAX_PAGE_SIZ, "search ended %s early", s2);
-        release(s2);
-        flog_info("uct", s);
-    }
 
     clear_out_board(out_b);
     out_b->pass = UCT_RESIGN_WINRATE;
@@ -406,10 +1002,10 @@ bool mcts_start_timed(
         }
     }
 
-    u16 max_depth = max_depths[0];
+    u16 max_depth = ms->max_depths[0];
     for (u16 k = 1; k < MAXIMUM_NUM_THREADS; ++k) {
-        if (max_depths[k] > max_depth) {
-            max_depth = max_depths[k];
+        if (ms->max_depths[k] > max_depth) {
+            max_depth = ms->max_depths[k];
         }
     }
 
@@ -426,6 +1022,8 @@ bool mcts_start_timed(
     }
 
     flog_info("uct", s);
+    log_tactical_cache_stats();
+    log_expansion_stats(simulations);
 
     release(s);
     cfg_board_free(&initial_cfg_board);
@@ -459,41 +1057,60 @@ bool mcts_start_sims(
     cfg_board initial_cfg_board;
     cfg_from_board(&initial_cfg_board, b);
 
-    if (stats->expansion_delay != -1) {
-        stats->expansion_delay = -1;
-        init_new_state(stats, &initial_cfg_board, is_black);
-    }
+    expand_root(stats, &initial_cfg_board, is_black);
 
-    memset(max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    memset(ms->max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    reset_expansion_stats();
 
     u32 draws = 0;
     u32 wins = 0;
     u32 losses = 0;
 
-    ran_out_of_memory = false;
-    search_stop = false;
+    ms->ran_out_of_memory = false;
+    reset_tactical_cache_stats();
+    ms->search_stop = ms->search_interrupted;
 
-    #pragma omp parallel for
-    for (u32 sim = 0; sim < simulations; ++sim) {
-        cfg_board cb;
-        cfg_board_clone(&cb, &initial_cfg_board);
-        d16 outcome = mcts_selection(&cb, start_zobrist_hash, is_black);
-        cfg_board_free(&cb);
+    /* the simulations are distributed by leaves */
+    u16 playouts = MAX(1, MIN(playouts_per_leaf, UCT_MAX_PLAYOUTS_PER_LEAF));
+    u32 leaves = (simulations + playouts - 1) / playouts;
 
-        if (outcome == 0) {
-            #pragma omp atomic
-            draws++;
-        } else if ((outcome > 0) == is_black) {
-            #pragma omp atomic
-            wins++;
-        } else {
-            #pragma omp atomic
-            losses++;
+    if (use_pipeline()) {
+        mcts_pipelined_search(&initial_cfg_board, start_zobrist_hash, is_black, leaves, stats, NULL, &wins, &losses, &draws);
+    } else {
+        search_env env;
+        search_env_get(&env);
+
+        #pragma omp parallel
+        {
+            search_env_set(&env);
+            tactical_cache_reset_stats();
+
+            #pragma omp for
+            for (u32 sim = 0; sim < leaves; ++sim) {
+                if (ms->search_stop) {
+                    continue;
+                }
+
+                cfg_board cb;
+                cfg_board_clone(&cb, &initial_cfg_board);
+                leaf_outcome lo;
+                mcts_selection(&cb, start_zobrist_hash, is_black, &lo);
+                cfg_board_free(&cb);
+
+                #pragma omp atomic
+                draws += lo.playouts - lo.wins[0] - lo.wins[1];
+                #pragma omp atomic
+                wins += lo.wins[is_black];
+                #pragma omp atomic
+                losses += lo.wins[!is_black];
+            }
+
+            add_tactical_cache_stats();
         }
     }
 
 
-    if (ran_out_of_memory) {
+    if (ms->ran_out_of_memory) {
         flog_warn("uct", "search ran out of memory");
     }
 
@@ -514,14 +1131,15 @@ bool mcts_start_sims(
         }
     }
 
-    u16 max_depth = max_depths[0];
+    u16 max_depth = ms->max_depths[0];
     for (u16 k = 1; k < MAXIMUM_NUM_THREADS; ++k) {
-        if (max_depths[k] > max_depth) {
-            max_depth = max_depths[k];
+        if (ms->max_depths[k] > max_depth) {
+            max_depth = ms->max_depths[k];
         }
     }
 
     double wr;
+    simulations = wins + losses + draws;
 
     if (draws > 0) {
         wr = ((double)wins) / ((double)(wins + losses));
@@ -532,6 +1150,8 @@ bool mcts_start_sims(
     }
 
     flog_info("uct", s);
+    log_tactical_cache_stats();
+    log_expansion_stats(simulations);
 
     release(s);
     cfg_board_free(&initial_cfg_board);
@@ -543,64 +1163,201 @@ bool mcts_start_sims(
     return true;
 }
 
+/*
+Interrupts the search currently running, or the next one to be started, until
+mcts_clear_interrupt is called. The search returns the best play found so far.
+May be called from another thread.
+*/
+void mcts_interrupt() {
+    ms->search_interrupted = true;
+    ms->search_stop = true;
+}
+
+/*
+Allows new searches to run after a call to mcts_interrupt.
+*/
+void mcts_clear_interrupt() {
+    ms->search_interrupted = false;
+}
+
 /*
 Reset whether MCTS can run in the background after a previous attempt may have
 run out of memory.
 */
 void reset_mcts_can_resume() {
-    mcts_can_resume = true;
+    ms->mcts_can_resume = true;
+}
+
+static int analysis_play_cmp(
+    const void * a,
+    const void * b
+) {
+    const tt_play * pa = (const tt_play *)a;
+    const tt_play * pb = (const tt_play *)b;
+    return (pa->mc_n < pb->mc_n) - (pa->mc_n > pb->mc_n);
 }
 
 /*
-Continue a previous MCTS.
+Follows the most visited plays from a state, locking each state only while
+reading it.
 */
-void mcts_resume(
+static void analysis_pv(
+    tt_stats * stats,
+    analysis_play * dst
+) {
+    while (stats != NULL && dst->pv_len < MCTS_ANALYSIS_MAX_PV) {
+        omp_set_lock(&stats->lock);
+        if (stats->expansion_delay != -1 || stats->plays_count == 0) {
+            omp_unset_lock(&stats->lock);
+            break;
+        }
+
+        tt_play * best = &stats->plays[0];
+        for (move k = 1; k < stats->plays_count; ++k) {
+            if (stats->plays[k].mc_n > best->mc_n) {
+                best = &stats->plays[k];
+            }
+        }
+
+        dst->pv[dst->pv_len++] = best->m;
+        tt_stats * next = best->next_stats;
+        omp_unset_lock(&stats->lock);
+        stats = next;
+    }
+}
+
+/*
+Copies the root plays statistics, holding the root lock only for the copy.
+*/
+static void analysis_take_snapshot(
+    tt_stats * root,
+    analysis_snapshot * dst
+) {
+    tt_play plays[MAX_PLAYS_COUNT];
+
+    omp_set_lock(&root->lock);
+    move count = root->plays_count;
+    memcpy(plays, root->plays, count * sizeof(tt_play));
+    omp_unset_lock(&root->lock);
+
+    qsort(plays, count, sizeof(tt_play), analysis_play_cmp);
+
+    dst->plays_count = MIN(count, MCTS_ANALYSIS_MAX_PLAYS);
+    for (u16 i = 0; i < dst->plays_count; ++i) {
+        analysis_play * ap = &dst->plays[i];
+        ap->m = plays[i].m;
+        ap->visits = plays[i].mc_n;
+        ap->winrate = plays[i].mc_q;
+        ap->rave_winrate = plays[i].amaf_q;
+        ap->pv[0] = plays[i].m;
+        ap->pv_len = 1;
+        analysis_pv(plays[i].next_stats, ap);
+    }
+}
+
+static void resume_search(
     const board * b,
-    bool is_black
+    bool is_black,
+    const volatile bool * interrupt,
+    u32 interval,
+    void (*report)(const analysis_snapshot *)
 ) {
-    if (!mcts_can_resume) {
+    if (!ms->mcts_can_resume || *interrupt) {
         return;
     }
 
     mcts_init();
 
-    u64 stop_time = current_time_in_millis() + 50;
-    ran_out_of_memory = false;
-    search_stop = false;
+    ms->ran_out_of_memory = false;
+    reset_tactical_cache_stats();
+    ms->search_stop = ms->search_interrupted;
 
     u64 start_zobrist_hash = zobrist_new_hash(b);
 
     cfg_board initial_cfg_board;
     cfg_from_board(&initial_cfg_board, b);
 
-    #pragma omp parallel for
-    for (u32 sim = 0; sim < INT32_MAX; ++sim) {
-        if (search_stop) {
-            /* there is no way to simultaneously cancel all OMP threads */
-            sim = INT32_MAX;
-            continue;
+    tt_stats * root = NULL;
+    analysis_snapshot * snapshot = NULL;
+    u64 next_report = UINT64_MAX;
+    if (report != NULL) {
+        root = tt_lookup_create(b, is_black, start_zobrist_hash);
+        omp_unset_lock(&root->lock);
+        expand_root(root, &initial_cfg_board, is_black);
+        snapshot = malloc(sizeof(analysis_snapshot));
+        if (snapshot == NULL) {
+            flog_crit("uct", "system out of memory");
         }
+        next_report = current_time_in_millis() + interval;
+    }
+
+    search_env env;
+    search_env_get(&env);
+
+    #pragma omp parallel
+    {
+        search_env_set(&env);
 
-        cfg_board cb;
-        cfg_board_clone(&cb, &initial_cfg_board);
-        mcts_selection(&cb, start_zobrist_hash, is_black);
-        cfg_board_free(&cb);
+        #pragma omp for
+        for (u32 sim = 0; sim < INT32_MAX; ++sim) {
+            if (ms->search_stop || *interrupt) {
+                /* there is no way to simultaneously cancel all OMP threads */
+                sim = INT32_MAX;
+                continue;
+            }
 
-        if (omp_get_thread_num() == 0) {
-            u64 curr_time = current_time_in_millis();
-            if (curr_time >= stop_time) {
-                search_stop = true;
+            cfg_board cb;
+            cfg_board_clone(&cb, &initial_cfg_board);
+            leaf_outcome lo;
+            mcts_selection(&cb, start_zobrist_hash, is_black, &lo);
+            cfg_board_free(&cb);
+
+            if (omp_get_thread_num() == 0 && report != NULL) {
+                u64 curr_time = current_time_in_millis();
+                if (curr_time >= next_report) {
+                    analysis_take_snapshot(root, snapshot);
+                    report(snapshot);
+                    next_report = curr_time + interval;
+                }
             }
         }
     }
 
-    if (ran_out_of_memory) {
-        mcts_can_resume = false;
+    if (ms->ran_out_of_memory) {
+        ms->mcts_can_resume = false;
     }
 
+    free(snapshot);
     cfg_board_free(&initial_cfg_board);
 }
 
+/*
+Continue a previous MCTS until the interrupt flag is set, or memory runs out.
+The flag is tested before every simulation, and may be set by another thread.
+*/
+void mcts_resume(
+    const board * b,
+    bool is_black,
+    const volatile bool * interrupt
+) {
+    resume_search(b, is_black, interrupt, 0, NULL);
+}
+
+/*
+Continue a previous MCTS until the interrupt flag is set, or memory runs out,
+reporting a snapshot of the root plays every interval milliseconds. The
+report function is called by one of the searching threads.
+*/
+void mcts_analyze(
+    const board * b,
+    bool is_black,
+    const volatile bool * interrupt,
+    u32 interval,
+    void (*report)(const analysis_snapshot *)
+) {
+    resume_search(b, is_black, interrupt, interval, report);
+}
+
 /*
 Execute a 1 second MCTS and return the number of simulations ran.
 RETURNS simulations number
@@ -622,38 +1379,45 @@ u32 mcts_benchmark(
     cfg_board initial_cfg_board;
     cfg_from_board(&initial_cfg_board, &b);
 
-    if (stats->expansion_delay != -1) {
-        stats->expansion_delay = -1;
-        init_new_state(stats, &initial_cfg_board, true);
-    }
+    expand_root(stats, &initial_cfg_board, true);
 
-    memset(max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    memset(ms->max_depths, 0, sizeof(u16) * MAXIMUM_NUM_THREADS);
+    reset_expansion_stats();
 
-    bool search_stop = false;
+    bool stop = false;
     u32 simulations = 0;
 
     /* TODO: do a longer initial run to initialize state */
-    #pragma omp parallel for
-    for (u32 sim = 0; sim < INT32_MAX; ++sim) {
-        if (search_stop) {
-            /* there is no way to simultaneously cancel all OMP threads */
-            sim = INT32_MAX;
-            continue; /* TODO: change to break */
-        }
+    search_env env;
+    search_env_get(&env);
+
+    #pragma omp parallel
+    {
+        search_env_set(&env);
+
+        #pragma omp for
+        for (u32 sim = 0; sim < INT32_MAX; ++sim) {
+            if (stop) {
+                /* there is no way to simultaneously cancel all OMP threads */
+                sim = INT32_MAX;
+                continue; /* TODO: change to break */
+            }
 
-        cfg_board cb;
-        cfg_board_clone(&cb, &initial_cfg_board);
-        mcts_selection(&cb, start_zobrist_hash, true);
-        cfg_board_free(&cb);
+            cfg_board cb;
+            cfg_board_clone(&cb, &initial_cfg_board);
+            leaf_outcome lo;
+            mcts_selection(&cb, start_zobrist_hash, true, &lo);
+            cfg_board_free(&cb);
 
-        #pragma omp atomic
-        simulations++;
+            #pragma omp atomic
+            simulations += lo.playouts;
 
-        if (omp_get_thread_num() == 0) {
-            u64 curr_time = current_time_in_millis();
+            if (omp_get_thread_num() == 0) {
+                u64 curr_time = current_time_in_millis();
 
-            if (curr_time >= stop_time) {
-                search_stop = true;
+                if (curr_time >= stop_time) {
+                    stop = true;
+                }
             }
         }
     }
@@ -13,6 +13,7 @@ UCT expanded states initialization.
 #include "dragon.h"
 #include "move.h"
 #include "pat3.h"
+#include "pat5.h"
 #include "priors.h"
 #include "pts_file.h"
 #include "tactical.h"
@@ -30,6 +31,7 @@ u16 prior_self_atari = PRIOR_SELF_ATARI;
 u16 prior_attack = PRIOR_ATTACK;
 u16 prior_defend = PRIOR_DEFEND;
 u16 prior_pat3 = PRIOR_PAT3;
+u16 prior_pat5 = PRIOR_PAT5;
 u16 prior_near_last = PRIOR_NEAR_LAST;
 u16 prior_line2 = PRIOR_LINE2;
 u16 prior_line3 = PRIOR_LINE3;
@@ -38,10 +40,11 @@ u16 prior_corner = PRIOR_CORNER;
 u16 prior_bad_play = PRIOR_BAD_PLAY;
 u16 prior_pass = PRIOR_PASS;
 u16 prior_starting_point = PRIOR_STARTING;
+u16 prior_deferred_visits = PRIOR_DEFERRED_VISITS;
 
 
 extern u8 distances_to_border[TOTAL_BOARD_SIZ];
-extern move_seq nei_dst_3[TOTAL_BOARD_SIZ];
+extern nei_seq24 nei_dst_3[TOTAL_BOARD_SIZ];
 extern u8 out_neighbors4[TOTAL_BOARD_SIZ];
 
 extern bool border_left[TOTAL_BOARD_SIZ];
@@ -142,6 +145,9 @@ Initiates the MCTS and AMAF statistics with the values from an external
 heuristic.
 Also marks playable positions, excluding playing in own eyes and ko violations,
 with at least one visit.
+Only the cheap heuristics are applied here; the tactical ones are added by
+init_deferred_priors once the state has been visited prior_deferred_visits
+times.
 */
 void init_new_state(
     tt_stats * stats,
@@ -166,44 +172,6 @@ void init_new_state(
 
     estimate_eyes(cb, is_black, viable, play_okay, in_nakade);
 
-    u16 saving_play[TOTAL_BOARD_SIZ];
-    memset(saving_play, 0, TOTAL_BOARD_SIZ * sizeof(u16));
-
-    u16 capturable[TOTAL_BOARD_SIZ];
-    memset(capturable, 0, TOTAL_BOARD_SIZ * sizeof(u16));
-
-    /*
-    Tactical analysis of attack/defense of unsettled groups.
-    */
-    for (u8 i = 0; i < cb->unique_groups_count; ++i) {
-        group * g = cb->g[cb->unique_groups[i]];
-        if (g->eyes < 2) {
-            move candidates[MAX_GROUPS];
-            u16 candidates_count = 0;
-
-            if (g->is_black == is_black) {
-                if (get_killing_play(cb, g) != NONE) {
-                    can_be_saved_all(cb, g, &candidates_count, candidates);
-
-                    for (u16 j = 0; j < candidates_count; ++j) {
-                        saving_play[candidates[j]] += g->stones.count + g->liberties;
-                    }
-                }
-            } else {
-                can_be_killed_all(cb, g, &candidates_count, candidates);
-
-                if (candidates_count > 0 && can_be_saved(cb, g)) {
-                    for (u16 j = 0; j < candidates_count; ++j) {
-                        capturable[candidates[j]] += g->stones.count + g->liberties;
-                    }
-                }
-            }
-        }
-    }
-
-    u8 libs_after_playing[TOTAL_BOARD_SIZ];
-    memset(libs_after_playing, 0, TOTAL_BOARD_SIZ);
-
     move ko = get_ko_play(cb);
     stats->plays_count = 0;
 
@@ -235,8 +203,6 @@ void init_new_state(
             continue;
         }
 
-        libs_after_playing[m] = libs;
-
         /*
         Even game heuristic
         */
@@ -261,13 +227,6 @@ void init_new_state(
             mc_v += prior_bad_play;
         }
 
-        /*
-        Prohibit self-ataris that don't contribute to killing an opponent group
-        */
-        if (capturable[0] == 0 && (libs < 2 && lib2_self_atari(cb, is_black, m))) {
-            mc_v += prior_self_atari;
-        }
-
         /*
         Nakade
         */
@@ -280,24 +239,6 @@ void init_new_state(
             }
         }
 
-        /*
-        Saving plays
-        */
-        if (saving_play[m] > 0) {
-            u16 b = (u16)powf(saving_play[m], prior_stone_scale_factor);
-            mc_w += prior_defend + b;
-            mc_v += prior_defend + b;
-        }
-
-        /*
-        Capturing plays
-        */
-        if (capturable[m] > 0) {
-            u16 b = (u16)powf(capturable[m], prior_stone_scale_factor);
-            mc_w += prior_attack + b;
-            mc_v += prior_attack + b;
-        }
-
         /*
         3x3 patterns
         */
@@ -306,6 +247,16 @@ void init_new_state(
             mc_v += prior_pat3;
         }
 
+#if USE_PAT5_HASH
+        /*
+        5x5 diamond patterns
+        */
+        if (libs > 1 && pat5_find(cb->pat5_hash[m], is_black) != 0) {
+            mc_w += prior_pat5;
+            mc_v += prior_pat5;
+        }
+#endif
+
 
         /*
         Favor plays near to the last and its group liberties
@@ -371,4 +322,119 @@ void init_new_state(
     if (cb->empty.count < TOTAL_BOARD_SIZ / 2 || stats->plays_count < TOTAL_BOARD_SIZ / 8) {
         stats_add_play_final(stats, PASS, UCT_RESIGN_WINRATE, prior_pass);
     }
+
+    if (prior_deferred_visits == 0) {
+        init_deferred_priors(stats, cb, is_black);
+    } else {
+        stats->deferred_priors = MIN(prior_deferred_visits, 128) - 1;
+    }
+}
+
+/*
+Adds prior wins and visits to the statistics of a play, on top of whatever
+results it has already accumulated.
+*/
+static void stats_add_prior(
+    tt_play * play,
+    u32 mc_w, /* wins */
+    u32 mc_v /* visits */
+) {
+    play->mc_q = (play->mc_q * play->mc_n + mc_w) / (play->mc_n + mc_v);
+    play->mc_n += mc_v;
+    play->amaf_q = (play->amaf_q * play->amaf_n + mc_w) / (play->amaf_n + mc_v);
+    play->amaf_n += mc_v;
+}
+
+/*
+Deferred priors values with heuristic MC-RAVE
+
+Adds the contribution of the expensive tactical heuristics (attack and defense
+of unsettled groups and self-ataris) to a state already initialized by
+init_new_state. Should only be called once per state.
+*/
+void init_deferred_priors(
+    tt_stats * stats,
+    cfg_board * cb,
+    bool is_black
+) {
+    stats->deferred_priors = -1;
+
+    u16 saving_play[TOTAL_BOARD_SIZ];
+    memset(saving_play, 0, TOTAL_BOARD_SIZ * sizeof(u16));
+
+    u16 capturable[TOTAL_BOARD_SIZ];
+    memset(capturable, 0, TOTAL_BOARD_SIZ * sizeof(u16));
+
+    /*
+    Tactical analysis of attack/defense of unsettled groups.
+    */
+    for (u8 i = 0; i < cb->unique_groups_count; ++i) {
+        group * g = cb->g[cb->unique_groups[i]];
+        if (g->eyes < 2) {
+            move candidates[MAX_GROUPS];
+            u16 candidates_count = 0;
+
+            if (g->is_black == is_black) {
+                if (get_killing_play(cb, g) != NONE) {
+                    can_be_saved_all(cb, g, &candidates_count, candidates);
+
+                    for (u16 j = 0; j < candidates_count; ++j) {
+                        saving_play[candidates[j]] += g->stones_count + g->liberties;
+                    }
+                }
+            } else {
+                can_be_killed_all(cb, g, &candidates_count, candidates);
+
+                if (candidates_count > 0 && can_be_saved(cb, g)) {
+                    for (u16 j = 0; j < candidates_count; ++j) {
+                        capturable[candidates[j]] += g->stones_count + g->liberties;
+                    }
+                }
+            }
+        }
+    }
+
+    for (move k = 0; k < stats->plays_count; ++k) {
+        tt_play * play = &stats->plays[k];
+        move m = play->m;
+        if (m == PASS) {
+            continue;
+        }
+
+        u32 mc_w = 0;
+        u32 mc_v = 0;
+
+        /*
+        Prohibit self-ataris that don't contribute to killing an opponent group
+        */
+        if (capturable[0] == 0) {
+            move _ignored;
+            u8 libs = libs_after_play(cb, is_black, m, &_ignored);
+            if (libs < 2 && lib2_self_atari(cb, is_black, m)) {
+                mc_v += prior_self_atari;
+            }
+        }
+
+        /*
+        Saving plays
+        */
+        if (saving_play[m] > 0) {
+            u16 b = (u16)powf(saving_play[m], prior_stone_scale_factor);
+            mc_w += prior_defend + b;
+            mc_v += prior_defend + b;
+        }
+
+        /*
+        Capturing plays
+        */
+        if (capturable[m] > 0) {
+            u16 b = (u16)powf(capturable[m], prior_stone_scale_factor);
+            mc_w += prior_attack + b;
+            mc_v += prior_attack + b;
+        }
+
+        if (mc_v > 0) {
+            stats_add_prior(play, mc_w, mc_v);
+        }
+    }
 }
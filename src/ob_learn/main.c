@@ -289,7 +289,7 @@ lbl_usage:
         u32 given = secs_per_turn * 1000;
         u64 stop_time = curr_time + given;
         u64 early_stop_time = curr_time + given / 3;
-        mcts_start_timed(&out_b, &b, true, stop_time, early_stop_time);
+        mcts_start_timed(&out_b, &b, true, stop_time, early_stop_time, stop_time);
 
         out_b.pass = -1.0;
         move best = select_play_fast(&out_b);
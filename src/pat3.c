@@ -5,12 +5,13 @@ of GNU Go, MoGo and others over the years.
 The life of these patterns is as follow:
  * On startup a pat3 file is loaded with a number of 3x3 patterns suggesting
  play at the center intersection. The pattern is flipped and rotated and stored
- in a hash table for both players (with the color inverted for white). They are
- stored in their 16-bit value form.
+ in a compact table from the perspective of the black player. They are stored
+ in their 16-bit value form.
 
  * In MCTS each candidate position can be transposed to a 3x3 array, which fixed
  out of bounds codification, fliped and rotated (but the color remains the same)
- and searched for in the appropriate hash table.
+ and searched for in the table; for white the colors of the 16-bit value are
+ swapped first.
 */
 
 #include "config.h"
@@ -32,10 +33,20 @@ The life of these patterns is as follow:
 #include "types.h"
 
 
-static u16 b_pattern_table[65536];
-static u16 w_pattern_table[65536];
+/*
+Pattern weights from the perspective of the black player, in a two-level table:
+a bitmap of the 3x3 codes with patterns, the number of patterns before each word
+of the bitmap, and the weights of the patterns compacted in code order. The
+bitmap and ranks take 10 KiB. White lookups swap the colors of the code first.
+*/
+static u64 pattern_bitmap[65536 / 64];
+static u16 pattern_rank[65536 / 64];
+static u16 * pattern_weights = NULL;
 static bool pat3_table_inited = false;
 
+/* full table used only while loading the patterns */
+static u16 * load_table = NULL;
+
 static hash_table * weights_table = NULL;
 static u32 weights_found = 0;
 static u32 weights_not_found = 0;
@@ -85,14 +96,21 @@ static void clean_symbols(
 
 static void pat3_insert(
     u16 value,
-    u16 value_inv,
     u16 weight
 ) {
     /* patterns from blacks perspective */
-    b_pattern_table[value] = weight;
+    load_table[value] = weight;
+}
 
-    /* patterns from whites perspective */
-    w_pattern_table[value_inv] = weight;
+/*
+Swaps the black and white stones of a 3x3 code, leaving empty and out of bounds
+cells unchanged: the two bits of a cell are flipped when they differ.
+RETURNS code with the colors swapped
+*/
+static u16 swap_colors(
+    u16 value
+) {
+    return value ^ (((value ^ (value >> 1)) & 0x5555) * 3);
 }
 
 /*
@@ -103,7 +121,55 @@ u16 pat3_find(
     u16 value,
     bool is_black
 ) {
-    return is_black ? b_pattern_table[value] : w_pattern_table[value];
+    if (!is_black) {
+        value = swap_colors(value);
+    }
+
+    u64 word = pattern_bitmap[value / 64];
+    u64 bit = 1ULL << (value % 64);
+
+    if ((word & bit) == 0) {
+        return 0;
+    }
+
+    return pattern_weights[pattern_rank[value / 64] + __builtin_popcountll(word & (bit - 1))];
+}
+
+/*
+Builds the compact table from the full one used while loading.
+RETURNS number of patterns
+*/
+static u32 compact_table() {
+    u32 count = 0;
+
+    for (u32 i = 0; i < 65536; ++i) {
+        if (load_table[i] != 0) {
+            ++count;
+        }
+    }
+
+    pattern_weights = malloc(MAX(count, 1) * sizeof(u16));
+    if (pattern_weights == NULL) {
+        flog_crit("pat3", "system out of memory");
+    }
+
+    u32 rank = 0;
+
+    for (u32 w = 0; w < 65536 / 64; ++w) {
+        pattern_bitmap[w] = 0;
+        pattern_rank[w] = rank;
+
+        for (u32 b = 0; b < 64; ++b) {
+            u16 weight = load_table[w * 64 + b];
+
+            if (weight != 0) {
+                pattern_bitmap[w] |= 1ULL << b;
+                pattern_weights[rank++] = weight;
+            }
+        }
+    }
+
+    return count;
 }
 
 static void flip(
@@ -340,18 +406,13 @@ static void multiply_and_store(
         }
     }
 
-    u8 p_inv[3][3];
     for (u8 r = 1; r < 9; ++r) {
         memcpy(p, pat, 3 * 3);
         reduce_pattern(p, r);
         u16 value = pat3_to_string((const u8 (*)[3])p);
 
-        if (pat3_find(value, true) == 0) {
-            memcpy(p_inv, p, 3 * 3);
-            pat3_invert(p_inv);
-            u16 value_inv = pat3_to_string((const u8 (*)[3])p);
-            assert(pat3_find(value_inv, false) == 0);
-            pat3_insert(value, value_inv, weight);
+        if (load_table[value] == 0) {
+            pat3_insert(value, weight);
         }
     }
 }
@@ -550,6 +611,11 @@ void pat3_init() {
         flog_crit("pat3", "system out of memory");
     }
 
+    load_table = calloc(65536, sizeof(u16));
+    if (load_table == NULL) {
+        flog_crit("pat3", "system out of memory");
+    }
+
     char * buf = alloc();
 
     if (USE_PATTERN_WEIGHTS) {
@@ -595,6 +661,13 @@ void pat3_init() {
 
     free(file_buf);
 
+    u32 patterns = compact_table();
+    free(load_table);
+    load_table = NULL;
+
+    snprintf(buf, MAX_PAGE_SIZ, "%u expanded patterns in %u KiB", patterns, (u32)(sizeof(pattern_bitmap) + sizeof(pattern_rank) + patterns * sizeof(u16)) / 1024);
+    flog_info("pat3", buf);
+
     if (USE_PATTERN_WEIGHTS && weights_table != NULL) {
         snprintf(buf, MAX_PAGE_SIZ, "%u/%u expanded patterns weighted", weights_found, weights_found + weights_not_found);
         flog_info("pat3", buf);
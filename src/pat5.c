@@ -0,0 +1,490 @@
+/*
+Functions that support the use of large patterns, covering the 5x5 diamond
+neighborhood (manhattan distance 2 or less) of a play.
+
+The life of these patterns is as follow:
+ * On startup the .pat5 files are loaded, with a number of patterns suggesting
+ play at the center intersection. The pattern is flipped and rotated, and its
+ 64-bit Zobrist hash stored in a compact dictionary for both players (with the
+ color inverted for white).
+
+ * The hashes of the neighborhood of every intersection are maintained
+ incrementally by the cfg_board structure, so looking up a candidate play costs
+ a single hash table probe.
+
+The dictionary is an open addressing hash table with linear probing, with the
+keys and weights in separate arrays; a zero weight marks a free slot.
+
+A .pat5 pattern is written as five rows of five symbols, using the same symbols
+as .pat3 files. Only the 12 intersections of the diamond are considered, the
+corners of the square are ignored (but must be present). The fifth row can be
+followed by the pattern weight; the default is 1. Example:
+
+??O??
+?X.X?
+?....
+?....
+??.?? 20
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "alloc.h"
+#include "board.h"
+#include "engine.h"
+#include "file_io.h"
+#include "flog.h"
+#include "pat3.h"
+#include "pat5.h"
+#include "stringm.h"
+#include "types.h"
+#include "zobrist.h"
+
+/* from zobrist */
+extern u64 iv_pat5[4 * BOARD_SIZ + 5][4];
+
+/*
+Codification of white being the player, so the same neighborhood hash can be
+looked up for both players in the same dictionary.
+*/
+#define PAT5_WHITE_PLAYER 0xd1b54a32d192ed03ULL
+
+#define PAT5_INITIAL_CAPACITY 1024
+
+static u64 * dict_keys = NULL;
+static u16 * dict_weights = NULL;
+static u32 dict_mask = 0;
+static u32 dict_count = 0;
+static bool pat5_inited = false;
+
+
+static u32 dict_slot(
+    u64 key
+) {
+    /* the low bits of the Zobrist keys are already well mixed */
+    u32 i = (u32)key & dict_mask;
+
+    while (dict_weights[i] != 0 && dict_keys[i] != key) {
+        i = (i + 1) & dict_mask;
+    }
+
+    return i;
+}
+
+static void dict_alloc(
+    u32 capacity
+) {
+    dict_keys = malloc(capacity * sizeof(u64));
+    dict_weights = calloc(capacity, sizeof(u16));
+
+    if (dict_keys == NULL || dict_weights == NULL) {
+        flog_crit("pat5", "system out of memory");
+    }
+
+    dict_mask = capacity - 1;
+}
+
+static void dict_grow() {
+    u64 * old_keys = dict_keys;
+    u16 * old_weights = dict_weights;
+    u32 old_capacity = dict_mask + 1;
+
+    dict_alloc(old_capacity * 2);
+
+    for (u32 i = 0; i < old_capacity; ++i) {
+        if (old_weights[i] != 0) {
+            u32 j = dict_slot(old_keys[i]);
+            dict_keys[j] = old_keys[i];
+            dict_weights[j] = old_weights[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_weights);
+}
+
+/*
+Inserts a pattern hash if not already present.
+*/
+static void dict_insert(
+    u64 key,
+    u16 weight
+) {
+    if (dict_keys == NULL) {
+        dict_alloc(PAT5_INITIAL_CAPACITY);
+    } else if ((dict_count + 1) * 2 > dict_mask + 1) {
+        /* keep the load factor under 1/2 */
+        dict_grow();
+    }
+
+    u32 i = dict_slot(key);
+
+    if (dict_weights[i] == 0) {
+        dict_keys[i] = key;
+        dict_weights[i] = weight;
+        dict_count++;
+    }
+}
+
+/*
+Lookup of pattern weight for the specified player.
+RETURNS pattern weight or 0 if not found
+*/
+u16 pat5_find(
+    u64 hash,
+    bool is_black
+) {
+    if (dict_count == 0) {
+        return 0;
+    }
+
+    u64 key = is_black ? hash : hash ^ PAT5_WHITE_PLAYER;
+    return dict_weights[dict_slot(key)];
+}
+
+/*
+RETURNS the number of patterns in the dictionary, counting each rotation, flip
+and color
+*/
+u32 pat5_dictionary_size() {
+    return dict_count;
+}
+
+static bool in_diamond(
+    d8 x,
+    d8 y
+) {
+    return abs(x) + abs(y) <= 2 && (x != 0 || y != 0);
+}
+
+/*
+Calculates the 5x5 diamond hash of the neighborhood of an intersection from
+scratch, with board safety. For testing the incremental hashes.
+RETURNS 64-bit hash of the neighborhood
+*/
+u64 pat5_hash_slow(
+    const u8 p[static TOTAL_BOARD_SIZ],
+    move m
+) {
+    d8 x;
+    d8 y;
+    move_to_coord(m, (u8 *)&x, (u8 *)&y);
+    u64 ret = 0;
+
+    for (d8 i = -2; i <= 2; ++i) {
+        for (d8 j = -2; j <= 2; ++j) {
+            if (!in_diamond(i, j)) {
+                continue;
+            }
+
+            u8 cell;
+            if (x + i < 0 || x + i >= BOARD_SIZ || y + j < 0 || y + j >= BOARD_SIZ) {
+                cell = ILLEGAL;
+            } else {
+                cell = p[coord_to_move(x + i, y + j)];
+            }
+
+            ret ^= iv_pat5[j * BOARD_SIZ + i + 2 * BOARD_SIZ + 2][cell];
+        }
+    }
+
+    return ret;
+}
+
+/*
+Hashes a pattern, indexed by [y][x], from the perspective of the player with the
+black stones.
+*/
+static u64 pattern_hash(
+    const u8 pat[static 5][5]
+) {
+    u64 ret = 0;
+
+    for (d8 y = -2; y <= 2; ++y) {
+        for (d8 x = -2; x <= 2; ++x) {
+            if (in_diamond(x, y)) {
+                ret ^= iv_pat5[y * BOARD_SIZ + x + 2 * BOARD_SIZ + 2][pat[y + 2][x + 2]];
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*
+Applies one of the 8 symmetries of the square: transposition, then horizontal
+and vertical flips, as selected by the bits of symmetry.
+*/
+static void transform(
+    u8 dst[static 5][5],
+    const u8 src[static 5][5],
+    u8 symmetry
+) {
+    for (d8 y = -2; y <= 2; ++y) {
+        for (d8 x = -2; x <= 2; ++x) {
+            d8 tx = (symmetry & 1) ? y : x;
+            d8 ty = (symmetry & 1) ? x : y;
+
+            if (symmetry & 2) {
+                tx = -tx;
+            }
+            if (symmetry & 4) {
+                ty = -ty;
+            }
+
+            dst[ty + 2][tx + 2] = src[y + 2][x + 2];
+        }
+    }
+}
+
+static void multiply_and_store(
+    const u8 pat[static 5][5],
+    u16 weight
+) {
+    u8 p[5][5];
+    u8 p_inv[5][5];
+
+    for (u8 s = 0; s < 8; ++s) {
+        transform(p, pat, s);
+
+        for (u8 y = 0; y < 5; ++y) {
+            for (u8 x = 0; x < 5; ++x) {
+                if (p[y][x] == BLACK_STONE) {
+                    p_inv[y][x] = WHITE_STONE;
+                } else if (p[y][x] == WHITE_STONE) {
+                    p_inv[y][x] = BLACK_STONE;
+                } else {
+                    p_inv[y][x] = p[y][x];
+                }
+            }
+        }
+
+        dict_insert(pattern_hash((const u8 (*)[5])p), weight);
+        dict_insert(pattern_hash((const u8 (*)[5])p_inv) ^ PAT5_WHITE_PLAYER, weight);
+    }
+}
+
+/*
+Expands the wildcard symbols of the pattern into all possible configurations.
+RETURNS false if the dictionary is full
+*/
+static bool expand_pattern(
+    u8 p[static 5][5],
+    u16 weight
+) {
+    for (d8 y = -2; y <= 2; ++y) {
+        for (d8 x = -2; x <= 2; ++x) {
+            if (!in_diamond(x, y)) {
+                continue;
+            }
+
+            u8 * c = &p[y + 2][x + 2];
+            u8 symbol = *c;
+            u8 options[3];
+            u8 options_count = 0;
+
+            switch (symbol) {
+            case SYMBOL_OWN_OR_EMPTY:
+                options[options_count++] = BLACK_STONE;
+                options[options_count++] = EMPTY;
+                break;
+            case SYMBOL_OPT_OR_EMPTY:
+                options[options_count++] = WHITE_STONE;
+                options[options_count++] = EMPTY;
+                break;
+            case SYMBOL_STONE_OR_EMPTY:
+                options[options_count++] = BLACK_STONE;
+                options[options_count++] = WHITE_STONE;
+                options[options_count++] = EMPTY;
+                break;
+            default:
+                continue;
+            }
+
+            for (u8 i = 0; i < options_count; ++i) {
+                *c = options[i];
+
+                if (!expand_pattern(p, weight)) {
+                    *c = symbol;
+                    return false;
+                }
+            }
+
+            *c = symbol;
+            return true;
+        }
+    }
+
+    if (dict_count + 16 > PAT5_MAX_PATTERNS) {
+        return false;
+    }
+
+    multiply_and_store((const u8 (*)[5])p, weight);
+    return true;
+}
+
+/*
+Convert the final symbols of the diamond; wildcards are left as-is.
+*/
+static void clean_symbols(
+    u8 p[static 5][5]
+) {
+    for (d8 y = -2; y <= 2; ++y) {
+        for (d8 x = -2; x <= 2; ++x) {
+            u8 * c = &p[y + 2][x + 2];
+
+            if (!in_diamond(x, y)) {
+                *c = EMPTY;
+                continue;
+            }
+
+            switch (*c) {
+            case SYMBOL_EMPTY:
+                *c = EMPTY;
+                break;
+            case SYMBOL_BORDER:
+                *c = ILLEGAL;
+                break;
+            case SYMBOL_OWN_STONE:
+                *c = BLACK_STONE;
+                break;
+            case SYMBOL_OPT_STONE:
+                *c = WHITE_STONE;
+                break;
+            case SYMBOL_OWN_OR_EMPTY:
+            case SYMBOL_OPT_OR_EMPTY:
+            case SYMBOL_STONE_OR_EMPTY:
+                break;
+            default: {
+                char * s = alloc();
+                snprintf(s, MAX_PAGE_SIZ, "pattern file format error; unknown symbol: '%c', %u\n", *c, *c);
+                flog_crit("pat5", s);
+                release(s);
+            }
+            }
+        }
+    }
+}
+
+/*
+Reads patterns in the .pat5 format into the dictionary, expanding them. The text
+is modified.
+RETURNS the number of patterns read
+*/
+u32 pat5_read_patterns(
+    char * text
+) {
+    u8 pat[5][5];
+    u8 pat_pos = 0;
+    u32 pats_read = 0;
+
+    char * line;
+    char * init_str = text;
+    char * save_ptr;
+    while ((line = strtok_r(init_str, "\r\n", &save_ptr)) != NULL) {
+        init_str = NULL;
+
+        line_cut_before(line, '#');
+
+        line = trim(line);
+        if (line == NULL) {
+            continue;
+        }
+
+        u16 len = strlen(line);
+        if (len < 5) {
+            continue;
+        }
+
+        memcpy(pat[pat_pos], line, 5);
+        ++pat_pos;
+
+        if (pat_pos < 5) {
+            continue;
+        }
+
+        pat_pos = 0;
+
+        d32 weight = 1;
+        char * weight_str = trim(line + 5);
+        if (weight_str != NULL && strlen(weight_str) > 0 &&
+            (!parse_int(&weight, weight_str) || weight < 1 || weight > 65535)) {
+            flog_crit("pat5", "pattern file format error; illegal weight");
+        }
+
+        clean_symbols(pat);
+
+        if (!expand_pattern(pat, (u16)weight)) {
+            flog_warn("pat5", "pattern dictionary is full");
+            break;
+        }
+
+        pats_read += 1;
+    }
+
+    return pats_read;
+}
+
+static u32 read_pat5_file(
+    const char * restrict filename,
+    char * restrict buffer
+) {
+    d32 chars_read = read_ascii_file(buffer, MAX_FILE_SIZ, filename);
+    if (chars_read < 0) {
+        flog_crit("pat5", "couldn't open file for reading");
+    }
+
+    return pat5_read_patterns(buffer);
+}
+
+/*
+Reads the .pat5 patterns files and expands all patterns into all possible and
+patternable configurations.
+*/
+void pat5_init() {
+    if (pat5_inited) {
+        return;
+    }
+
+    pat5_inited = true;
+    zobrist_init();
+
+    char * file_buf = malloc(MAX_FILE_SIZ);
+    if (file_buf == NULL) {
+        flog_crit("pat5", "system out of memory");
+    }
+
+    char * buf = alloc();
+
+    /*
+    Discover .pat5 files
+    */
+    char * pat5_filenames[128];
+    u32 files_found = recurse_find_files(data_folder(), ".pat5", pat5_filenames, 128);
+
+    snprintf(buf, MAX_PAGE_SIZ, "found %u 5x5 diamond pattern files", files_found);
+    flog_info("pat5", buf);
+
+    for (u32 i = 0; i < files_found; ++i) {
+        u32 patterns_found = read_pat5_file(pat5_filenames[i], file_buf);
+
+        snprintf(buf, MAX_PAGE_SIZ, "read %s (%u patterns)", pat5_filenames[i], patterns_found);
+        flog_info("pat5", buf);
+
+        free(pat5_filenames[i]);
+    }
+
+    free(file_buf);
+
+    if (dict_count > 0) {
+        snprintf(buf, MAX_PAGE_SIZ, "%u expanded patterns in %u KiB", dict_count, (dict_mask + 1) * (u32)(sizeof(u64) + sizeof(u16)) / 1024);
+        flog_info("pat5", buf);
+    }
+
+    release(buf);
+}
@@ -1,6 +1,12 @@
 /*
 Non-cryptographic random number generation functions
 
+The generator is xoshiro256** with an independent 256-bit state per thread, so
+that independent engines may use it at the same time. Besides the classic single
+value functions there is a bulk version, to be used in hot loops like MCTS
+playouts, and a generator of random bit masks used to precompute yes/no
+decisions with a fixed probability.
+
 Reminder: maximums are exclusive for integer functions and inclusive (and very
 unlikely) for floating point functions.
 */
@@ -9,82 +15,175 @@ unlikely) for floating point functions.
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <omp.h>
+#include <inttypes.h>
 
 #include "alloc.h"
 #include "flog.h"
 #include "timem.h"
 #include "types.h"
 
-static u32 state[MAXIMUM_NUM_THREADS];
-static bool rand_inited = false;
-
 /*
-Initiate the seeds for the different thread RNG, again.
+State of each thread, seeded on first use after rand_init or rand_reinit.
 */
-void rand_reinit() {
-    char * buf = alloc();
+static __thread u64 state[4];
+static __thread u32 state_generation = 0;
 
-    u16 idx = 0;
-    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "RNG seed vector:\n");
+static u32 generation = 0; /* 0 while not initiated */
+static u64 base_seed;
+static u32 threads_seeded = 0;
 
-    for (u16 i = 0; i < MAXIMUM_NUM_THREADS;) {
-        state[i] = (u32)current_nanoseconds();
-        bool found = false;
+static u64 splitmix64(
+    u64 * x
+) {
+    u64 z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
-        for (u16 j = 0; j < i; ++j) {
-            if (state[j] == state[i]) {
-                found = true;
-                break;
-            }
-        }
+static u64 rotl(
+    u64 x,
+    u8 k
+) {
+    return (x << k) | (x >> (64 - k));
+}
 
-        if (!found && state[i] > 0) {
-            ++i;
-        }
+static u64 next(
+    u64 s[static 4]
+) {
+    u64 ret = rotl(s[1] * 5, 7) * 9;
+    u64 t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return ret;
+}
+
+/*
+Each thread takes the next four values of the same splitmix64 sequence, so no
+two threads share part of their state.
+*/
+static void seed_thread() {
+    u64 seed = base_seed + __atomic_fetch_add(&threads_seeded, 1, __ATOMIC_RELAXED) *
+        4 * 0x9e3779b97f4a7c15ULL;
+
+    for (u8 j = 0; j < 4; ++j) {
+        state[j] = splitmix64(&seed);
     }
 
-    for (u16 i = 0; i < MAXIMUM_NUM_THREADS; ++i) {
-        idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "%u: %x\n", i, state[i]);
+    state_generation = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+static u64 * thread_state() {
+    if (state_generation != __atomic_load_n(&generation, __ATOMIC_RELAXED)) {
+        seed_thread();
     }
 
+    return state;
+}
+
+/*
+Initiate the seeds for the different thread RNG, again.
+*/
+void rand_reinit() {
+    base_seed = (current_time_in_millis() << 30) ^ current_nanoseconds();
+    __atomic_store_n(&threads_seeded, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+
+    char * buf = alloc();
+    snprintf(buf, MAX_PAGE_SIZ, "RNG seed: %016" PRIx64 "\n", base_seed);
     flog_debug("rand", buf);
     release(buf);
-
-    rand_inited = true;
 }
 
 /*
 Initiate the seeds for the different thread RNG.
 */
 void rand_init() {
-    if (!rand_inited) {
+    if (generation == 0) {
         alloc_init();
         rand_reinit();
     }
 }
 
 /*
-Fast and well distributed 16-bit RNG based on the glibc mixed LCG.
+Fast 64-bit RNG with all bits of good quality.
+RETURNS pseudo random 64-bit number
+*/
+u64 rand_u64() {
+    return next(thread_state());
+}
+
+/*
+Fills a buffer with pseudo random 64-bit numbers. Cheaper than calling rand_u64
+repeatedly since the thread state is only looked up once.
+*/
+void rand_fill(
+    u64 * buf,
+    u32 count
+) {
+    u64 * s = thread_state();
+
+    for (u32 i = 0; i < count; ++i) {
+        buf[i] = next(s);
+    }
+}
+
+/*
+Generates a mask of 64 independent random bits, each set with probability
+prob/128. Uses seven pseudo random words.
+RETURNS random bit mask
+*/
+u64 rand_mask128(
+    u16 prob /* 0 to 128 */
+) {
+    if (prob >= 128) {
+        return ~0ULL;
+    }
+
+    u64 r[7];
+    rand_fill(r, 7);
+
+    /*
+    Build from the least significant bit of the probability up: each step
+    halves the current probability and adds half if the bit is set.
+    */
+    u64 mask = 0;
+
+    for (u8 i = 0; i < 7; ++i) {
+        if ((prob >> i) & 1) {
+            mask |= r[i];
+        } else {
+            mask &= r[i];
+        }
+    }
+
+    return mask;
+}
+
+/*
+Fast and well distributed 16-bit RNG.
 RETURNS pseudo random 16-bit number
 */
 u16 rand_u16(
     u16 max /* exclusive */
 ) {
-    u32 s = state[omp_get_thread_num()];
-    state[omp_get_thread_num()] = ((s * 1103515245) + 12345) & 0x7fffffff;
-    return ((s & 0xffff) * ((u32)max)) >> 16;
+    return ((rand_u64() >> 48) * ((u32)max)) >> 16;
 }
 
 /*
-Slow alternative for 32-bit. Avoid using.
+Fast and well distributed 32-bit RNG.
 RETURNS pseudo random 32-bit number
 */
 u32 rand_u32(
     u32 max /* exclusive */
 ) {
-    double gen = (double)rand_r(&state[omp_get_thread_num()]);
-    return (gen * ((double)max)) / ((double)RAND_MAX);
+    return ((rand_u64() >> 32) * ((u64)max)) >> 32;
 }
 
 /*
@@ -94,18 +193,6 @@ RETURNS pseudo random IEEE 754 floating point
 float rand_float(
     float max /* inclusive */
 ) {
-    /*
-    Adapted from the method used in Pachi (GPLv2), which is itself based on the
-    method described in www.rgba.org/articles/sfrand/sfrand.htm (proprietary
-    intelectual property). If you believe this may constitue a violation of
-    someones copyright please contact me immediatly (contact information
-    available in AUTHORS file attached).
-    */
-    u32 s = state[omp_get_thread_num()];
-    s *= 16807;
-    state[omp_get_thread_num()] = s;
-    union { u32 ul; float f; } p;
-    p.ul = ((s & 0x007fffff) - 1) | 0x3f800000;
-    float f = p.f - 1.0f;
+    float f = (float)(rand_u64() >> 40) * (1.0f / 16777216.0f);
     return f * max;
 }
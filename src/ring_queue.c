@@ -0,0 +1,130 @@
+/*
+Implementation of a bounded lock-free queue of 32-bit values, safe for multiple
+producers and multiple consumers (D. Vyukov's array based design).
+
+Each cell has a sequence number that tells whether it is ready to be written to
+(equal to the producer position) or read from (equal to the consumer position
+plus one). Producers and consumers claim positions with a compare-and-swap.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "flog.h"
+#include "ring_queue.h"
+#include "types.h"
+
+/*
+Creates a queue able to hold at least capacity values. The capacity is rounded
+up to a power of two.
+RETURNS queue instance
+*/
+ring_queue * ring_queue_create(
+    u32 capacity
+) {
+    u32 size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    ring_queue * q;
+    if (posix_memalign((void **)&q, 64, sizeof(ring_queue)) != 0) {
+        flog_crit("ring", "could not allocate queue memory");
+    }
+
+    q->sequence = malloc(size * sizeof(u64));
+    q->values = malloc(size * sizeof(u32));
+    if (q->sequence == NULL || q->values == NULL) {
+        flog_crit("ring", "could not allocate queue memory");
+    }
+
+    for (u32 i = 0; i < size; ++i) {
+        q->sequence[i] = i;
+    }
+
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+    return q;
+}
+
+/*
+Frees the memory used by the queue. The queue must not be in use.
+*/
+void ring_queue_destroy(
+    ring_queue * q
+) {
+    free(q->sequence);
+    free(q->values);
+    free(q);
+}
+
+/*
+Inserts a value at the end of the queue.
+RETURNS false if the queue is full
+*/
+bool ring_queue_push(
+    ring_queue * q,
+    u32 value
+) {
+    u64 pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+    while (true) {
+        u64 * seq = &q->sequence[pos & q->mask];
+        d64 dif = (d64)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                q->values[pos & q->mask] = value;
+                __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+Removes the value at the front of the queue.
+RETURNS false if the queue is empty
+*/
+bool ring_queue_pop(
+    ring_queue * q,
+    u32 * value
+) {
+    u64 pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+    while (true) {
+        u64 * seq = &q->sequence[pos & q->mask];
+        d64 dif = (d64)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - (pos + 1));
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *value = q->values[pos & q->mask];
+                __atomic_store_n(seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+Number of values in the queue. Only approximate if the queue is being modified
+concurrently.
+RETURNS number of values in the queue
+*/
+u32 ring_queue_size(
+    const ring_queue * q
+) {
+    u64 tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    u64 head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    return tail > head ? (u32)(tail - head) : 0;
+}
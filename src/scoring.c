@@ -19,7 +19,7 @@ Remember that in Matilda, scores and komi are always doubled to become integer.
 #include "alloc.h"
 
 
-extern d16 komi;
+extern __thread d16 komi;
 
 /*
 Produces a textual representation of a Go match score., ex: B+3.5, 0
@@ -158,89 +158,67 @@ d16 score_stones_and_eyes(
 }
 
 
-static void _search(
-    const u8 p[static TOTAL_BOARD_SIZ],
-    move m,
-    bool explored[static TOTAL_BOARD_SIZ],
-    bool * restrict black,
-    bool * restrict white
+#if BOARD_SIZ > 32
+#error Error: area scoring bitboards are limited to boards up to 32x32.
+#endif
+
+/*
+Grows the reachable set, one u32 bitmask per board row, through the open
+intersections until no more change is found.
+*/
+static void _dilate(
+    u32 reach[static BOARD_SIZ],
+    const u32 open[static BOARD_SIZ]
 ) {
-    u8 x;
-    u8 y;
-    move_to_coord(m, &x, &y);
-
-    if (x > 0) {
-        if (p[m + LEFT] == BLACK_STONE) {
-            *black |= true;
-        } else if (p[m + LEFT] == WHITE_STONE) {
-            *white |= true;
-        } else if (explored[m + LEFT] == false) {
-            explored[m + LEFT] = true;
-            _search(p, m + LEFT, explored, black, white);
-        }
-    }
+    bool changed = true;
 
-    if (x < BOARD_SIZ - 1) {
-        if (p[m + RIGHT] == BLACK_STONE) {
-            *black |= true;
-        } else if (p[m + RIGHT] == WHITE_STONE) {
-            *white |= true;
-        } else if (explored[m + RIGHT] == false) {
-            explored[m + RIGHT] = true;
-            _search(p, m + RIGHT, explored, black, white);
-        }
-    }
+    while (changed) {
+        changed = false;
+
+        /* sweep down and then up, so growth propagates in a single pass */
+        for (u8 y = 0; y < BOARD_SIZ; ++y) {
+            u32 r = reach[y];
+            u32 d = r | (r << 1) | (r >> 1);
 
-    if (y > 0) {
-        if (p[m + TOP] == BLACK_STONE) {
-            *black |= true;
-        } else if (p[m + TOP] == WHITE_STONE) {
-            *white |= true;
-        } else if (explored[m + TOP] == false) {
-            explored[m + TOP] = true;
-            _search(p, m + TOP, explored, black, white);
+            if (y > 0) {
+                d |= reach[y - 1];
+            }
+            if (y < BOARD_SIZ - 1) {
+                d |= reach[y + 1];
+            }
+
+            d &= open[y];
+
+            if (d != r) {
+                reach[y] = d;
+                changed = true;
+            }
         }
-    }
 
-    if (y < BOARD_SIZ - 1) {
-        if (p[m + BOTTOM] == BLACK_STONE) {
-            *black |= true;
-        } else if (p[m + BOTTOM] == WHITE_STONE) {
-            *white |= true;
-        } else if (explored[m + BOTTOM] == false) {
-            explored[m + BOTTOM] = true;
-            _search(p, m + BOTTOM, explored, black, white);
+        if (!changed) {
+            break;
         }
-    }
-}
 
-static void _apply(
-    u8 p[static TOTAL_BOARD_SIZ],
-    move m,
-    u8 val
-) {
-    u8 x;
-    u8 y;
-    move_to_coord(m, &x, &y);
+        changed = false;
 
-    if (x > 0 && p[m + LEFT] == EMPTY) {
-        p[m + LEFT] = val;
-        _apply(p, m + LEFT, val);
-    }
+        for (d8 y = BOARD_SIZ - 1; y >= 0; --y) {
+            u32 r = reach[y];
+            u32 d = r | (r << 1) | (r >> 1);
 
-    if (x < BOARD_SIZ - 1 && p[m + RIGHT] == EMPTY) {
-        p[m + RIGHT] = val;
-        _apply(p, m + RIGHT, val);
-    }
+            if (y > 0) {
+                d |= reach[y - 1];
+            }
+            if (y < BOARD_SIZ - 1) {
+                d |= reach[y + 1];
+            }
 
-    if (y > 0 && p[m + TOP] == EMPTY) {
-        p[m + TOP] = val;
-        _apply(p, m + TOP, val);
-    }
+            d &= open[y];
 
-    if (y < BOARD_SIZ - 1 && p[m + BOTTOM] == EMPTY) {
-        p[m + BOTTOM] = val;
-        _apply(p, m + BOTTOM, val);
+            if (d != r) {
+                reach[y] = d;
+                changed = true;
+            }
+        }
     }
 }
 
@@ -252,42 +230,40 @@ RETURNS positive score for a black win; negative for a white win; 0 for a draw
 d16 score_stones_and_area(
     const u8 p[static TOTAL_BOARD_SIZ]
 ) {
-    /* explored intersections array is only used for empty intersections */
-    bool explored[TOTAL_BOARD_SIZ];
-    memset(explored, false, TOTAL_BOARD_SIZ * sizeof(bool));
-
-    u8 bak[TOTAL_BOARD_SIZ];
-    memcpy(bak, p, TOTAL_BOARD_SIZ);
-
-    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
-        if (p[m] == EMPTY && !explored[m]) { /* Find owner of empty intersection */
-            bool found_black = false;
-            bool found_white = false;
-            explored[m] = true;
-            _search(p, m, explored, &found_black, &found_white);
-
-            if (found_black != found_white) { /* established intersection */
-                if (found_black) {
-                    bak[m] = BLACK_STONE;
-                    _apply(bak, m, BLACK_STONE);
-                } else {
-                    bak[m] = WHITE_STONE;
-                    _apply(bak, m, WHITE_STONE);
-                }
-            }
+    u32 empty[BOARD_SIZ];
+    u32 black_reach[BOARD_SIZ];
+    u32 white_reach[BOARD_SIZ];
+    u32 black_open[BOARD_SIZ];
+    u32 white_open[BOARD_SIZ];
+
+    move m = 0;
+    for (u8 y = 0; y < BOARD_SIZ; ++y) {
+        u32 b = 0;
+        u32 w = 0;
+
+        for (u8 x = 0; x < BOARD_SIZ; ++x, ++m) {
+            b |= ((u32)(p[m] == BLACK_STONE)) << x;
+            w |= ((u32)(p[m] == WHITE_STONE)) << x;
         }
+
+        u32 e = ((1U << (BOARD_SIZ - 1)) * 2 - 1) & ~(b | w);
+        empty[y] = e;
+        black_reach[y] = b;
+        white_reach[y] = w;
+        black_open[y] = b | e;
+        white_open[y] = w | e;
     }
 
+    /* empty regions reached by each color, through empty intersections */
+    _dilate(black_reach, black_open);
+    _dilate(white_reach, white_open);
+
     d16 r = 0;
-    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
-        if (bak[m] == BLACK_STONE) {
-            r += 2;
-        } else if (bak[m] == WHITE_STONE) {
-            r -= 2;
-        }
+    for (u8 y = 0; y < BOARD_SIZ; ++y) {
+        u32 black_area = black_reach[y] & ~(white_reach[y] & empty[y]);
+        u32 white_area = white_reach[y] & ~(black_reach[y] & empty[y]);
+        r += 2 * (__builtin_popcount(black_area) - __builtin_popcount(white_area));
     }
 
     return r - komi;
 }
-
-
@@ -0,0 +1,369 @@
+/*
+Application for playing Matilda against itself, with many games at the same
+time in the same process, for tuning and regression runs. Each game is played by
+an independent engine, and written to the data folder as a SGF file.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "alloc.h"
+#include "board.h"
+#include "engine.h"
+#include "flog.h"
+#include "game_record.h"
+#include "mcts.h"
+#include "scoring.h"
+#include "sgf.h"
+#include "stringm.h"
+#include "timem.h"
+#include "types.h"
+
+
+#define MAX_CONCURRENT_GAMES 64
+
+/* from constants */
+extern __thread d16 komi;
+
+static u32 games = 1;
+static u16 concurrent_games = 1;
+static u16 threads_per_game = 1;
+static u32 playouts = 1000;
+static u32 milliseconds = 0; /* 0 to play by number of playouts */
+static u32 memory_per_game = 0; /* 0 to split DEFAULT_UCT_MEMORY between games */
+static d16 game_komi = DEFAULT_KOMI;
+static bool write_sgf = true;
+
+static u32 games_started = 0;
+static u32 games_finished = 0;
+static u32 black_wins = 0;
+static u32 white_wins = 0;
+static u32 draws = 0;
+static u64 plays_made = 0;
+static u64 start_time;
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+Plays a game until both players pass, one resigns or the game becomes too long,
+in which case it is scored as is.
+*/
+static void play_game(
+    engine_ctx * ctx,
+    game_record * gr
+) {
+    clear_game_record(gr);
+    snprintf(gr->black_name, MAX_PLAYER_NAME_SIZ, "matilda");
+    snprintf(gr->white_name, MAX_PLAYER_NAME_SIZ, "matilda");
+    gr->player_names_set = true;
+
+    out_board out_b;
+    bool last_passed = false;
+
+    while (gr->turns < TOTAL_BOARD_SIZ * 2) {
+        bool is_black = current_player_color(gr);
+        engine_set_position(ctx, gr);
+
+        bool has_play;
+        if (milliseconds > 0) {
+            has_play = engine_search_timed(ctx, milliseconds, &out_b);
+        } else {
+            has_play = engine_search_sims(ctx, playouts, &out_b);
+        }
+
+        if (!has_play) {
+            gr->finished = true;
+            gr->resignation = true;
+            gr->final_score = is_black ? -1 : 1;
+            return;
+        }
+
+        move m = engine_best_play(ctx, &out_b);
+        add_play(gr, m);
+
+        if (m == PASS && last_passed) {
+            break;
+        }
+
+        last_passed = (m == PASS);
+    }
+
+    board b;
+    current_game_state(&b, gr);
+    gr->finished = true;
+    gr->final_score = score_stones_and_area(b.p);
+}
+
+static void report_game(
+    u32 game_nr,
+    const game_record * gr,
+    const char * filename
+) {
+    pthread_mutex_lock(&results_lock);
+
+    games_finished++;
+    plays_made += gr->turns;
+    if (gr->final_score > 0) {
+        black_wins++;
+    } else if (gr->final_score < 0) {
+        white_wins++;
+    } else {
+        draws++;
+    }
+
+    double hours = (current_time_in_millis() - start_time) / 3600000.0;
+
+    char * ts = alloc();
+    char * res = alloc();
+    timestamp(ts);
+
+    if (gr->resignation) {
+        snprintf(res, MAX_PAGE_SIZ, "%c+R", gr->final_score > 0 ? 'B' : 'W');
+    } else if (gr->final_score == 0) {
+        snprintf(res, MAX_PAGE_SIZ, "draw");
+    } else {
+        snprintf(res, MAX_PAGE_SIZ, "%c+%u.%u", gr->final_score > 0 ? 'B' : 'W',
+            abs(gr->final_score) / 2, (abs(gr->final_score) % 2) * 5);
+    }
+
+    printf("%s: game %u/%u %s after %u plays %s| %u finished, %.1f games/hour\n",
+        ts, game_nr + 1, games, res, gr->turns, filename, games_finished,
+        games_finished / hours);
+    fflush(stdout);
+
+    release(res);
+    release(ts);
+    pthread_mutex_unlock(&results_lock);
+}
+
+static void * game_thread(
+    void * arg
+) {
+    engine_ctx * ctx = (engine_ctx *)arg;
+    game_record * gr = malloc(sizeof(game_record));
+    if (gr == NULL) {
+        flog_crit("sply", "system out of memory");
+    }
+
+    /* for scoring and the SGF files written by this thread */
+    komi = game_komi;
+
+    char * filename = alloc();
+
+    while (1) {
+        u32 game_nr = __atomic_fetch_add(&games_started, 1, __ATOMIC_RELAXED);
+        if (game_nr >= games) {
+            break;
+        }
+
+        play_game(ctx, gr);
+
+        filename[0] = 0;
+        if (write_sgf && export_game_as_sgf_auto_named(gr, filename)) {
+            strncat(filename, " ", MAX_PAGE_SIZ - strlen(filename) - 1);
+        } else if (write_sgf) {
+            flog_warn("sply", "failed to write SGF file");
+        }
+
+        report_game(game_nr, gr, filename);
+    }
+
+    release(filename);
+    free(gr);
+    return NULL;
+}
+
+static bool parse_positive(
+    u32 * dst,
+    const char * s,
+    u32 max
+) {
+    d32 v;
+    if (!parse_int(&v, s) || v < 1 || (u32)v > max) {
+        return false;
+    }
+
+    *dst = v;
+    return true;
+}
+
+int main(
+    int argc,
+    char * argv[]
+) {
+    bool use_ob = true;
+
+    for (int i = 1; i < argc; ++i) {
+        u32 v;
+
+        if (i < argc - 1 && strcmp(argv[i], "--games") == 0) {
+            if (!parse_positive(&games, argv[i + 1], UINT32_MAX >> 1)) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--concurrent") == 0) {
+            if (!parse_positive(&v, argv[i + 1], MAX_CONCURRENT_GAMES)) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            concurrent_games = v;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--threads") == 0) {
+            if (!parse_positive(&v, argv[i + 1], MAXIMUM_NUM_THREADS)) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            threads_per_game = v;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--playouts") == 0) {
+            if (!parse_positive(&playouts, argv[i + 1], UINT32_MAX >> 1)) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            milliseconds = 0;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--time") == 0) {
+            if (!parse_positive(&milliseconds, argv[i + 1], UINT32_MAX >> 1)) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--memory") == 0) {
+            if (!parse_positive(&memory_per_game, argv[i + 1], 64000) || memory_per_game < 2) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--komi") == 0) {
+            double k;
+            if (!parse_float(&k, argv[i + 1])) {
+                goto lbl_usage;
+            }
+
+            ++i;
+            game_komi = (d16)(k * 2.0);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--disable_opening_books") == 0) {
+            use_ob = false;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--no_sgf") == 0) {
+            write_sgf = false;
+            continue;
+        }
+
+        if (i < argc - 1 && strcmp(argv[i], "--data") == 0) {
+            if (!set_data_folder(argv[i + 1])) {
+                fprintf(stderr, "data directory path %s is not valid\n", argv[i + 1]);
+                exit(EXIT_FAILURE);
+            }
+
+            ++i;
+            continue;
+        }
+
+lbl_usage:
+        printf("Usage: %s [options]\n", argv[0]);
+        printf("Options:\n");
+        printf("--games number - Number of games to play. (default: %u)\n", games);
+        printf("--concurrent number - Number of games played at the same time. (default: %u)\n", concurrent_games);
+        printf("--threads number - Number of threads searching in each game. (default: %u)\n", threads_per_game);
+        printf("--playouts number - Number of playouts per turn. (default: %u)\n", playouts);
+        printf("--time milliseconds - Time to think per turn, instead of a number of playouts.\n");
+        printf("--memory number - MiB of memory for the transpositions table of each game. (default: %u divided by concurrent games)\n", DEFAULT_UCT_MEMORY);
+        printf("--komi value - Komi of the games. (default: %.1f)\n", DEFAULT_KOMI / 2.0);
+        printf("--disable_opening_books - Do not use opening books.\n");
+        printf("--no_sgf - Do not write the games to SGF files.\n");
+        printf("--data folder - Data folder, where the SGF files are also written. (default: %s)\n", DEFAULT_DATA_PATH);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (memory_per_game == 0) {
+        memory_per_game = MAX(DEFAULT_UCT_MEMORY / concurrent_games, 2);
+    }
+
+    concurrent_games = MIN(concurrent_games, games);
+
+    alloc_init();
+
+    flog_config_modes(LOG_MODE_ERROR | LOG_MODE_WARN);
+    flog_config_destinations(LOG_DEST_STDF);
+
+    assert_data_folder_exists();
+    set_use_of_opening_book(use_ob);
+
+    char * ts = alloc();
+    char * s = alloc();
+    timestamp(ts);
+
+    if (milliseconds > 0) {
+        snprintf(s, MAX_PAGE_SIZ, "%u ms", milliseconds);
+    } else {
+        snprintf(s, MAX_PAGE_SIZ, "%u playouts", playouts);
+    }
+
+    printf("%s: Playing %u games, %u at a time with %u threads each, %s per turn, %u MiB per game\n",
+        ts, games, concurrent_games, threads_per_game, s, memory_per_game);
+
+    engine_ctx * engines[MAX_CONCURRENT_GAMES];
+    pthread_t threads[MAX_CONCURRENT_GAMES];
+
+    for (u16 i = 0; i < concurrent_games; ++i) {
+        engines[i] = engine_create(memory_per_game, threads_per_game);
+        engine_set_komi(engines[i], game_komi);
+    }
+
+    start_time = current_time_in_millis();
+
+    for (u16 i = 0; i < concurrent_games; ++i) {
+        if (pthread_create(&threads[i], NULL, game_thread, engines[i]) != 0) {
+            flog_crit("sply", "failed to create game thread");
+        }
+    }
+
+    for (u16 i = 0; i < concurrent_games; ++i) {
+        pthread_join(threads[i], NULL);
+        engine_destroy(engines[i]);
+    }
+
+    u64 elapsed = current_time_in_millis() - start_time;
+    format_nr_millis(s, elapsed);
+    timestamp(ts);
+
+    printf("%s: Finished %u games in %s: %.1f games/hour, %.1f plays/s\n", ts,
+        games_finished, s, games_finished / (elapsed / 3600000.0),
+        plays_made / (elapsed / 1000.0));
+    printf("Black wins: %u (%.1f%%) White wins: %u (%.1f%%) Draws: %u\n",
+        black_wins, (100.0 * black_wins) / games_finished, white_wins,
+        (100.0 * white_wins) / games_finished, draws);
+
+    release(s);
+    release(ts);
+    return EXIT_SUCCESS;
+}
@@ -18,12 +18,13 @@ Play variations and annotations/commentary are ignored.
 #include "flog.h"
 #include "game_record.h"
 #include "scoring.h"
+#include "sgf.h"
 #include "state_changes.h"
 #include "stringm.h"
 #include "types.h"
 #include "version.h"
 
-extern d16 komi;
+extern __thread d16 komi;
 
 static bool undeclared_game_ruleset_warned = false;
 static bool board_size_cant_be_guessed_warned = false;
@@ -235,6 +236,20 @@ bool import_game_from_sgf2(
         return false;
     }
 
+    return import_game_from_sgf_text(gr, buf);
+}
+
+/*
+Import a game record from SGF text, in a null terminated buffer that is modified
+in the process. The komi, if present, is set as the current komi.
+RETURNS true if the game has been found and read correctly
+*/
+bool import_game_from_sgf_text(
+    game_record * gr,
+    char * buf
+) {
+    clear_game_record(gr);
+
     /*
     Game
     */
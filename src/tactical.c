@@ -22,22 +22,24 @@ counting.
 #include "state_changes.h"
 #include "tactical.h"
 #include "types.h"
+#include "zobrist.h"
 
 
 extern u8 out_neighbors8[TOTAL_BOARD_SIZ];
 extern u8 out_neighbors4[TOTAL_BOARD_SIZ];
-extern move_seq neighbors_3x3[TOTAL_BOARD_SIZ];
+extern nei_seq4 neighbors_side[TOTAL_BOARD_SIZ];
+extern nei_seq8 neighbors_3x3[TOTAL_BOARD_SIZ];
 
 extern bool border_left[TOTAL_BOARD_SIZ];
 extern bool border_right[TOTAL_BOARD_SIZ];
 extern bool border_top[TOTAL_BOARD_SIZ];
 extern bool border_bottom[TOTAL_BOARD_SIZ];
 
-/* number of active bits for every byte combination */
-extern u8 active_bits_in_byte[256];
-
 extern bool black_eye[65536];
 extern bool white_eye[65536];
+extern u8 nakade_shape[65536];
+extern u8 black_nakade_side[65536];
+extern u8 white_nakade_side[65536];
 
 /*
 An eye is a point that may eventually become untakeable (without playing
@@ -467,336 +469,59 @@ u8 is_nakade(
 ) {
     assert(is_board_move(m));
 
-    if ((cb->black_neighbors8[m] > 0) == (cb->white_neighbors8[m] > 0)) {
+    u16 code = cb->hash[m];
+    u8 shape = nakade_shape[code];
+
+    if (shape == 0) {
         return 0;
     }
 
-    if (cb->black_neighbors8[m] > 0) {
-        u8 on4 = cb->black_neighbors4[m] + out_neighbors4[m];
-        u8 on8 = cb->black_neighbors8[m] + out_neighbors8[m];
-
-        if ((on4 < 3) && (on8 == on4 + 4)) {
-            /*
-            Straight three, bent three, pyramid four or crossed five
-            */
-            if (!border_left[m] && cb->p[m + LEFT] == EMPTY) {
-                if (cb->black_neighbors4[m + LEFT] + out_neighbors4[m + LEFT] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + LEFT] == 0 && cb->white_neighbors8[m + LEFT] > 1) ||
-                    (out_neighbors4[m + LEFT] > 0 && cb->white_neighbors8[m + LEFT] > 0)) {
-                    return 0;
-                }
-            }
-
-            if (!border_right[m] && cb->p[m + RIGHT] == EMPTY) {
-                if (cb->black_neighbors4[m + RIGHT] + out_neighbors4[m + RIGHT] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + RIGHT] == 0 && cb->white_neighbors8[m + RIGHT] > 1) ||
-                    (out_neighbors4[m + RIGHT] > 0 && cb->white_neighbors8[m + RIGHT] > 0)) {
-                    return 0;
-                }
-            }
-
-            if (!border_top[m] && cb->p[m + TOP] == EMPTY) {
-                if (cb->black_neighbors4[m + TOP] + out_neighbors4[m + TOP] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + TOP] == 0 && cb->white_neighbors8[m + TOP] > 1) ||
-                    (out_neighbors4[m + TOP] > 0 && cb->white_neighbors8[m + TOP] > 0)) {
-                    return 0;
-                }
-            }
-
-            if (!border_bottom[m] && cb->p[m + BOTTOM] == EMPTY) {
-                if (cb->black_neighbors4[m + BOTTOM] + out_neighbors4[m + BOTTOM] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + BOTTOM] == 0 && cb->white_neighbors8[m + BOTTOM] > 1) ||
-                    (out_neighbors4[m + BOTTOM] > 0 && cb->white_neighbors8[m + BOTTOM] > 0)) {
-                    return 0;
-                }
-            }
-
-            return (4 - on4) * 4 + 4;
-        } else {
-            if (on4 < 2 && on8 == on4 + 3) {
-                /*
-                Bulky five or rabbity six
-                */
-                u8 near_corner = 0;
-
-                if (!border_left[m] && cb->p[m + LEFT] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + LEFT] + out_neighbors4[m + LEFT];
-
-                    if (n4 == 2) {
-                        ++near_corner;
-
-                        if (cb->white_neighbors8[m + LEFT] > 0) {
-                            return 0;
-                        }
-                        if (cb->black_neighbors8[m + LEFT] + out_neighbors8[m + LEFT] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + LEFT] == 0 && cb->white_neighbors8[m + LEFT] > 1) ||
-                            (out_neighbors4[m + LEFT] > 0 && cb->white_neighbors8[m + LEFT] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_right[m] && cb->p[m + RIGHT] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + RIGHT] + out_neighbors4[m + RIGHT];
-
-                    if (n4 == 2) {
-                        ++near_corner;
-
-                        if (cb->white_neighbors8[m + RIGHT] > 0) {
-                            return 0;
-                        }
-                        if (cb->black_neighbors8[m + RIGHT] + out_neighbors8[m + RIGHT] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + RIGHT] == 0 && cb->white_neighbors8[m + RIGHT] > 1) ||
-                            (out_neighbors4[m + RIGHT] > 0 && cb->white_neighbors8[m + RIGHT] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_top[m] && cb->p[m + TOP] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + TOP] + out_neighbors4[m + TOP];
-
-                    if (n4 == 2) {
-                        if (near_corner == 2) {
-                            return 0;
-                        }
-                        ++near_corner;
-
-                        if (cb->white_neighbors8[m + TOP] > 0) {
-                            return 0;
-                        }
-                        if (cb->black_neighbors8[m + TOP] + out_neighbors8[m + TOP] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + TOP] == 0 && cb->white_neighbors8[m + TOP] > 1) ||
-                            (out_neighbors4[m + TOP] > 0 && cb->white_neighbors8[m + TOP] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_bottom[m] && cb->p[m + BOTTOM] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + BOTTOM] + out_neighbors4[m + BOTTOM];
-
-                    if (n4 == 2) {
-                        if (near_corner == 2) {
-                            return 0;
-                        }
-
-                        ++near_corner;
-
-                        if (cb->white_neighbors8[m + BOTTOM] > 0) {
-                            return 0;
-                        }
-                        if (cb->black_neighbors8[m + BOTTOM] + out_neighbors8[m + BOTTOM] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + BOTTOM] == 0 && cb->white_neighbors8[m + BOTTOM] > 1) ||
-                            (out_neighbors4[m + BOTTOM] > 0 && cb->white_neighbors8[m + BOTTOM] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
+    const u8 * side_table = (shape & NAKADE_BLACK) ? black_nakade_side : white_nakade_side;
+    u8 side[4];
+    u8 sides = 0;
 
-                if (near_corner != 2) {
-                    return 0;
-                }
+    if (((code >> 12) & 3) == EMPTY) {
+        side[sides++] = side_table[cb->hash[m + LEFT]];
+    }
+    if (((code >> 2) & 3) == EMPTY) {
+        side[sides++] = side_table[cb->hash[m + RIGHT]];
+    }
+    if (((code >> 8) & 3) == EMPTY) {
+        side[sides++] = side_table[cb->hash[m + TOP]];
+    }
+    if (((code >> 6) & 3) == EMPTY) {
+        side[sides++] = side_table[cb->hash[m + BOTTOM]];
+    }
 
-                return (5 - on4) * 5;
+    if ((shape & NAKADE_BULKY) == 0) {
+        /*
+        Straight three, bent three, pyramid four or crossed five
+        */
+        for (u8 i = 0; i < sides; ++i) {
+            if ((side[i] & NAKADE_SIDE_EDGE) == 0) {
+                return 0;
             }
         }
     } else {
-        u8 on4 = cb->white_neighbors4[m] + out_neighbors4[m];
-        u8 on8 = cb->white_neighbors8[m] + out_neighbors8[m];
-
-        if ((on4 < 3) && (on8 == on4 + 4)) {
-            /*
-            Straight three, bent three, pyramid four or crossed five
-            */
-            if (!border_left[m] && cb->p[m + LEFT] == EMPTY) {
-                if (cb->white_neighbors4[m + LEFT] + out_neighbors4[m + LEFT] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + LEFT] == 0 && cb->black_neighbors8[m + LEFT] > 1) ||
-                    (out_neighbors4[m + LEFT] > 0 && cb->black_neighbors8[m + LEFT] > 0)) {
-                    return 0;
-                }
+        /*
+        Bulky five or rabbity six
+        */
+        u8 near_corner = 0;
+
+        for (u8 i = 0; i < sides; ++i) {
+            if (side[i] & NAKADE_SIDE_CORNER) {
+                ++near_corner;
+            } else if ((side[i] & NAKADE_SIDE_EDGE) == 0) {
+                return 0;
             }
+        }
 
-            if (!border_right[m] && cb->p[m + RIGHT] == EMPTY) {
-                if (cb->white_neighbors4[m + RIGHT] + out_neighbors4[m + RIGHT] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + RIGHT] == 0 && cb->black_neighbors8[m + RIGHT] > 1) ||
-                    (out_neighbors4[m + RIGHT] > 0 && cb->black_neighbors8[m + RIGHT] > 0)) {
-                    return 0;
-                }
-            }
-
-            if (!border_top[m] && cb->p[m + TOP] == EMPTY) {
-                if (cb->white_neighbors4[m + TOP] + out_neighbors4[m + TOP] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + TOP] == 0 && cb->black_neighbors8[m + TOP] > 1) ||
-                    (out_neighbors4[m + TOP] > 0 && cb->black_neighbors8[m + TOP] > 0)) {
-                    return 0;
-                }
-            }
-
-            if (!border_bottom[m] && cb->p[m + BOTTOM] == EMPTY) {
-                if (cb->white_neighbors4[m + BOTTOM] + out_neighbors4[m + BOTTOM] != 3) {
-                    return 0;
-                }
-                if ((out_neighbors4[m + BOTTOM] == 0 && cb->black_neighbors8[m + BOTTOM] > 1) ||
-                    (out_neighbors4[m + BOTTOM] > 0 && cb->black_neighbors8[m + BOTTOM] > 0)) {
-                    return 0;
-                }
-            }
-
-            return (4 - on4) * 4 + 4;
-        } else {
-            if (on4 < 2 && on8 == on4 + 3) {
-                /*
-                Bulky five or rabbity six
-                */
-                u8 near_corner = 0;
-                if (!border_left[m] && cb->p[m + LEFT] == EMPTY) {
-                    u8 n4 = cb->white_neighbors4[m + LEFT] + out_neighbors4[m + LEFT];
-
-                    if (n4 == 2) {
-                        ++near_corner;
-
-                        if (cb->black_neighbors8[m + LEFT] > 0) {
-                            return 0;
-                        }
-                        if (cb->white_neighbors8[m + LEFT] + out_neighbors8[m + LEFT] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + LEFT] == 0 && cb->black_neighbors8[m + LEFT] > 1) ||
-                            (out_neighbors4[m + LEFT] > 0 && cb->black_neighbors8[m + LEFT] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_right[m] && cb->p[m + RIGHT] == EMPTY) {
-                    u8 n4 = cb->white_neighbors4[m + RIGHT] + out_neighbors4[m + RIGHT];
-
-                    if (n4 == 2) {
-                        ++near_corner;
-
-                        if (cb->black_neighbors8[m + RIGHT] > 0) {
-                            return 0;
-                        }
-                        if (cb->white_neighbors8[m + RIGHT] + out_neighbors8[m + RIGHT] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + RIGHT] == 0 && cb->black_neighbors8[m + RIGHT] > 1) ||
-                            (out_neighbors4[m + RIGHT] > 0 && cb->black_neighbors8[m + RIGHT] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_top[m] && cb->p[m + TOP] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + TOP] + out_neighbors4[m + TOP];
-
-                    if (n4 == 2) {
-                        if (near_corner == 2) {
-                            return 0;
-                        }
-
-                        ++near_corner;
-
-                        if (cb->black_neighbors8[m + TOP] > 0) {
-                            return 0;
-                        }
-                        if (cb->white_neighbors8[m + TOP] + out_neighbors8[m + TOP] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + TOP] == 0 && cb->black_neighbors8[m + TOP] > 1) ||
-                            (out_neighbors4[m + TOP] > 0 && cb->black_neighbors8[m + TOP] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (!border_bottom[m] && cb->p[m + BOTTOM] == EMPTY) {
-                    u8 n4 = cb->black_neighbors4[m + BOTTOM] + out_neighbors4[m + BOTTOM];
-
-                    if (n4 == 2) {
-                        if (near_corner == 2) {
-                            return 0;
-                        }
-
-                        ++near_corner;
-
-                        if (cb->black_neighbors8[m + BOTTOM] > 0) {
-                            return 0;
-                        }
-                        if (cb->white_neighbors8[m + BOTTOM] + out_neighbors8[m + BOTTOM] != 4) {
-                            return 0;
-                        }
-                    } else {
-                        if (n4 != 3) {
-                            return 0;
-                        }
-                        if ((out_neighbors4[m + BOTTOM] == 0 && cb->black_neighbors8[m + BOTTOM] > 1) ||
-                            (out_neighbors4[m + BOTTOM] > 0 && cb->black_neighbors8[m + BOTTOM] > 0)) {
-                            return 0;
-                        }
-                    }
-                }
-
-                if (near_corner != 2) {
-                    return 0;
-                }
-
-                return (5 - on4) * 5;
-            }
+        if (near_corner != 2) {
+            return 0;
         }
     }
-    return 0;
+
+    return shape & NAKADE_SIZE_MASK;
 }
 
 /*
@@ -820,19 +545,249 @@ void mark_near_pos(
 
     group * g = cb->g[m];
     if (g != NULL) {
-        u8 libs = g->liberties;
+        for (u8 i = 0; i < LIB_BITMAP_SIZ; ++i) {
+            u64 word = g->ls[i];
 
-        for (move n = g->liberties_min_coord; libs > 0; ++n) {
-            u8 mask = (1 << (n % 8));
-
-            if (g->ls[n / 8] & mask) {
-                near_pos[n] = true;
-                --libs;
+            while (word) {
+                near_pos[i * 64 + __builtin_ctzll(word)] = true;
+                word &= word - 1;
             }
         }
     }
 }
 
+/*
+Tactical reading cache
+
+Results of the 1-2 liberty solvers are memoized in a direct-mapped table,
+protected by striped locks. The entry key is the Zobrist hash of the stones of
+the group being read, the kind of query and the current ko point. While reading,
+the bounding rectangle of every point that could have influenced the result --
+the stones of the groups inspected and the intersections played or tested -- is
+kept per thread. That rectangle, grown by one intersection for the liberties, is
+saved with the Zobrist hash of its contents; a lookup only hits if the region is
+unchanged on the new board.
+*/
+#define TACT_CACHE_SIZ (1 << 16)
+#define TACT_CACHE_LOCKS 64
+#define TACT_CACHE_MAX_PLAYS 8
+
+#define TACT_KILLING_PLAY 0
+#define TACT_KILLING_ALL 1
+#define TACT_SAVING_PLAY 2
+#define TACT_SAVING_ALL 3
+
+typedef struct __tact_entry_ {
+    u64 key;
+    u64 region_hash;
+    u8 x0;
+    u8 y0;
+    u8 x1;
+    u8 y1;
+    u8 plays_count;
+    move plays[TACT_CACHE_MAX_PLAYS];
+} tact_entry;
+
+static const u64 tact_kind_salt[4] = {
+    0x9e3779b97f4a7c15ULL,
+    0xbf58476d1ce4e5b9ULL,
+    0x94d049bb133111ebULL,
+    0xd6e8feb86659fd93ULL
+};
+
+static bool tact_cache_inited = false;
+static tact_entry tact_cache[TACT_CACHE_SIZ];
+static omp_lock_t tact_cache_locks[TACT_CACHE_LOCKS];
+static __thread u64 tact_cache_hits = 0;
+static __thread u64 tact_cache_misses = 0;
+
+/* bounding rectangle of the points read, per thread: x0, y0, x1, y1 */
+static __thread u8 read_box[4];
+
+/*
+Initiate the tactical reading cache. Until it is called the tactical functions
+work without it.
+*/
+void tactical_cache_init() {
+    if (tact_cache_inited) {
+        return;
+    }
+
+    zobrist_init();
+    memset(tact_cache, 0, sizeof(tact_cache));
+
+    for (u16 i = 0; i < TACT_CACHE_LOCKS; ++i) {
+        omp_init_lock(&tact_cache_locks[i]);
+    }
+
+    tact_cache_inited = true;
+}
+
+/*
+Reads the tactical reading cache counters of the calling thread.
+*/
+void tactical_cache_stats(
+    u64 * hits,
+    u64 * misses
+) {
+    *hits = tact_cache_hits;
+    *misses = tact_cache_misses;
+}
+
+/*
+Resets the tactical reading cache counters of the calling thread.
+*/
+void tactical_cache_reset_stats() {
+    tact_cache_hits = 0;
+    tact_cache_misses = 0;
+}
+
+static void read_extend(
+    move m
+) {
+    u8 * box = read_box;
+    u8 x;
+    u8 y;
+    move_to_coord(m, &x, &y);
+
+    if (x < box[0]) {
+        box[0] = x;
+    }
+    if (y < box[1]) {
+        box[1] = y;
+    }
+    if (x > box[2]) {
+        box[2] = x;
+    }
+    if (y > box[3]) {
+        box[3] = y;
+    }
+}
+
+static void read_extend_group(
+    const cfg_board * cb,
+    const group * g
+) {
+    move m = g->first_stone;
+    do {
+        read_extend(m);
+        m = cb->next_stone[m];
+    } while (m != g->first_stone);
+}
+
+/*
+Marks an intersection about to be tested or played, including the groups that
+decide whether the play is legal and what it captures.
+*/
+static void read_touch(
+    const cfg_board * cb,
+    move m
+) {
+    read_extend(m);
+
+    for (u8 k = 0; k < neighbors_side[m].count; ++k) {
+        move n = neighbors_side[m].coord[k];
+        if (cb->g[n] != NULL) {
+            read_extend_group(cb, cb->g[n]);
+        }
+    }
+}
+
+static void read_start(
+    const cfg_board * cb,
+    const group * g
+) {
+    u8 * box = read_box;
+    box[0] = BOARD_SIZ - 1;
+    box[1] = BOARD_SIZ - 1;
+    box[2] = 0;
+    box[3] = 0;
+    read_extend_group(cb, g);
+}
+
+static u64 tact_cache_key(
+    const cfg_board * cb,
+    const group * g,
+    u8 kind
+) {
+    u64 ret = tact_kind_salt[kind];
+
+    move m = g->first_stone;
+    do {
+        zobrist_update_hash(&ret, m, g->is_black ? BLACK_STONE : WHITE_STONE);
+        m = cb->next_stone[m];
+    } while (m != g->first_stone);
+
+    move ko = get_ko_play(cb);
+    ret ^= ((u64)ko + 1) * 0xff51afd7ed558ccdULL;
+    return ret;
+}
+
+/*
+RETURNS true if a valid result was found, with the plays copied to the plays
+array at index plays_count, increasing it
+*/
+static bool tact_cache_get(
+    const cfg_board * cb,
+    u64 key,
+    u16 * plays_count,
+    move * plays
+) {
+    if (!tact_cache_inited) {
+        return false;
+    }
+
+    u32 idx = key & (TACT_CACHE_SIZ - 1);
+    omp_lock_t * lock = &tact_cache_locks[idx % TACT_CACHE_LOCKS];
+    tact_entry e;
+
+    omp_set_lock(lock);
+    memcpy(&e, &tact_cache[idx], sizeof(tact_entry));
+    omp_unset_lock(lock);
+
+    if (e.key != key || e.region_hash != zobrist_region_hash(cb->p, e.x0, e.y0,
+        e.x1, e.y1)) {
+        tact_cache_misses++;
+        return false;
+    }
+
+    tact_cache_hits++;
+    for (u8 k = 0; k < e.plays_count; ++k) {
+        plays[*plays_count] = e.plays[k];
+        (*plays_count)++;
+    }
+    return true;
+}
+
+static void tact_cache_put(
+    const cfg_board * cb,
+    u64 key,
+    u16 plays_count,
+    const move * plays
+) {
+    if (!tact_cache_inited || plays_count > TACT_CACHE_MAX_PLAYS) {
+        return;
+    }
+
+    const u8 * box = read_box;
+    tact_entry e;
+    e.key = key;
+    e.x0 = box[0] > 0 ? box[0] - 1 : 0;
+    e.y0 = box[1] > 0 ? box[1] - 1 : 0;
+    e.x1 = box[2] < BOARD_SIZ - 1 ? box[2] + 1 : BOARD_SIZ - 1;
+    e.y1 = box[3] < BOARD_SIZ - 1 ? box[3] + 1 : BOARD_SIZ - 1;
+    e.region_hash = zobrist_region_hash(cb->p, e.x0, e.y0, e.x1, e.y1);
+    e.plays_count = plays_count;
+    memcpy(e.plays, plays, plays_count * sizeof(move));
+
+    u32 idx = key & (TACT_CACHE_SIZ - 1);
+    omp_lock_t * lock = &tact_cache_locks[idx % TACT_CACHE_LOCKS];
+
+    omp_set_lock(lock);
+    memcpy(&tact_cache[idx], &e, sizeof(tact_entry));
+    omp_unset_lock(lock);
+}
+
 static bool can_be_killed2(
     cfg_board * b,
     move om,
@@ -840,6 +795,30 @@ static bool can_be_killed2(
     u32 depth
 );
 
+static move read_killing_play(
+    const cfg_board * cb,
+    const group * g
+);
+
+static void read_killing_plays(
+    const cfg_board * cb,
+    const group * g,
+    u16 * plays_count,
+    move * plays
+);
+
+static move read_saving_play(
+    const cfg_board * cb,
+    const group * g
+);
+
+static void read_saving_plays(
+    const cfg_board * cb,
+    const group * g,
+    u16 * plays_count,
+    move * plays
+);
+
 /*
 Attempt attack on group with 1 or 2 liberties.
 */
@@ -850,6 +829,7 @@ static bool can_be_killed3(
     u32 depth
 ) {
     group * g = cb->g[om];
+    read_extend_group(cb, g);
 
     if (g->liberties < 2) {
         return true;
@@ -864,6 +844,7 @@ static bool can_be_killed3(
     }
 
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, is_black, m)) {
         cfg_board tmp;
         cfg_board_clone(&tmp, cb);
@@ -878,6 +859,7 @@ static bool can_be_killed3(
     }
 
     m = get_next_liberty(g, m);
+    read_touch(cb, m);
     if (can_play(cb, is_black, m)) {
         just_play(cb, is_black, m);
 
@@ -899,6 +881,7 @@ static bool can_be_killed2(
     u32 depth
 ) {
     group * g = cb->g[om];
+    read_extend_group(cb, g);
 
     if (g->liberties > 2) {
         return false;
@@ -913,10 +896,13 @@ static bool can_be_killed2(
     /* try a capture if possible */
     for (u16 k = 0; k < g->neighbors_count; ++k) {
         group * n = cb->g[g->neighbors[k]];
+        read_extend_group(cb, n);
 
         if (n->liberties == 1 && !groups_share_liberties(g, n)) {
             move m = get_1st_liberty(n);
 
+            read_touch(cb, m);
+
             if (can_play(cb, is_black, m)) {
                 cfg_board_clone(&tmp, cb);
                 just_play(&tmp, is_black, m);
@@ -933,6 +919,7 @@ static bool can_be_killed2(
 
     /* try 1st liberty */
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, is_black, m);
@@ -948,6 +935,8 @@ static bool can_be_killed2(
     if (g->liberties == 2) {
         m = get_next_liberty(g, m);
 
+        read_touch(cb, m);
+
         if (can_play(cb, is_black, m)) {
             cfg_board_clone(&tmp, cb);
             just_play(&tmp, is_black, m);
@@ -987,15 +976,33 @@ move get_killing_play(
         return NONE;
     }
 
+    u64 key = tact_cache_key(cb, g, TACT_KILLING_PLAY);
+    u16 plays_count = 0;
+    move play;
+    if (tact_cache_get(cb, key, &plays_count, &play)) {
+        return plays_count > 0 ? play : NONE;
+    }
+
+    read_start(cb, g);
+    play = read_killing_play(cb, g);
+    tact_cache_put(cb, key, play == NONE ? 0 : 1, &play);
+    return play;
+}
+
+static move read_killing_play(
+    const cfg_board * cb,
+    const group * g
+) {
     cfg_board tmp;
 
     /* attempt attack group */
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, !g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, !g->is_black, m);
 
-        if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+        if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
             cfg_board_free(&tmp);
             return m;
         }
@@ -1004,11 +1011,12 @@ move get_killing_play(
     }
 
     m = get_next_liberty(g, m);
+    read_touch(cb, m);
     if (can_play(cb, !g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, !g->is_black, m);
 
-        if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+        if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
             cfg_board_free(&tmp);
             return m;
         }
@@ -1018,11 +1026,12 @@ move get_killing_play(
 
     if (g->liberties == 3) {
         m = get_next_liberty(g, m);
+        read_touch(cb, m);
         if (can_play(cb, !g->is_black, m)) {
             cfg_board_clone(&tmp, cb);
             just_play(&tmp, !g->is_black, m);
 
-            if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+            if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
                 cfg_board_free(&tmp);
                 return m;
             }
@@ -1061,15 +1070,33 @@ void can_be_killed_all(
         return;
     }
 
+    u64 key = tact_cache_key(cb, g, TACT_KILLING_ALL);
+    if (tact_cache_get(cb, key, plays_count, plays)) {
+        return;
+    }
+
+    u16 first = *plays_count;
+    read_start(cb, g);
+    read_killing_plays(cb, g, plays_count, plays);
+    tact_cache_put(cb, key, *plays_count - first, plays + first);
+}
+
+static void read_killing_plays(
+    const cfg_board * cb,
+    const group * g,
+    u16 * plays_count,
+    move * plays
+) {
     cfg_board tmp;
 
     /* attempt attack group */
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, !g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, !g->is_black, m);
 
-        if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+        if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
             plays[*plays_count] = m;
             (*plays_count)++;
         }
@@ -1078,11 +1105,12 @@ void can_be_killed_all(
     }
 
     m = get_next_liberty(g, m);
+    read_touch(cb, m);
     if (can_play(cb, !g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, !g->is_black, m);
 
-        if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+        if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
             plays[*plays_count] = m;
             (*plays_count)++;
         }
@@ -1092,11 +1120,12 @@ void can_be_killed_all(
 
     if (g->liberties == 3) {
         m = get_next_liberty(g, m);
+        read_touch(cb, m);
         if (can_play(cb, !g->is_black, m)) {
             cfg_board_clone(&tmp, cb);
             just_play(&tmp, !g->is_black, m);
 
-            if (can_be_killed2(&tmp, g->stones.coord[0], g->is_black, 0)) {
+            if (can_be_killed2(&tmp, g->first_stone, g->is_black, 0)) {
                 plays[*plays_count] = m;
                 (*plays_count)++;
             }
@@ -1115,21 +1144,41 @@ RETURNS  play that saves the group from being killed, or NONE
 move get_saving_play(
     const cfg_board * cb,
     const group * g
+) {
+    u64 key = tact_cache_key(cb, g, TACT_SAVING_PLAY);
+    u16 plays_count = 0;
+    move play;
+    if (tact_cache_get(cb, key, &plays_count, &play)) {
+        return plays_count > 0 ? play : NONE;
+    }
+
+    read_start(cb, g);
+    play = read_saving_play(cb, g);
+    tact_cache_put(cb, key, play == NONE ? 0 : 1, &play);
+    return play;
+}
+
+static move read_saving_play(
+    const cfg_board * cb,
+    const group * g
 ) {
     cfg_board tmp;
 
     /* try a capture if possible */
     for (u16 k = 0; k < g->neighbors_count; ++k) {
         group * n = cb->g[g->neighbors[k]];
+        read_extend_group(cb, n);
 
         if (n->liberties == 1 && !groups_share_liberties(g, n)) {
             move m = get_1st_liberty(n);
 
+            read_touch(cb, m);
+
             if (can_play(cb, g->is_black, m)) {
                 cfg_board_clone(&tmp, cb);
                 just_play(&tmp, g->is_black, m);
 
-                if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+                if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                     cfg_board_free(&tmp);
                     return m;
                 }
@@ -1141,11 +1190,12 @@ move get_saving_play(
 
     /* attempt defend group */
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, g->is_black, m);
 
-        if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+        if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
             cfg_board_free(&tmp);
             return m;
         }
@@ -1155,11 +1205,12 @@ move get_saving_play(
 
     if (g->liberties > 1) {
         m = get_next_liberty(g, m);
+        read_touch(cb, m);
         if (can_play(cb, g->is_black, m)) {
             cfg_board_clone(&tmp, cb);
             just_play(&tmp, g->is_black, m);
 
-            if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+            if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                 cfg_board_free(&tmp);
                 return m;
             }
@@ -1169,11 +1220,12 @@ move get_saving_play(
 
         if (g->liberties > 2) {
             m = get_next_liberty(g, m);
+            read_touch(cb, m);
             if (can_play(cb, g->is_black, m)) {
                 cfg_board_clone(&tmp, cb);
                 just_play(&tmp, g->is_black, m);
 
-                if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+                if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                     cfg_board_free(&tmp);
                     return m;
                 }
@@ -1217,19 +1269,38 @@ void can_be_saved_all(
         return;
     }
 
+    u64 key = tact_cache_key(cb, g, TACT_SAVING_ALL);
+    if (tact_cache_get(cb, key, plays_count, plays)) {
+        return;
+    }
+
+    u16 first = *plays_count;
+    read_start(cb, g);
+    read_saving_plays(cb, g, plays_count, plays);
+    tact_cache_put(cb, key, *plays_count - first, plays + first);
+}
+
+static void read_saving_plays(
+    const cfg_board * cb,
+    const group * g,
+    u16 * plays_count,
+    move * plays
+) {
     cfg_board tmp;
 
     /* try a capture if possible */
     for (u16 k = 0; k < g->neighbors_count; ++k) {
         group * n = cb->g[g->neighbors[k]];
+        read_extend_group(cb, n);
 
         if (n->liberties == 1 && !groups_share_liberties(g, n)) {
             move m = get_1st_liberty(n);
+            read_touch(cb, m);
             if (can_play(cb, g->is_black, m)) {
                 cfg_board_clone(&tmp, cb);
                 just_play(&tmp, g->is_black, m);
 
-                if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+                if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                     plays[*plays_count] = m;
                     (*plays_count)++;
                 }
@@ -1241,11 +1312,12 @@ void can_be_saved_all(
 
     /* attempt defend group */
     move m = get_1st_liberty(g);
+    read_touch(cb, m);
     if (can_play(cb, g->is_black, m)) {
         cfg_board_clone(&tmp, cb);
         just_play(&tmp, g->is_black, m);
 
-        if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+        if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
             plays[*plays_count] = m;
             (*plays_count)++;
         }
@@ -1255,11 +1327,12 @@ void can_be_saved_all(
 
     if (g->liberties > 1) {
         m = get_next_liberty(g, m);
+        read_touch(cb, m);
         if (can_play(cb, g->is_black, m)) {
             cfg_board_clone(&tmp, cb);
             just_play(&tmp, g->is_black, m);
 
-            if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+            if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                 plays[*plays_count] = m;
                 (*plays_count)++;
             }
@@ -1269,11 +1342,12 @@ void can_be_saved_all(
 
         if (g->liberties > 2) {
             m = get_next_liberty(g, m);
+            read_touch(cb, m);
             if (can_play(cb, g->is_black, m)) {
                 cfg_board_clone(&tmp, cb);
                 just_play(&tmp, g->is_black, m);
 
-                if (!can_be_killed3(&tmp, g->stones.coord[0], !g->is_black, 0)) {
+                if (!can_be_killed3(&tmp, g->first_stone, !g->is_black, 0)) {
                     plays[*plays_count] = m;
                     (*plays_count)++;
                 }
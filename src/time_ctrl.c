@@ -11,14 +11,22 @@ say anything. All times are in milliseconds.
 
 #include "alloc.h"
 #include "board.h"
+#include "flog.h"
 #include "stringm.h"
 #include "time_ctrl.h"
 #include "types.h"
 
 
+/*
+Running estimate of the effective latency, in milliseconds; starts at the
+constant LATENCY_COMPENSATION until plays are measured.
+*/
+static latency_estimator latency = { LATENCY_COMPENSATION, 0 };
+
+
 /*
 Calculate the time available based on a Canadian byo-yomi time system. Also
-compensates for network latency.
+compensates for the network latency estimated.
 RETURNS time available in milliseconds
 */
 u32 calc_time_to_play(
@@ -49,11 +57,142 @@ u32 calc_time_to_play(
     /*
     Network lag correction
     */
-    t_t -= LATENCY_COMPENSATION;
+    t_t -= latency_compensation();
 
     return (u32)MAX(t_t, 50);
 }
 
+/*
+Calculate the maximum time that may be used for a play, if the search is
+extended beyond the time given by calc_time_to_play. It is limited to a
+fraction of the main time remaining, or otherwise to the byo-yomi time per
+stone. Also compensates for network latency.
+RETURNS maximum time available in milliseconds
+*/
+u32 calc_max_time_to_play(
+    time_system * ts,
+    u16 turns_played
+) {
+    u32 t = calc_time_to_play(ts, turns_played);
+    if (t == UINT32_MAX) {
+        return t;
+    }
+
+    double limit = ts->main_time_remaining / TIME_MAX_MAIN_FRACTION;
+    if (ts->byo_yomi_stones_remaining > 0) {
+        double byt = ts->byo_yomi_time_remaining / ((double)ts->byo_yomi_stones_remaining);
+        limit = MAX(limit, byt);
+    }
+
+    limit = MIN(limit - latency_compensation(), t * TIME_MAX_EXTENSION);
+
+    return (u32)MAX(limit, t);
+}
+
+/*
+RETURNS the current estimate of the effective latency in milliseconds
+*/
+u32 latency_compensation() {
+    return (u32)MAX(latency.estimate + 0.5, 0.0);
+}
+
+/*
+RETURNS the number of plays the latency estimate is based on
+*/
+u32 latency_sample_count() {
+    return latency.samples;
+}
+
+/*
+Reset the latency estimate to the constant LATENCY_COMPENSATION.
+*/
+void reset_latency_estimate() {
+    latency.estimate = LATENCY_COMPENSATION;
+    latency.samples = 0;
+}
+
+/*
+Copies the latency estimate in use, for example to keep one per connection.
+*/
+void get_latency_estimator(
+    latency_estimator * dst
+) {
+    *dst = latency;
+}
+
+/*
+Replaces the latency estimate in use.
+*/
+void set_latency_estimator(
+    const latency_estimator * src
+) {
+    latency = *src;
+}
+
+/*
+Forget the clock reports of a player, for example when the time system changes.
+*/
+void latency_probe_reset(
+    latency_probe * lp
+) {
+    lp->synced = false;
+    lp->measuring = false;
+}
+
+/*
+Mark that a play was answered after thinking for think_time milliseconds, as
+measured locally since the command was started. It is measured only if the
+clock of the player was reported before the play.
+*/
+void latency_play_answered(
+    latency_probe * lp,
+    u32 think_time
+) {
+    lp->measuring = lp->synced;
+    lp->synced = false;
+    lp->think_time = think_time;
+}
+
+/*
+Update the clock of a player with a time_left report from the server. If a play
+was answered since the previous report, the time the server charged for it over
+the think time measured locally is folded into the latency estimate.
+
+Samples can be negative, since reports in whole seconds are truncated; they are
+kept so that the average is not biased.
+*/
+void latency_clock_reported(
+    latency_probe * lp,
+    u32 time_remaining,
+    u32 stones_remaining
+) {
+    /*
+    Only compare reports in the same period: both in main time, or in the same
+    byo-yomi period with one stone played.
+    */
+    if (lp->measuring && time_remaining <= lp->time_remaining &&
+        ((stones_remaining == 0 && lp->stones_remaining == 0) ||
+        (stones_remaining > 0 && stones_remaining + 1 == lp->stones_remaining))) {
+        d32 sample = (d32)(lp->time_remaining - time_remaining) - (d32)lp->think_time;
+        sample = MAX(MIN(sample, LATENCY_MAX_SAMPLE), -LATENCY_MAX_SAMPLE);
+
+        latency.samples++;
+        double w = MAX(1.0 / latency.samples, LATENCY_SMOOTHING);
+        latency.estimate = latency.estimate * (1.0 - w) + sample * w;
+
+        char * s = alloc();
+        snprintf(s, MAX_PAGE_SIZ, "latency sample %d ms; estimate %u ms\n",
+            sample, latency_compensation());
+        flog_info("time", s);
+        release(s);
+    }
+
+    lp->synced = true;
+    lp->measuring = false;
+    lp->time_remaining = time_remaining;
+    lp->stones_remaining = stones_remaining;
+}
+
 /*
 Set the complete Canadian byo-yomi time system.
 */
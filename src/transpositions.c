@@ -5,6 +5,9 @@ Doesn't assume states are in reduced form. States contain full information and
 are compared after the hash (collisions are impossible). Zobrist hashing with 64
 bits is used. Clean-up is available only between turns or between games.
 
+The states are tagged with an owner, so that several games can share the table;
+each owner may be limited to a quota of the states.
+
 Please note there is no separate 'UCT state information' file. It is mostly
 interweaved with the transpositions table.
 
@@ -33,50 +36,140 @@ table color.
 u16 expansion_delay = UCT_EXPANSION_DELAY;
 u64 max_size_in_mbs = DEFAULT_UCT_MEMORY;
 
-static u32 max_allocated_states;
-static u32 number_of_buckets;
+/*
+A table, with the states of both colors. Each thread uses the table selected
+with tt_select, or the table initialized by tt_init by default.
+*/
+struct __tt_table_ {
+    u32 max_allocated_states;
+    u32 number_of_buckets;
+
+    u32 allocated_states;
+    u32 states_in_use;
+
+    omp_lock_t b_table_lock;
+    omp_lock_t w_table_lock;
+    tt_stats ** b_stats_table;
+    tt_stats ** w_stats_table;
 
-static u32 allocated_states = 0;
-static u32 states_in_use = 0;
+    omp_lock_t freed_nodes_lock;
+    tt_stats * freed_nodes;
 
-static omp_lock_t b_table_lock;
-static omp_lock_t w_table_lock;
-static tt_stats ** b_stats_table = NULL;
-static tt_stats ** w_stats_table = NULL;
+    /* values used to mark items for deletion, per owner, since each owner
+    cleans its states independently; will cycle eventually but its not a big
+    deal */
+    u8 maintenance_mark[256];
 
-static omp_lock_t freed_nodes_lock;
-static tt_stats * freed_nodes = NULL;
+    u8 owner;
+    u32 owner_states_in_use[256];
+    u32 owner_quota[256];
+};
 
-/* value used to mark items for deletion; will cycle eventually but its not a
-big deal */
-static u8 maintenance_mark = 0;
+static tt_table default_table;
+static __thread tt_table * tt = &default_table;
 
 
+static void table_init(
+    tt_table * t,
+    u64 mbs
+) {
+    mbs *= 1048576;
+
+    t->max_allocated_states = mbs / sizeof(tt_stats);
+    t->number_of_buckets = get_prime_near(t->max_allocated_states / 2);
+
+    for (u16 i = 0; i < 256; ++i) {
+        t->owner_quota[i] = t->max_allocated_states;
+    }
+
+    t->b_stats_table = calloc(t->number_of_buckets, sizeof(tt_stats *));
+    if (t->b_stats_table == NULL) {
+        flog_crit("tt", "system out of memory");
+    }
+
+    t->w_stats_table = calloc(t->number_of_buckets, sizeof(tt_stats *));
+    if (t->w_stats_table == NULL) {
+        flog_crit("tt", "system out of memory");
+    }
+
+    omp_init_lock(&t->b_table_lock);
+    omp_init_lock(&t->w_table_lock);
+    omp_init_lock(&t->freed_nodes_lock);
+}
+
 /*
 Initialize the transpositions table structures.
 */
 void tt_init() {
-    if (b_stats_table == NULL) {
-        u64 mbs = max_size_in_mbs;
-        mbs *= 1048576;
+    if (default_table.b_stats_table == NULL) {
+        table_init(&default_table, max_size_in_mbs);
+    }
+}
 
-        max_allocated_states = mbs / sizeof(tt_stats);
-        number_of_buckets = get_prime_near(max_allocated_states / 2);
+/*
+Creates a separate transpositions table, with mbs MiB of memory.
+RETURNS the new table
+*/
+tt_table * tt_create(
+    u64 mbs
+) {
+    tt_table * t = calloc(1, sizeof(tt_table));
+    if (t == NULL) {
+        flog_crit("tt", "system out of memory");
+    }
 
-        b_stats_table = calloc(number_of_buckets, sizeof(tt_stats *));
-        if (b_stats_table == NULL) {
-            flog_crit("tt", "system out of memory");
-        }
+    table_init(t, mbs);
+    return t;
+}
 
-        w_stats_table = calloc(number_of_buckets, sizeof(tt_stats *));
-        if (w_stats_table == NULL) {
-            flog_crit("tt", "system out of memory");
-        }
+static void free_states(
+    tt_stats * s
+) {
+    while (s != NULL) {
+        tt_stats * tmp = s->next;
+        omp_destroy_lock(&s->lock);
+        free(s);
+        s = tmp;
+    }
+}
 
-        omp_init_lock(&b_table_lock);
-        omp_init_lock(&w_table_lock);
-        omp_init_lock(&freed_nodes_lock);
+/*
+Frees a table created with tt_create, and all its states. The table must not be
+selected by any thread.
+*/
+void tt_destroy(
+    tt_table * t
+) {
+    for (u32 i = 0; i < t->number_of_buckets; ++i) {
+        free_states(t->b_stats_table[i]);
+        free_states(t->w_stats_table[i]);
     }
+
+    free_states(t->freed_nodes);
+    free(t->b_stats_table);
+    free(t->w_stats_table);
+    omp_destroy_lock(&t->b_table_lock);
+    omp_destroy_lock(&t->w_table_lock);
+    omp_destroy_lock(&t->freed_nodes_lock);
+    free(t);
+}
+
+/*
+Selects the table used by the calling thread, or with NULL the table initialized
+by tt_init. Threads that take part in a search must select the same table.
+*/
+void tt_select(
+    tt_table * t
+) {
+    tt = (t == NULL) ? &default_table : t;
+}
+
+/*
+RETURNS the table selected by the calling thread, or NULL for the table
+initialized by tt_init
+*/
+tt_table * tt_selected() {
+    return (tt == &default_table) ? NULL : tt;
 }
 
 
@@ -96,20 +189,20 @@ static tt_stats * find_state(
     const board * b,
     bool is_black
 ) {
-    u32 key = fast_bucket(hash, number_of_buckets);
+    u32 key = fast_bucket(hash, tt->number_of_buckets);
     tt_stats * p;
 
     if (is_black) {
-        p = b_stats_table[key];
+        p = tt->b_stats_table[key];
     } else {
-        p = w_stats_table[key];
+        p = tt->w_stats_table[key];
     }
 
     move last_eaten_passed = (b->last_played == PASS) ? PASS : b->last_eaten;
 
     while (p != NULL) {
-        if (p->zobrist_hash == hash && memcmp(p->p, b->p, TOTAL_BOARD_SIZ) == 0 &&
-            p->last_eaten_passed == last_eaten_passed) {
+        if (p->zobrist_hash == hash && p->owner == tt->owner && memcmp(p->p, b->p,
+            TOTAL_BOARD_SIZ) == 0 && p->last_eaten_passed == last_eaten_passed) {
             return p;
         }
 
@@ -124,20 +217,20 @@ static tt_stats * find_state2(
     const cfg_board * cb,
     bool is_black
 ) {
-    u32 key = fast_bucket(hash, number_of_buckets);
+    u32 key = fast_bucket(hash, tt->number_of_buckets);
     tt_stats * p;
 
     if (is_black) {
-        p = b_stats_table[key];
+        p = tt->b_stats_table[key];
     } else {
-        p = w_stats_table[key];
+        p = tt->w_stats_table[key];
     }
 
     move last_eaten_passed = (cb->last_played == PASS) ? PASS : cb->last_eaten;
 
     while (p != NULL) {
-        if (p->zobrist_hash == hash && memcmp(p->p, cb->p, TOTAL_BOARD_SIZ) == 0 &&
-            p->last_eaten_passed == last_eaten_passed) {
+        if (p->zobrist_hash == hash && p->owner == tt->owner && memcmp(p->p, cb->p,
+            TOTAL_BOARD_SIZ) == 0 && p->last_eaten_passed == last_eaten_passed) {
             return p;
         }
 
@@ -152,17 +245,18 @@ static tt_stats * create_state(
 ) {
     tt_stats * ret = NULL;
 
-    omp_set_lock(&freed_nodes_lock);
+    omp_set_lock(&tt->freed_nodes_lock);
 
-    if (freed_nodes != NULL) {
-        ret = freed_nodes;
-        freed_nodes = freed_nodes->next;
+    if (tt->freed_nodes != NULL) {
+        ret = tt->freed_nodes;
+        tt->freed_nodes = tt->freed_nodes->next;
     } else {
-        ++allocated_states;
+        ++tt->allocated_states;
     }
 
-    ++states_in_use;
-    omp_unset_lock(&freed_nodes_lock);
+    ++tt->states_in_use;
+    ++tt->owner_states_in_use[tt->owner];
+    omp_unset_lock(&tt->freed_nodes_lock);
 
     if (ret == NULL) {
         ret = malloc(sizeof(tt_stats));
@@ -176,7 +270,8 @@ static tt_stats * create_state(
 
     /* careful that some fields are not initialized here */
     ret->zobrist_hash = hash;
-    ret->maintenance_mark = maintenance_mark;
+    ret->maintenance_mark = tt->maintenance_mark[tt->owner];
+    ret->owner = tt->owner;
     ret->plays_count = 0;
     ret->expansion_delay = expansion_delay;
     return ret;
@@ -185,26 +280,40 @@ static tt_stats * create_state(
 static void release_state(
     tt_stats * s
 ) {
-    --states_in_use;
-    s->next = freed_nodes;
-    freed_nodes = s;
+    --tt->states_in_use;
+    --tt->owner_states_in_use[s->owner];
+    s->next = tt->freed_nodes;
+    tt->freed_nodes = s;
 }
 
-static void release_states_not_marked() {
-    for (u32 i = 0; i < number_of_buckets; ++i) {
+/*
+RETURNS whether a state of the current owner is to be released: all of them, or
+only those not marked for keeping
+*/
+static bool releasable(
+    const tt_stats * s,
+    bool all
+) {
+    return s->owner == tt->owner && (all || s->maintenance_mark != tt->maintenance_mark[tt->owner]);
+}
+
+static void release_states(
+    bool all
+) {
+    for (u32 i = 0; i < tt->number_of_buckets; ++i) {
         /* black table */
-        while (b_stats_table[i] != NULL && b_stats_table[i]->maintenance_mark != maintenance_mark) {
-            tt_stats * tmp = b_stats_table[i]->next;
-            release_state(b_stats_table[i]);
-            b_stats_table[i] = tmp;
+        while (tt->b_stats_table[i] != NULL && releasable(tt->b_stats_table[i], all)) {
+            tt_stats * tmp = tt->b_stats_table[i]->next;
+            release_state(tt->b_stats_table[i]);
+            tt->b_stats_table[i] = tmp;
         }
 
-        if (b_stats_table[i] != NULL) {
-            tt_stats * prev = b_stats_table[i];
+        if (tt->b_stats_table[i] != NULL) {
+            tt_stats * prev = tt->b_stats_table[i];
             tt_stats * curr = prev->next;
 
             while (curr != NULL) {
-                if (curr->maintenance_mark != maintenance_mark) {
+                if (releasable(curr, all)) {
                     tt_stats * tmp = curr->next;
                     release_state(curr);
                     prev->next = tmp;
@@ -217,19 +326,18 @@ static void release_states_not_marked() {
         }
 
         /* white table */
-        while (w_stats_table[i] != NULL && w_stats_table[i]->maintenance_mark !=
-            maintenance_mark) {
-            tt_stats * tmp = w_stats_table[i]->next;
-            release_state(w_stats_table[i]);
-            w_stats_table[i] = tmp;
+        while (tt->w_stats_table[i] != NULL && releasable(tt->w_stats_table[i], all)) {
+            tt_stats * tmp = tt->w_stats_table[i]->next;
+            release_state(tt->w_stats_table[i]);
+            tt->w_stats_table[i] = tmp;
         }
 
-        if (w_stats_table[i] != NULL) {
-            tt_stats * prev = w_stats_table[i];
+        if (tt->w_stats_table[i] != NULL) {
+            tt_stats * prev = tt->w_stats_table[i];
             tt_stats * curr = prev->next;
 
             while (curr != NULL) {
-                if (curr->maintenance_mark != maintenance_mark) {
+                if (releasable(curr, all)) {
                     tt_stats * tmp = curr->next;
                     release_state(curr);
                     prev->next = tmp;
@@ -246,12 +354,12 @@ static void release_states_not_marked() {
 static void mark_states_for_keeping(
     tt_stats * s
 ) {
-    s->maintenance_mark = maintenance_mark;
+    s->maintenance_mark = tt->maintenance_mark[tt->owner];
 
     for (move i = 0; i < s->plays_count; ++i) {
         tt_stats * ns = s->plays[i].next_stats;
 
-        if (ns != NULL && ns->maintenance_mark != maintenance_mark) {
+        if (ns != NULL && ns->maintenance_mark != tt->maintenance_mark[tt->owner]) {
             mark_states_for_keeping(ns);
         }
     }
@@ -266,19 +374,19 @@ u32 tt_clean_unreachable(
     bool is_black
 ) {
     u64 hash = zobrist_new_hash(b);
-    u32 states_in_use_before = states_in_use;
+    u32 states_in_use_before = tt->states_in_use;
     tt_stats * stats = find_state(hash, b, is_black);
 
     if (stats == NULL) { /* free all */
         tt_clean_all();
     } else {
         /* free outside tree */
-        ++maintenance_mark;
+        ++tt->maintenance_mark[tt->owner];
         mark_states_for_keeping(stats);
-        release_states_not_marked();
+        release_states(false);
     }
 
-    d32 states_released = states_in_use_before - states_in_use;
+    d32 states_released = states_in_use_before - tt->states_in_use;
     assert(states_released >= 0);
     return states_released;
 }
@@ -295,14 +403,15 @@ tt_stats * tt_lookup_create(
     bool is_black,
     u64 hash
 ) {
-    u32 key = fast_bucket(hash, number_of_buckets);
-    omp_lock_t * bucket_lock = is_black ? &b_table_lock : &w_table_lock;
+    u32 key = fast_bucket(hash, tt->number_of_buckets);
+    omp_lock_t * bucket_lock = is_black ? &tt->b_table_lock : &tt->w_table_lock;
 
     omp_set_lock(bucket_lock);
 
     tt_stats * ret = find_state(hash, b, is_black);
     if (ret == NULL) { /* doesnt exist */
-        if (states_in_use >= max_allocated_states) {
+        if (tt->states_in_use >= tt->max_allocated_states ||
+            tt->owner_states_in_use[tt->owner] >= tt->owner_quota[tt->owner]) {
             /*
             It is possible in theory for a complex ko to produce a situation
             where freeing the game tree that is not reachable doesn't free any
@@ -323,11 +432,11 @@ tt_stats * tt_lookup_create(
         omp_set_lock(&ret->lock);
 
         if (is_black) {
-            ret->next = b_stats_table[key];
-            b_stats_table[key] = ret;
+            ret->next = tt->b_stats_table[key];
+            tt->b_stats_table[key] = ret;
         } else {
-            ret->next = w_stats_table[key];
-            w_stats_table[key] = ret;
+            ret->next = tt->w_stats_table[key];
+            tt->w_stats_table[key] = ret;
         }
 
         omp_unset_lock(bucket_lock);
@@ -351,14 +460,15 @@ tt_stats * tt_lookup_null(
     bool is_black,
     u64 hash
 ) {
-    u32 key = fast_bucket(hash, number_of_buckets);
-    omp_lock_t * bucket_lock = is_black ? &b_table_lock : &w_table_lock;
+    u32 key = fast_bucket(hash, tt->number_of_buckets);
+    omp_lock_t * bucket_lock = is_black ? &tt->b_table_lock : &tt->w_table_lock;
 
     omp_set_lock(bucket_lock);
 
     tt_stats * ret = find_state2(hash, cb, is_black);
     if (ret == NULL) { /* doesnt exist */
-        if (states_in_use >= max_allocated_states) {
+        if (tt->states_in_use >= tt->max_allocated_states ||
+            tt->owner_states_in_use[tt->owner] >= tt->owner_quota[tt->owner]) {
             omp_unset_lock(bucket_lock);
             return NULL;
         }
@@ -369,11 +479,11 @@ tt_stats * tt_lookup_null(
         omp_set_lock(&ret->lock);
 
         if (is_black) {
-            ret->next = b_stats_table[key];
-            b_stats_table[key] = ret;
+            ret->next = tt->b_stats_table[key];
+            tt->b_stats_table[key] = ret;
         } else {
-            ret->next = w_stats_table[key];
-            w_stats_table[key] = ret;
+            ret->next = tt->w_stats_table[key];
+            tt->w_stats_table[key] = ret;
         }
 
         omp_unset_lock(bucket_lock);
@@ -387,33 +497,51 @@ tt_stats * tt_lookup_null(
 }
 
 /*
-Frees all game states and resets counters.
+Frees all game states of the current owner and resets counters.
 */
 u32 tt_clean_all() {
-    u32 states_in_use_before = states_in_use;
-    maintenance_mark = 0;
-
-    for (u32 i = 0; i < number_of_buckets; ++i) {
-        /* black table */
-        while (b_stats_table[i] != NULL) {
-            tt_stats * tmp = b_stats_table[i]->next;
-            release_state(b_stats_table[i]);
-            b_stats_table[i] = tmp;
-        }
+    u32 states_in_use_before = tt->states_in_use;
+    /* every state of the owner is freed, so its mark can start over */
+    tt->maintenance_mark[tt->owner] = 0;
 
-        /* white table */
-        while (w_stats_table[i] != NULL) {
-            tt_stats * tmp = w_stats_table[i]->next;
-            release_state(w_stats_table[i]);
-            w_stats_table[i] = tmp;
-        }
-    }
+    release_states(true);
 
-    d32 states_released = states_in_use_before - states_in_use;
+    d32 states_released = states_in_use_before - tt->states_in_use;
     assert(states_released >= 0);
     return states_released;
 }
 
+/*
+Selects the owner of the states looked up, created and freed from now on. States
+of other owners are never found nor freed, so several games can share the table
+without mixing their statistics. The owner 0 is used by default. Not
+thread-safe; should only be changed between searches.
+*/
+void tt_set_owner(
+    u8 new_owner
+) {
+    tt->owner = new_owner;
+}
+
+/*
+Limits the number of states an owner may have in use, beyond which the search
+stops expanding new states like when the table is full. By default every owner
+may use the whole table.
+*/
+void tt_set_quota(
+    u8 quota_owner,
+    u32 max_states
+) {
+    tt->owner_quota[quota_owner] = max_states;
+}
+
+/*
+RETURNS the maximum number of states that fit in the table
+*/
+u32 tt_max_states() {
+    return tt->max_allocated_states;
+}
+
 /*
 Mostly for debugging -- log the current memory status of the transpositions
 table to stderr and log file.
@@ -422,11 +550,12 @@ void tt_log_status() {
     char * buf = alloc();
     u32 idx = snprintf(buf, MAX_PAGE_SIZ, "\n*** Transpositions table trace start ***\n\n");
     idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Max size in MiB: %" PRIu64 "\n", max_size_in_mbs);
-    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Max allocated states: %u\n", max_allocated_states);
-    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Allocated states: %u\n", allocated_states);
-    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "States in use: %u\n", states_in_use);
-    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Number of buckets: %u\n", number_of_buckets);
-    snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Maintenance mark: %u\n", maintenance_mark);
+    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Max allocated states: %u\n", tt->max_allocated_states);
+    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Allocated states: %u\n", tt->allocated_states);
+    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "States in use: %u\n", tt->states_in_use);
+    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Owner %u states in use: %u/%u\n", tt->owner, tt->owner_states_in_use[tt->owner], tt->owner_quota[tt->owner]);
+    idx += snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Number of buckets: %u\n", tt->number_of_buckets);
+    snprintf(buf + idx, MAX_PAGE_SIZ - idx, "Maintenance mark: %u\n", tt->maintenance_mark[tt->owner]);
 
     flog_warn("tt", buf);
     release(buf);
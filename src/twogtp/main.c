@@ -2,11 +2,14 @@
 Simple "twogtp" implementation - a program that pits two GTP-speaking programs
 against each other, using a third one as referee in case of game end by
 consecutive draws.
+Several games can be played at the same time, each by its own set of programs,
+optionally pinned to a set of CPUs. A running Elo estimate is printed after each
+game and, with --sprt, the match stops as soon as a sequential probability ratio
+test decides it.
 Please see the example scritps in the root folder twogtp/ on how to use this.
 */
 
-#define _POSIX_C_SOURCE 199309L
-#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE /* for sched_setaffinity and pipe2 */
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -15,18 +18,68 @@ Please see the example scritps in the root folder twogtp/ on how to use this.
 #include <unistd.h>
 #include <signal.h>
 #include <math.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
 
-static void open_program(const char * command, int cpipe[]) {
+#define MAX_CONCURRENCY 64
+
+/* play_game outcome when the programs stopped answering */
+#define GAME_ABORTED 2
+
+typedef struct __slot_ {
+  int id;
+  int black_player_pipe[3];
+  int white_player_pipe[3];
+  int referee_pipe[3];
+} slot;
+
+static char * black_player = NULL;
+static char * white_player = NULL;
+static char * referee = NULL;
+static int board_size = 19;
+static int komi = 15;
+static int alternate = 0;
+static int games = 1;
+static int concurrency = 1;
+static int cpus_per_game = 0; /* 0 for no CPU affinity */
+
+static int use_sprt = 0;
+static double sprt_elo0 = 0.0;
+static double sprt_elo1 = 5.0;
+static double sprt_alpha = 0.05;
+static double sprt_beta = 0.05;
+
+static pthread_mutex_t match_lock = PTHREAD_MUTEX_INITIALIZER;
+static int games_started = 0;
+static int stopping = 0;
+static const char * sprt_result = NULL;
+static int wins = 0;
+static int draws = 0;
+static int losses = 0;
+static slot slots[MAX_CONCURRENCY];
+
+
+static void open_program(const char * command, int cpipe[], int slot_id) {
   int parent_to_child[2], child_to_parent[2];
 
-  pipe(parent_to_child);
-  pipe(child_to_parent);
+  /* close on exec, so that programs of other slots do not hold them open */
+  pipe2(parent_to_child, O_CLOEXEC);
+  pipe2(child_to_parent, O_CLOEXEC);
   pid_t pid = fork();
 
   if (pid == 0) { // child process
-    close(parent_to_child[1]);
+    if (cpus_per_game > 0) {
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int i = 0; i < cpus_per_game; ++i) {
+        CPU_SET((slot_id * cpus_per_game + i) % cpus, &set);
+      }
+      sched_setaffinity(0, sizeof(cpu_set_t), &set);
+    }
+
     dup2(parent_to_child[0], STDIN_FILENO);
-    close(child_to_parent[0]);
     dup2(child_to_parent[1], STDOUT_FILENO);
     execl("/bin/sh", "sh", "-c", command, NULL);
     perror("execl");
@@ -41,9 +94,20 @@ static void open_program(const char * command, int cpipe[]) {
   cpipe[2] = pid;
 }
 
+static void close_program(int cpipe[]) {
+  kill(cpipe[2], SIGKILL);
+  close(cpipe[0]);
+  close(cpipe[1]);
+}
+
+/*
+RETURNS the response, or NULL if the program stopped answering
+*/
 static char * send_command(const int cpipe[2], const char * message, char * resp_buffer) {
   snprintf(resp_buffer, 1024, "%s\n", message);
-  write(cpipe[1], resp_buffer, strlen(resp_buffer));
+  if (write(cpipe[1], resp_buffer, strlen(resp_buffer)) < 0) {
+    return NULL;
+  }
 
   int rtotal = 0;
   while (1) {
@@ -56,6 +120,8 @@ static char * send_command(const int cpipe[2], const char * message, char * resp
           break;
         }
       }
+    } else if (r == 0 || rtotal == 1024) {
+      return NULL;
     }
 
     usleep(50000);
@@ -67,12 +133,15 @@ static char * send_command(const int cpipe[2], const char * message, char * resp
   return resp_buffer;
 }
 
+#define SEND(PIPE, MESSAGE) \
+  if ((resp = send_command(PIPE, MESSAGE, buffer)) == NULL) { \
+    return GAME_ABORTED; \
+  }
+
 static int play_game(
   int black_player_pipe[2],
   int white_player_pipe[2],
   int referee_pipe[2],
-  int board_size,
-  int komi,
   int * turns
 ) {
   char buffer[1024];
@@ -80,20 +149,20 @@ static int play_game(
   char * resp;
 
   snprintf(buffer2, 1060, "boardsize %d", board_size);
-  send_command(black_player_pipe, buffer2, buffer);
-  send_command(white_player_pipe, buffer2, buffer);
-  send_command(referee_pipe, buffer2, buffer);
+  SEND(black_player_pipe, buffer2);
+  SEND(white_player_pipe, buffer2);
+  SEND(referee_pipe, buffer2);
   if ((komi % 2) == 1) {
     snprintf(buffer2, 1060, "komi %d.5", komi / 2);
   } else {
     snprintf(buffer2, 1060, "komi %d", komi / 2);
   }
-  send_command(black_player_pipe, buffer2, buffer);
-  send_command(white_player_pipe, buffer2, buffer);
-  send_command(referee_pipe, buffer2, buffer);
-  send_command(black_player_pipe, "clear_board", buffer);
-  send_command(white_player_pipe, "clear_board", buffer);
-  send_command(referee_pipe, "clear_board", buffer);
+  SEND(black_player_pipe, buffer2);
+  SEND(white_player_pipe, buffer2);
+  SEND(referee_pipe, buffer2);
+  SEND(black_player_pipe, "clear_board");
+  SEND(white_player_pipe, "clear_board");
+  SEND(referee_pipe, "clear_board");
 
   int last_move_pass = 0;
   int max_turns = board_size * board_size * 2;
@@ -107,14 +176,14 @@ static int play_game(
     }
 
     (*turns)++;
-    resp = send_command(black_player_pipe, "genmove black", buffer);
+    SEND(black_player_pipe, "genmove black");
 
     if (strcmp(resp, "resign") == 0) {
       return -1;
     }
     if (strcmp(resp, "pass") == 0) {
       if (last_move_pass) {
-        send_command(referee_pipe, "play black pass", buffer);
+        SEND(referee_pipe, "play black pass");
         break;
       } else {
         last_move_pass = 1;
@@ -123,18 +192,18 @@ static int play_game(
       last_move_pass = 0;
     }
     snprintf(buffer2, 1060, "play black %s", resp);
-    send_command(white_player_pipe, buffer2, buffer);
-    send_command(referee_pipe, buffer2, buffer);
+    SEND(white_player_pipe, buffer2);
+    SEND(referee_pipe, buffer2);
 
     (*turns)++;
-    resp = send_command(white_player_pipe, "genmove white", buffer);
+    SEND(white_player_pipe, "genmove white");
 
     if (strcmp(resp, "resign") == 0) {
       return 1;
     }
     if (strcmp(resp, "pass") == 0) {
       if (last_move_pass) {
-        send_command(referee_pipe, "play white pass", buffer);
+        SEND(referee_pipe, "play white pass");
         break;
       } else {
         last_move_pass = 1;
@@ -142,12 +211,12 @@ static int play_game(
     } else {
       last_move_pass = 0;
     }
-    snprintf(buffer2, 1060, "play white %s", buffer + 2);
-    send_command(black_player_pipe, buffer2, buffer);
-    send_command(referee_pipe, buffer2, buffer);
+    snprintf(buffer2, 1060, "play white %s", resp);
+    SEND(black_player_pipe, buffer2);
+    SEND(referee_pipe, buffer2);
   }
 
-  resp = send_command(referee_pipe, "final_score", buffer);
+  SEND(referee_pipe, "final_score");
   if (resp[0] == 'B' || resp[0] == 'b') {
     return 1;
   }
@@ -157,15 +226,163 @@ static int play_game(
   return 0;
 }
 
-int main(int argc, char * argv[]) {
-  char * black_player = NULL;
-  char * white_player = NULL;
-  char * referee = NULL;
-  int board_size = 19;
-  int komi = 15;
-  int alternate = 0;
-  int games = 1;
+/*
+Expected score of a player with an Elo advantage.
+*/
+static double elo_to_score(double elo) {
+  return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+static double score_to_elo(double score) {
+  return -400.0 * log10(1.0 / score - 1.0);
+}
+
+/*
+Elo difference of player A and its 95% confidence interval, from the score and
+its variance per game.
+*/
+static void elo_estimate(double * elo, double * margin) {
+  int n = wins + draws + losses;
+  double score = (wins + draws / 2.0) / n;
+  double var = (wins * pow(1.0 - score, 2.0) + draws * pow(0.5 - score, 2.0) +
+    losses * pow(score, 2.0)) / n;
+
+  if (score <= 0.0 || score >= 1.0 || var == 0.0) {
+    *elo = score <= 0.0 ? -INFINITY : (score >= 1.0 ? INFINITY : 0.0);
+    *margin = INFINITY;
+    return;
+  }
+
+  double delta = 1.96 * sqrt(var / n);
+  *elo = score_to_elo(score);
+  *margin = (score_to_elo(fmin(score + delta, 0.999)) -
+    score_to_elo(fmax(score - delta, 0.001))) / 2.0;
+}
+
+/*
+Log-likelihood ratio of the hypothesis that player A is sprt_elo1 stronger over
+that it is sprt_elo0 stronger, with the normal approximation of the game scores
+(generalized SPRT). One virtual draw is added so that the variance is never
+zero, as with one sided results.
+*/
+static double sprt_llr() {
+  double d = draws + 1.0;
+  double n = wins + d + losses;
+  double score = (wins + d / 2.0) / n;
+  double var = (wins * pow(1.0 - score, 2.0) + d * pow(0.5 - score, 2.0) +
+    losses * pow(score, 2.0)) / n;
+
+  double s0 = elo_to_score(sprt_elo0);
+  double s1 = elo_to_score(sprt_elo1);
+  return n * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * var);
+}
+
+/*
+Records the outcome of a game for player A and tests whether the match is
+decided. Should be called with the match lock held.
+*/
+static void record_result(int result) {
+  if (result > 0) {
+    wins++;
+  } else if (result < 0) {
+    losses++;
+  } else {
+    draws++;
+  }
+
+  double elo;
+  double margin;
+  elo_estimate(&elo, &margin);
+  printf("Score: +%d =%d -%d, Elo %.1f +- %.1f", wins, draws, losses, elo, margin);
+
+  if (use_sprt) {
+    double llr = sprt_llr();
+    double lower = log(sprt_beta / (1.0 - sprt_alpha));
+    double upper = log((1.0 - sprt_beta) / sprt_alpha);
+    printf(", LLR %.2f [%.2f, %.2f]", llr, lower, upper);
+
+    if (sprt_result == NULL && llr >= upper) {
+      sprt_result = "H1 accepted";
+    } else if (sprt_result == NULL && llr <= lower) {
+      sprt_result = "H0 accepted";
+    }
+
+    if (sprt_result != NULL && !stopping) {
+      stopping = 1;
+      printf(" - SPRT %s, stopping", sprt_result);
+
+      /* abort the games in progress */
+      for (int i = 0; i < concurrency; ++i) {
+        kill(slots[i].black_player_pipe[2], SIGKILL);
+        kill(slots[i].white_player_pipe[2], SIGKILL);
+        kill(slots[i].referee_pipe[2], SIGKILL);
+      }
+    }
+  }
+
+  printf("\n");
+  fflush(stdout);
+}
+
+static void * slot_thread(void * arg) {
+  slot * s = (slot *)arg;
+  char buf[1024];
+
+  while (1) {
+    pthread_mutex_lock(&match_lock);
+    int game = games_started;
+    int stop = stopping || game >= games;
+    if (!stop) {
+      games_started++;
+    }
+    pthread_mutex_unlock(&match_lock);
+
+    if (stop) {
+      break;
+    }
+
+    printf("Starting game %d/%d\n", game + 1, games);
+    fflush(stdout);
 
+    int outcome;
+    int turns;
+    int a_is_black = !(alternate && (game % 2) == 1);
+    if (a_is_black) {
+      outcome = play_game(s->black_player_pipe, s->white_player_pipe, s->referee_pipe, &turns);
+    } else {
+      outcome = play_game(s->white_player_pipe, s->black_player_pipe, s->referee_pipe, &turns);
+    }
+
+    pthread_mutex_lock(&match_lock);
+    if (outcome == GAME_ABORTED) {
+      if (!stopping) {
+        fprintf(stderr, "Game %d aborted: a program stopped answering\n", game + 1);
+        stopping = 1;
+      }
+      pthread_mutex_unlock(&match_lock);
+      break;
+    }
+
+    if (outcome == 0) {
+      printf("Draw after %u turns with player A as %s.\n", turns, a_is_black ? "black" : "white");
+      record_result(0);
+    } else if ((outcome == 1) == a_is_black) {
+      printf("Player A wins after %u turns (playing as %s)\n", turns, a_is_black ? "black" : "white");
+      record_result(1);
+    } else {
+      printf("Player B wins after %u turns (playing as %s)\n", turns, a_is_black ? "white" : "black");
+      record_result(-1);
+    }
+    pthread_mutex_unlock(&match_lock);
+  }
+
+  send_command(s->black_player_pipe, "quit", buf);
+  send_command(s->white_player_pipe, "quit", buf);
+  send_command(s->referee_pipe, "quit", buf);
+  return NULL;
+}
+
+int main(int argc, char * argv[]) {
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--white") == 0 && i < argc - 1) {
       white_player = argv[i + 1];
@@ -213,6 +430,45 @@ int main(int argc, char * argv[]) {
       alternate = 1;
       continue;
     }
+    if (strcmp(argv[i], "--concurrency") == 0 && i < argc - 1) {
+      concurrency = atoi(argv[i + 1]);
+      if (concurrency < 1 || concurrency > MAX_CONCURRENCY) {
+        fprintf(stderr, "Illegal concurrency\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--affinity") == 0 && i < argc - 1) {
+      cpus_per_game = atoi(argv[i + 1]);
+      if (cpus_per_game < 1) {
+        fprintf(stderr, "Illegal number of CPUs per game\n");
+        exit(EXIT_FAILURE);
+      }
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--sprt") == 0 && i < argc - 2) {
+      use_sprt = 1;
+      sprt_elo0 = atof(argv[i + 1]);
+      sprt_elo1 = atof(argv[i + 2]);
+      if (sprt_elo1 <= sprt_elo0) {
+        fprintf(stderr, "Illegal SPRT bounds: elo1 must be greater than elo0\n");
+        exit(EXIT_FAILURE);
+      }
+      i += 2;
+      continue;
+    }
+    if (strcmp(argv[i], "--sprt_error") == 0 && i < argc - 2) {
+      sprt_alpha = atof(argv[i + 1]);
+      sprt_beta = atof(argv[i + 2]);
+      if (sprt_alpha <= 0.0 || sprt_alpha >= 0.5 || sprt_beta <= 0.0 || sprt_beta >= 0.5) {
+        fprintf(stderr, "Illegal SPRT error probabilities\n");
+        exit(EXIT_FAILURE);
+      }
+      i += 2;
+      continue;
+    }
     fprintf(stderr, "Unknown argument %s\n", argv[i]);
     exit(EXIT_FAILURE);
   }
@@ -232,83 +488,48 @@ int main(int argc, char * argv[]) {
     exit(EXIT_FAILURE);
   }
 
-  int black_player_pipe[3];
-  int white_player_pipe[3];
-  int referee_pipe[3];
-
-  open_program(black_player, black_player_pipe);
-  open_program(white_player, white_player_pipe);
-  open_program(referee, referee_pipe);
-  char buf[1024];
-  send_command(black_player_pipe, "version", buf);
-  send_command(white_player_pipe, "version", buf);
-  send_command(referee_pipe, "version", buf);
-
-  int wins = 0;
-  int draws = 0;
-  int losses = 0;
+  if (concurrency > games) {
+    concurrency = games;
+  }
 
-  for (int game = 0; game < games; ++game) {
-    printf("Starting game %d/%d\n", game + 1, games);
+  /* the programs may be killed when the match is decided */
+  signal(SIGPIPE, SIG_IGN);
 
-    int outcome;
-    int turns;
-    if (alternate && (game % 2) == 1) {
-      outcome = play_game(
-        white_player_pipe,
-        black_player_pipe,
-        referee_pipe,
-        board_size,
-        komi,
-        &turns
-      );
-
-      if (outcome == 1) {
-        losses += 1;
-        printf("Player B wins after %u turns (playing as black)\n", turns);
-      } else if (outcome == -1) {
-        wins += 1;
-        printf("Player A wins after %u turns (playing as white)\n", turns);
-      } else {
-        draws += 1;
-        printf("Draw after %u turns with player A as white.\n", turns);
-      }
-    } else {
-      outcome = play_game(
-        black_player_pipe,
-        white_player_pipe,
-        referee_pipe,
-        board_size,
-        komi,
-        &turns
-      );
-
-      if (outcome == 1) {
-        wins += 1;
-        printf("Player A wins after %u turns (playing as black)\n", turns);
-      } else if (outcome == -1) {
-        losses += 1;
-        printf("Player B wins after %u turns (playing as white)\n", turns);
-      } else {
-        draws += 1;
-        printf("Draw after %u turns with player A as black.\n", turns);
-      }
-    }
+  char buf[1024];
+  for (int i = 0; i < concurrency; ++i) {
+    slot * s = &slots[i];
+    s->id = i;
+    open_program(black_player, s->black_player_pipe, i);
+    open_program(white_player, s->white_player_pipe, i);
+    open_program(referee, s->referee_pipe, i);
+    send_command(s->black_player_pipe, "version", buf);
+    send_command(s->white_player_pipe, "version", buf);
+    send_command(s->referee_pipe, "version", buf);
   }
 
-  send_command(black_player_pipe, "quit", buf);
-  send_command(white_player_pipe, "quit", buf);
-  send_command(referee_pipe, "quit", buf);
+  pthread_t threads[MAX_CONCURRENCY];
+  for (int i = 0; i < concurrency; ++i) {
+    pthread_create(&threads[i], NULL, slot_thread, &slots[i]);
+  }
 
-  kill(black_player_pipe[2], SIGKILL);
-  kill(white_player_pipe[2], SIGKILL);
-  kill(referee_pipe[2], SIGKILL);
+  for (int i = 0; i < concurrency; ++i) {
+    pthread_join(threads[i], NULL);
+    close_program(slots[i].black_player_pipe);
+    close_program(slots[i].white_player_pipe);
+    close_program(slots[i].referee_pipe);
+  }
 
-  if ((komi % 2) == 0) {
+  if (wins + losses == 0) {
+    printf("Finished - no decisive games with %d draws\n", draws);
+  } else if ((komi % 2) == 0) {
     printf("Finished - player A winrate: %d%% with %d draws\n", (int)round(wins * 100 / (wins + losses)), draws);
   } else {
     printf("Finished - player A winrate: %d%%\n", (int)round(wins * 100 / (wins + losses)));
   }
 
+  if (use_sprt) {
+    printf("SPRT(%.1f, %.1f): %s\n", sprt_elo0, sprt_elo1, sprt_result != NULL ? sprt_result : "undecided");
+  }
+
   return EXIT_SUCCESS;
 }
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
 #include <omp.h>
 
 #include "alloc.h"
@@ -15,17 +17,23 @@
 #include "mcts.h"
 #include "opening_book.h"
 #include "pat3.h"
+#include "pat5.h"
 #include "pts_file.h"
 #include "randg.h"
 #include "random_play.h"
+#include "ring_queue.h"
+#include "scoring.h"
 #include "state_changes.h"
 #include "tactical.h"
+#include "time_manager.h"
+#include "time_ctrl.h"
 #include "timem.h"
+#include "transpositions.h"
 #include "types.h"
 #include "zobrist.h"
 
+extern __thread d16 komi;
 
-extern u16 iv_3x3[TOTAL_BOARD_SIZ][TOTAL_BOARD_SIZ][3];
 
 static char _ts[MAX_PAGE_SIZ];
 static char * _timestamp() {
@@ -84,12 +92,24 @@ static void test_cfg_board() {
             just_play(&cb, is_black, m);
             massert(cfg_board_are_equal(&cb, &b), "just_play");
 
+            for (move n = 0; n < TOTAL_BOARD_SIZ; ++n) {
+                if (b.p[n] == EMPTY) {
+                    u8 v[3][3];
+                    pat3_transpose(v, b.p, n);
+                    massert(cb.hash[n] == pat3_to_string((const u8 (*)[3])v), "3x3 hash");
+#if USE_PAT5_HASH
+                    massert(cb.pat5_hash[n] == pat5_hash_slow(b.p, n), "5x5 diamond hash");
+#endif
+                }
+            }
+
             bool stones_cap[TOTAL_BOARD_SIZ];
             memset(stones_cap, 0, TOTAL_BOARD_SIZ);
-            u8 tmp4[LIB_BITMAP_SIZ];
+            u64 tmp4[LIB_BITMAP_SIZ];
             d16 stone_diff2 = 0;
-            just_play3(&sb3, is_black, m, &stone_diff2, stones_cap, tmp4);
+            move captures3 = just_play3(&sb3, is_black, m, &stone_diff2, stones_cap, tmp4);
             massert(cfg_board_are_equal(&sb3, &b), "just_play3");
+            massert(abs(stone_diff2) == 1 + captures3, "just_play3 captures");
 
             cfg_board_free(&sb2);
             cfg_board_free(&sb3);
@@ -193,6 +213,8 @@ static void test_pattern() {
     clear_board(&b);
     cfg_board cb;
     cfg_board sb2;
+    u16 codes[4096];
+    u32 codes_count = 0;
 
     for (u32 tries = 0; tries < 50; ++tries) {
         bool is_black = true;
@@ -213,6 +235,7 @@ static void test_pattern() {
                 }
 
                 u16 hash_cfg = cb.hash[m];
+                codes[codes_count++ % 4096] = hash_cfg;
                 pat3_transpose(v, cb.p, m);
                 u16 hash_pat3 = pat3_to_string((const u8(*)[3])v);
                 massert(hash_cfg == hash_pat3, "CFG from play and pat3 patterns 1");
@@ -229,6 +252,109 @@ static void test_pattern() {
         cfg_board_free(&cb);
     }
 
+    /* White lookups match the color inverted patterns */
+    for (u32 i = 0; i < 65536; ++i) {
+        string_to_pat3(v, i);
+        pat3_invert(v);
+        u16 inv = pat3_to_string((const u8(*)[3])v);
+        massert(pat3_find(i, true) == pat3_find(inv, false), "3x3 pattern colors swap");
+    }
+
+    u64 weights = 0;
+    u64 t = current_time_in_millis();
+    for (u32 k = 0; k < 1000; ++k) {
+        for (u32 i = 0; i < 4096; ++i) {
+            weights += pat3_find(codes[i], true);
+            weights += pat3_find(codes[i], false);
+        }
+    }
+    u64 t2 = current_time_in_millis();
+    massert(weights > 0, "3x3 pattern lookups");
+
+    fprintf(stderr, " passed (%" PRIu64 "M lookups/s)\n", (u64)(8192 / MAX(t2 - t, 1)));
+}
+
+/*
+Places the 5x5 diamond pattern, indexed by [y][x], around m after applying the
+symmetry, with the colors swapped if invert.
+*/
+static void place_pat5(
+    board * b,
+    move m,
+    const u8 pat[static 5][5],
+    u8 symmetry,
+    bool invert
+) {
+    u8 x;
+    u8 y;
+    move_to_coord(m, &x, &y);
+
+    for (d8 dy = -2; dy <= 2; ++dy) {
+        for (d8 dx = -2; dx <= 2; ++dx) {
+            if (abs(dx) + abs(dy) > 2 || (dx == 0 && dy == 0)) {
+                continue;
+            }
+
+            d8 tx = (symmetry & 1) ? dy : dx;
+            d8 ty = (symmetry & 1) ? dx : dy;
+            if (symmetry & 2) {
+                tx = -tx;
+            }
+            if (symmetry & 4) {
+                ty = -ty;
+            }
+
+            u8 c = pat[dy + 2][dx + 2];
+            if (invert && c != EMPTY) {
+                c = (c == BLACK_STONE) ? WHITE_STONE : BLACK_STONE;
+            }
+
+            b->p[coord_to_move(x + tx, y + ty)] = c;
+        }
+    }
+}
+
+static void test_pat5() {
+    fprintf(stderr, "%s: 5x5 diamond patterns...", _timestamp());
+
+    /* x is own stone or empty */
+    char text[] = "..O..\n.X...\n....x\n.....\n..... 7\n";
+    u32 size_before = pat5_dictionary_size();
+    massert(pat5_read_patterns(text) == 1, "5x5 pattern read");
+    massert(pat5_dictionary_size() == size_before + 32, "5x5 pattern expansion");
+
+    u8 pat[5][5];
+    memset(pat, EMPTY, sizeof(pat));
+    pat[0][2] = WHITE_STONE;
+    pat[1][1] = BLACK_STONE;
+
+    move m = coord_to_move(BOARD_SIZ / 2, BOARD_SIZ / 2);
+    board b;
+
+    for (u8 option = 0; option < 2; ++option) {
+        pat[2][4] = option ? BLACK_STONE : EMPTY;
+
+        for (u8 s = 0; s < 8; ++s) {
+            clear_board(&b);
+            place_pat5(&b, m, (const u8 (*)[5])pat, s, false);
+            u64 hash = pat5_hash_slow(b.p, m);
+            massert(pat5_find(hash, true) == 7, "5x5 pattern symmetries");
+            massert(pat5_find(hash, false) == 0, "5x5 pattern wrong color");
+
+            clear_board(&b);
+            place_pat5(&b, m, (const u8 (*)[5])pat, s, true);
+            hash = pat5_hash_slow(b.p, m);
+            massert(pat5_find(hash, false) == 7, "5x5 pattern colors swap");
+            massert(pat5_find(hash, true) == 0, "5x5 pattern swapped wrong color");
+        }
+    }
+
+    /* a white stone does not match the own stone or empty wildcard */
+    pat[2][4] = WHITE_STONE;
+    clear_board(&b);
+    place_pat5(&b, m, (const u8 (*)[5])pat, 0, false);
+    massert(pat5_find(pat5_hash_slow(b.p, m), true) == 0, "5x5 pattern wildcard");
+
     fprintf(stderr, " passed\n");
 }
 
@@ -266,6 +392,15 @@ static void test_ladders() {
     cfg_from_board(&cb, &b);
     massert(get_killing_play(&cb, cb.g[coord_to_move(1, 1)]) == coord_to_move(1, 2), "can_be_killed3");
     massert(get_saving_play(&cb, cb.g[coord_to_move(1, 1)]) == NONE, "can_be_saved3");
+
+    /* Repeated reading is answered by the tactical cache */
+    u64 hits1;
+    u64 hits2;
+    u64 misses;
+    tactical_cache_stats(&hits1, &misses);
+    massert(get_saving_play(&cb, cb.g[coord_to_move(1, 1)]) == NONE, "tactical_cache1");
+    tactical_cache_stats(&hits2, &misses);
+    massert(hits2 == hits1 + 1, "tactical_cache2");
     cfg_board_free(&cb);
 
     b.p[coord_to_move(6, 5)] = WHITE_STONE;
@@ -349,6 +484,161 @@ static void test_ladders() {
     fprintf(stderr, " passed\n");
 }
 
+static void test_nakade() {
+    fprintf(stderr, "%s: nakade shapes...", _timestamp());
+    board b;
+    cfg_board cb;
+
+    /*
+    Straight three eye space in the corner
+    */
+    clear_board(&b);
+    b.p[coord_to_move(0, 0)] = BLACK_STONE;
+    b.p[coord_to_move(0, 1)] = BLACK_STONE;
+    b.p[coord_to_move(0, 2)] = BLACK_STONE;
+    b.p[coord_to_move(0, 3)] = BLACK_STONE;
+    b.p[coord_to_move(0, 4)] = BLACK_STONE;
+    b.p[coord_to_move(0, 5)] = WHITE_STONE;
+
+    b.p[coord_to_move(1, 0)] = BLACK_STONE;
+    b.p[coord_to_move(1, 4)] = BLACK_STONE;
+    b.p[coord_to_move(1, 5)] = WHITE_STONE;
+
+    b.p[coord_to_move(2, 0)] = BLACK_STONE;
+    b.p[coord_to_move(2, 1)] = BLACK_STONE;
+    b.p[coord_to_move(2, 2)] = BLACK_STONE;
+    b.p[coord_to_move(2, 3)] = BLACK_STONE;
+    b.p[coord_to_move(2, 4)] = BLACK_STONE;
+    b.p[coord_to_move(2, 5)] = WHITE_STONE;
+
+    b.p[coord_to_move(3, 0)] = WHITE_STONE;
+    b.p[coord_to_move(3, 1)] = WHITE_STONE;
+    b.p[coord_to_move(3, 2)] = WHITE_STONE;
+    b.p[coord_to_move(3, 3)] = WHITE_STONE;
+    b.p[coord_to_move(3, 4)] = WHITE_STONE;
+    b.p[coord_to_move(3, 5)] = WHITE_STONE;
+
+    cfg_from_board(&cb, &b);
+    massert(is_nakade(&cb, coord_to_move(1, 2)) == 12, "is_nakade1");
+    massert(is_nakade(&cb, coord_to_move(1, 1)) == 0, "is_nakade2");
+    cfg_board_free(&cb);
+
+    /* Same shape with the colors swapped */
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        if (b.p[m] != EMPTY) {
+            b.p[m] = b.p[m] == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+        }
+    }
+
+    cfg_from_board(&cb, &b);
+    massert(is_nakade(&cb, coord_to_move(1, 2)) == 12, "is_nakade3");
+    massert(is_nakade(&cb, coord_to_move(1, 1)) == 0, "is_nakade4");
+    cfg_board_free(&cb);
+
+    fprintf(stderr, " passed\n");
+}
+
+/*
+Reference area scoring, by exploring each empty region at a time.
+*/
+static d16 score_stones_and_area_slow(
+    const u8 p[static TOTAL_BOARD_SIZ]
+) {
+    bool explored[TOTAL_BOARD_SIZ];
+    memset(explored, false, TOTAL_BOARD_SIZ);
+    move region[TOTAL_BOARD_SIZ];
+    d16 r = 0;
+
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        if (p[m] == BLACK_STONE) {
+            r += 2;
+        } else if (p[m] == WHITE_STONE) {
+            r -= 2;
+        } else if (!explored[m]) {
+            bool found_black = false;
+            bool found_white = false;
+            u16 region_siz = 0;
+            region[region_siz++] = m;
+            explored[m] = true;
+
+            for (u16 i = 0; i < region_siz; ++i) {
+                u8 x;
+                u8 y;
+                move_to_coord(region[i], &x, &y);
+                move nei[4];
+                u8 nei_siz = 0;
+
+                if (x > 0) {
+                    nei[nei_siz++] = region[i] + LEFT;
+                }
+                if (x < BOARD_SIZ - 1) {
+                    nei[nei_siz++] = region[i] + RIGHT;
+                }
+                if (y > 0) {
+                    nei[nei_siz++] = region[i] + TOP;
+                }
+                if (y < BOARD_SIZ - 1) {
+                    nei[nei_siz++] = region[i] + BOTTOM;
+                }
+
+                for (u8 k = 0; k < nei_siz; ++k) {
+                    move n = nei[k];
+                    if (p[n] == BLACK_STONE) {
+                        found_black = true;
+                    } else if (p[n] == WHITE_STONE) {
+                        found_white = true;
+                    } else if (!explored[n]) {
+                        explored[n] = true;
+                        region[region_siz++] = n;
+                    }
+                }
+            }
+
+            if (found_black != found_white) {
+                r += found_black ? 2 * region_siz : -2 * region_siz;
+            }
+        }
+    }
+
+    return r - komi;
+}
+
+static void test_scoring() {
+    fprintf(stderr, "%s: area scoring...", _timestamp());
+
+    static u8 boards[100][TOTAL_BOARD_SIZ];
+
+    for (u32 tes = 0; tes < 10000; ++tes) {
+        u8 * p = boards[tes % 100];
+        u16 density = rand_u16(100);
+
+        for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+            if (rand_u16(100) < density) {
+                p[m] = rand_u16(2) == 0 ? BLACK_STONE : WHITE_STONE;
+            } else {
+                p[m] = EMPTY;
+            }
+        }
+
+        massert(score_stones_and_area(p) == score_stones_and_area_slow(p), "score_stones_and_area");
+    }
+
+    /* Cost per scoring of the random positions */
+    d32 sum = 0;
+    u64 t = current_time_in_millis();
+    for (u32 i = 0; i < 100000; ++i) {
+        sum += score_stones_and_area(boards[i % 100]);
+    }
+    u64 t2 = current_time_in_millis();
+    for (u32 i = 0; i < 100000; ++i) {
+        sum -= score_stones_and_area_slow(boards[i % 100]);
+    }
+    u64 t3 = current_time_in_millis();
+    massert(sum == 0, "score_stones_and_area (2)");
+
+    fprintf(stderr, " passed (%" PRIu64 "ns per scoring, reference %" PRIu64 "ns)\n", (t2 - t) * 10, (t3 - t2) * 10);
+}
+
 static void test_board() {
     fprintf(stderr, "%s: board reduction and operations...", _timestamp());
 
@@ -539,9 +829,81 @@ static void test_rand_gen() {
         massert(samplesf[i] < 2.4 + 0.0001, "upper limit violation");
     }
     calc_distributionf(2.4);
+
+    printf("%s: rand_mask128(0, 43, 128)\n", _timestamp());
+    u64 bits_set = 0;
+    for (u32 i = 0; i < SAMPLES / 64; ++i) {
+        massert(rand_mask128(0) == 0, "rand_mask128(0)");
+        massert(rand_mask128(128) == ~0ULL, "rand_mask128(128)");
+        bits_set += __builtin_popcountll(rand_mask128(43));
+    }
+    double ratio = ((double)bits_set) / ((double)((SAMPLES / 64) * 64));
+    printf("\ttarget ratio=%f\n\tratio=%f\n", 43.0 / 128.0, ratio);
+    massert(ratio > 43.0 / 128.0 - 0.01 && ratio < 43.0 / 128.0 + 0.01, "rand_mask128 ratio");
     printf("%s: test passed\n", _timestamp());
 }
 
+static void test_ring_queue() {
+    fprintf(stderr, "%s: lock-free ring queue...", _timestamp());
+
+    ring_queue * q = ring_queue_create(5);
+    u32 v;
+
+    massert(!ring_queue_pop(q, &v), "ring_queue empty");
+
+    for (u32 i = 0; i < 8; ++i) {
+        massert(ring_queue_push(q, i), "ring_queue push");
+    }
+    massert(!ring_queue_push(q, 8), "ring_queue full");
+    massert(ring_queue_size(q) == 8, "ring_queue size");
+
+    for (u32 i = 0; i < 8; ++i) {
+        massert(ring_queue_pop(q, &v) && v == i, "ring_queue order");
+    }
+    massert(!ring_queue_pop(q, &v), "ring_queue empty (2)");
+    ring_queue_destroy(q);
+
+    /* Concurrent producers and consumers */
+    q = ring_queue_create(16);
+    u64 pushed_sum = 0;
+    u64 popped_sum = 0;
+    u32 popped = 0;
+
+    #pragma omp parallel num_threads(4)
+    {
+        if (omp_get_thread_num() % 2 == 0) {
+            for (u32 i = 1; i <= 20000; ++i) {
+                while (!ring_queue_push(q, i)) {
+                    sched_yield();
+                }
+
+                #pragma omp atomic
+                pushed_sum += i;
+            }
+        } else {
+            while (true) {
+                u32 p;
+                if (__atomic_load_n(&popped, __ATOMIC_SEQ_CST) >= 40000) {
+                    break;
+                }
+                if (ring_queue_pop(q, &p)) {
+                    #pragma omp atomic
+                    popped_sum += p;
+                    __atomic_add_fetch(&popped, 1, __ATOMIC_SEQ_CST);
+                } else {
+                    sched_yield();
+                }
+            }
+        }
+    }
+
+    massert(pushed_sum == popped_sum, "ring_queue concurrent");
+    massert(ring_queue_size(q) == 0, "ring_queue concurrent size");
+    ring_queue_destroy(q);
+
+    fprintf(stderr, " passed\n");
+}
+
 static void test_time_keeping() {
     fprintf(stderr, "%s: time keeping...", _timestamp());
 
@@ -551,6 +913,64 @@ static void test_time_keeping() {
     massert(t2 >= t + 1000ULL, "lower limit violation");
     massert(t2 <= t + 1010ULL, "upper limit violation");
 
+    tt_stats * root = calloc(1, sizeof(tt_stats));
+    omp_init_lock(&root->lock);
+    root->plays_count = 2;
+    root->plays[0].m = 0;
+    root->plays[0].mc_n = root->plays[0].amaf_n = 100;
+    root->plays[0].mc_q = root->plays[0].amaf_q = 0.6;
+    root->plays[1].m = 1;
+    root->plays[1].mc_n = root->plays[1].amaf_n = 10;
+    root->plays[1].mc_q = root->plays[1].amaf_q = 0.4;
+
+    search_time st;
+    massert(time_manager_set("stable"), "time manager stable");
+    time_manager_start(&st, 0, 1000, 333, 2000);
+    massert(!time_manager_should_stop(&st, root, 500, 50, 50, 100), "visit gap closable");
+    time_manager_start(&st, 0, 1000, 333, 2000);
+    massert(time_manager_should_stop(&st, root, 500, 25, 25, 50), "visit gap unclosable");
+
+    time_manager_start(&st, 0, 1000, 333, 2000);
+    massert(!time_manager_should_stop(&st, root, 100, 50, 50, 10000), "stable start");
+    root->plays[1].mc_n = root->plays[1].amaf_n = 200;
+    root->plays[1].mc_q = root->plays[1].amaf_q = 0.7;
+    massert(!time_manager_should_stop(&st, root, 900, 50, 50, 10000), "best changed");
+    massert(!time_manager_should_stop(&st, root, 1000, 50, 50, 10000), "extension");
+    massert(st.stop_time == 1500, "extension time");
+    massert(time_manager_should_stop(&st, root, 1500, 50, 50, 10000), "extension end");
+
+    massert(time_manager_set("fixed"), "time manager fixed");
+    time_manager_start(&st, 0, 1000, 333, 2000);
+    massert(!time_manager_should_stop(&st, root, 999, 50, 50, 10000), "fixed before time");
+    massert(time_manager_should_stop(&st, root, 1000, 50, 50, 10000), "fixed at time");
+    time_manager_set("stable");
+
+    omp_destroy_lock(&root->lock);
+    free(root);
+
+    latency_probe lp;
+    reset_latency_estimate();
+    latency_probe_reset(&lp);
+    latency_play_answered(&lp, 1000);
+    latency_clock_reported(&lp, 60000, 0);
+    massert(latency_sample_count() == 0, "latency without previous report");
+    latency_play_answered(&lp, 1000);
+    latency_clock_reported(&lp, 58800, 0);
+    massert(latency_compensation() == 200, "latency first sample");
+    latency_play_answered(&lp, 1000);
+    latency_clock_reported(&lp, 30000, 5);
+    massert(latency_sample_count() == 1, "latency across periods");
+    latency_play_answered(&lp, 1000);
+    latency_clock_reported(&lp, 28600, 4);
+    massert(latency_compensation() == 300, "latency second sample");
+    latency_estimator le;
+    get_latency_estimator(&le);
+    reset_latency_estimate();
+    massert(latency_sample_count() == 0, "latency swapped out");
+    set_latency_estimator(&le);
+    massert(latency_compensation() == 300 && latency_sample_count() == 2, "latency swapped in");
+    reset_latency_estimate();
+
     fprintf(stderr, " passed\n");
 }
 
@@ -598,7 +1018,7 @@ static void test_whole_game() {
         u64 stop_time = curr_time + 500;
         u64 early_stop_time = curr_time + 250;
 
-        bool has_play = evaluate_position_timed(&b, is_black, &out_b, stop_time, early_stop_time);
+        bool has_play = evaluate_position_timed(&b, is_black, &out_b, stop_time, early_stop_time, stop_time);
         if (!has_play) {
             break;
         }
@@ -623,6 +1043,71 @@ static void test_whole_game() {
     fprintf(stderr, "%s: test passed\n", _timestamp());
 }
 
+typedef struct __engine_test_ {
+    engine_ctx * ctx;
+    d16 komi;
+    u16 plays;
+    bool komi_kept;
+} engine_test;
+
+static void * engine_test_thread(
+    void * arg
+) {
+    engine_test * t = (engine_test *)arg;
+    game_record gr;
+    clear_game_record(&gr);
+    out_board out_b;
+
+    engine_set_komi(t->ctx, t->komi);
+
+    for (u16 i = 0; i < 6; ++i) {
+        engine_set_position(t->ctx, &gr);
+        if (!engine_search_sims(t->ctx, 1000, &out_b)) {
+            break;
+        }
+
+        move m = engine_best_play(t->ctx, &out_b);
+        if (m != PASS && !is_board_move(m)) {
+            break;
+        }
+
+        add_play(&gr, m);
+        t->plays++;
+    }
+
+    t->komi_kept = (komi == DEFAULT_KOMI);
+    return NULL;
+}
+
+static void test_engine_contexts() {
+    fprintf(stderr, "%s: concurrent engines...\n", _timestamp());
+
+    engine_test tests[2];
+    pthread_t threads[2];
+
+    for (u8 i = 0; i < 2; ++i) {
+        tests[i].ctx = engine_create(20, 1);
+        tests[i].komi = i == 0 ? 0 : 30;
+        tests[i].plays = 0;
+        tests[i].komi_kept = false;
+    }
+
+    for (u8 i = 0; i < 2; ++i) {
+        massert(pthread_create(&threads[i], NULL, engine_test_thread, &tests[i]) == 0, "pthread_create");
+    }
+
+    for (u8 i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+        massert(tests[i].plays == 6, "engine stopped playing");
+        massert(tests[i].komi_kept, "engine komi leaked to its thread");
+        engine_destroy(tests[i].ctx);
+    }
+
+    massert(tt_selected() == NULL, "transpositions table selection changed");
+
+    fprintf(stderr, "%s: test passed\n", _timestamp());
+}
+
 int main() {
     alloc_init();
 
@@ -644,12 +1129,17 @@ int main() {
 
     if (1) {
         test_pattern();
+        test_pat5();
         test_board();
         test_cfg_board();
         test_ladders();
+        test_nakade();
+        test_scoring();
         test_rand_gen();
+        test_ring_queue();
         test_time_keeping();
         test_zobrist_hashing();
+        test_engine_contexts();
         test_whole_game();
     } else {
         while (1) {
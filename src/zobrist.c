@@ -1,6 +1,6 @@
 /*
 For creating and updating Zobrist hashes on board states, both for full board
-hashes and position invariant 3x3 hashes.
+hashes and position invariant 3x3 and 5x5 diamond hashes.
 */
 
 #include "config.h"
@@ -22,10 +22,61 @@ static bool _zobrist_inited = false;
 
 static u64 iv[TOTAL_BOARD_SIZ][2];
 
-/* for 3x3 neighborhood Zobrist hashing */
-u16 iv_3x3[TOTAL_BOARD_SIZ][TOTAL_BOARD_SIZ][3];
+/*
+For 3x3 neighborhood hashing; the bit shift of the 2-bit cell of a neighbor
+intersection, indexed by its offset to the center plus BOARD_SIZ + 1.
+*/
+u8 iv_3x3_shift[2 * BOARD_SIZ + 3];
 u16 initial_3x3_hash[TOTAL_BOARD_SIZ];
 
+/*
+For 5x5 diamond neighborhood hashing (intersections at manhattan distance 2 or
+less); the random codification of each neighbor intersection state, indexed by
+its offset to the center plus 2 * BOARD_SIZ + 2. The codifications do not depend
+on the Zobrist table file, so the hashes are the same in every run.
+*/
+u64 iv_pat5[4 * BOARD_SIZ + 5][4];
+u64 initial_pat5_hash[TOTAL_BOARD_SIZ];
+
+static u64 splitmix64(
+    u64 * x
+) {
+    u64 z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void init_pat5_codification() {
+    u64 seed = 0x5a5a5a5a5a5a5a5aULL;
+
+    for (u16 i = 0; i < 4 * BOARD_SIZ + 5; ++i) {
+        iv_pat5[i][EMPTY] = 0;
+        iv_pat5[i][BLACK_STONE] = splitmix64(&seed);
+        iv_pat5[i][WHITE_STONE] = splitmix64(&seed);
+        iv_pat5[i][ILLEGAL] = splitmix64(&seed);
+    }
+
+    for (move m = 0; m < TOTAL_BOARD_SIZ; ++m) {
+        d8 x;
+        d8 y;
+        move_to_coord(m, (u8 *)&x, (u8 *)&y);
+        initial_pat5_hash[m] = 0;
+
+        for (d8 i = -2; i <= 2; ++i) {
+            for (d8 j = -2; j <= 2; ++j) {
+                if (abs(i) + abs(j) > 2 || (i == 0 && j == 0)) {
+                    continue;
+                }
+
+                if (x + i < 0 || x + i >= BOARD_SIZ || y + j < 0 || y + j >= BOARD_SIZ) {
+                    initial_pat5_hash[m] ^= iv_pat5[j * BOARD_SIZ + i + 2 * BOARD_SIZ + 2][ILLEGAL];
+                }
+            }
+        }
+    }
+}
+
 static u16 get_border_hash_slow(
     move m
 ) {
@@ -77,29 +128,15 @@ void zobrist_init() {
         release(s);
     }
 
-    for (move pos = 0; pos < TOTAL_BOARD_SIZ; ++pos) {
-        u16 shift = 14;
-        u8 i;
-        u8 j;
-        move_to_coord(pos, &i, &j);
-
-        for (d8 x = i - 1; x <= i + 1; ++x) {
-            for (d8 y = j - 1; y <= j + 1; ++y) {
-                if (x == i && y == j) {
-                    continue;
-                }
-
-                if (x < 0 || y < 0 || x >= BOARD_SIZ || y >= BOARD_SIZ) {
-                    shift -= 2;
-                    continue;
-                }
-
-                move m = coord_to_move(x, y);
-                iv_3x3[pos][m][BLACK_STONE - 1] = (BLACK_STONE << shift);
-                iv_3x3[pos][m][WHITE_STONE - 1] = (WHITE_STONE << shift);
-                iv_3x3[pos][m][ILLEGAL - 1] = (ILLEGAL << shift);
-                shift -= 2;
+    u8 shift = 14;
+    for (d8 x = -1; x <= 1; ++x) {
+        for (d8 y = -1; y <= 1; ++y) {
+            if (x == 0 && y == 0) {
+                continue;
             }
+
+            iv_3x3_shift[y * BOARD_SIZ + x + BOARD_SIZ + 1] = shift;
+            shift -= 2;
         }
     }
 
@@ -107,6 +144,8 @@ void zobrist_init() {
         initial_3x3_hash[m] = get_border_hash_slow(m);
     }
 
+    init_pat5_codification();
+
     _zobrist_inited = true;
 
     char * s = alloc();
@@ -147,3 +186,29 @@ void zobrist_update_hash(
 ) {
     *old_hash ^= iv[m][change - 1];
 }
+
+/*
+Generate the Zobrist hash of the stones inside a rectangular region of the
+board, delimited by the inclusive coordinates (x0,y0) and (x1,y1).
+RETURNS Zobrist hash of the region
+*/
+u64 zobrist_region_hash(
+    const u8 p[static TOTAL_BOARD_SIZ],
+    u8 x0,
+    u8 y0,
+    u8 x1,
+    u8 y1
+) {
+    u64 ret = 0;
+
+    for (u8 y = y0; y <= y1; ++y) {
+        for (u8 x = x0; x <= x1; ++x) {
+            move m = coord_to_move(x, y);
+            if (p[m] != EMPTY) {
+                ret ^= iv[m][p[m] - 1];
+            }
+        }
+    }
+
+    return ret;
+}